@@ -48,6 +48,9 @@ void appPrintf(const char *fmt, ...)
 
 bool GIsSwError = false;			// software-gererated error
 
+THREAD_LOCAL char GErrorHistory[2048];
+static THREAD_LOCAL bool WasError = false;
+
 void appError(const char *fmt, ...)
 {
 	va_list	argptr;
@@ -63,6 +66,7 @@ void appError(const char *fmt, ...)
 //	appNotify("ERROR: %s\n", buf);
 	strcpy(GErrorHistory, buf);
 	appStrcatn(ARRAY_ARG(GErrorHistory), "\n");
+	WasError = false;				// new error history; previous error could be handled by the caller
 	THROW;
 #else
 	fprintf(stderr, "Fatal Error: %s\n", buf);
@@ -72,7 +76,7 @@ void appError(const char *fmt, ...)
 }
 
 
-static char NotifyBuf[512];
+static THREAD_LOCAL char NotifyBuf[512];		// objects could be loaded by different threads
 
 void appSetNotifyHeader(const char *fmt, ...)
 {
@@ -127,9 +131,6 @@ void appNotify(const char *fmt, ...)
 }
 
 
-char GErrorHistory[2048];
-static bool WasError = false;
-
 static void LogHistory(const char *part)
 {
 	if (!GErrorHistory[0]) strcpy(GErrorHistory, "General Protection Fault !\n");
@@ -183,8 +184,8 @@ const char *va(const char *format, ...)
 {
 //	guardSlow(va);
 
-	static char buf[VA_BUFSIZE];
-	static int bufPos = 0;
+	static THREAD_LOCAL char buf[VA_BUFSIZE];	// strings could be formatted by different threads
+	static THREAD_LOCAL int bufPos = 0;
 	// wrap buffer
 	if (bufPos >= VA_BUFSIZE - VA_GOODSIZE) bufPos = 0;
 
@@ -311,6 +312,18 @@ const char *appStristr(const char *s1, const char *s2)
 	return s1 + (s - buf1);
 }
 
+unsigned appStringHash(const char *str)
+{
+	// FNV-1a hash of lowercased string
+	unsigned hash = 2166136261u;
+	while (char c = *str++)
+	{
+		if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+		hash = (hash ^ (byte)c) * 16777619u;
+	}
+	return hash;
+}
+
 void appNormalizeFilename(char *filename)
 {
 	char *src = filename;
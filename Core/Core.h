@@ -122,6 +122,7 @@ template<>    struct CompileTimeError<true> {};
 #	define vsnwprintf			_vsnwprintf
 #	define FORCEINLINE			__forceinline
 #	define NORETURN				__declspec(noreturn)
+#	define THREAD_LOCAL			__declspec(thread)
 #	define stricmp				_stricmp
 #	define strnicmp				_strnicmp
 #	define GCC_PACK							// VC uses #pragma pack()
@@ -156,6 +157,7 @@ typedef unsigned __int64		uint64;
 #	define vsnwprintf			swprintf
 #	define __FUNCSIG__			__PRETTY_FUNCTION__
 #	define NORETURN				__attribute__((noreturn))
+#	define THREAD_LOCAL			__thread
 #	if (__GNUC__ > 3) || ((__GNUC__ == 3) && (__GNUC_MINOR__ >= 2))
 	// strange, but there is only way to work (inline+always_inline)
 #		define FORCEINLINE		inline __attribute__((always_inline))
@@ -293,6 +295,8 @@ void appStrncpyz(char *dst, const char *src, int count);
 void appStrncpylwr(char *dst, const char *src, int count);
 void appStrcatn(char *dst, int count, const char *src);
 const char *appStristr(const char *s1, const char *s2);
+// case-insensitive string hash, for use in hash tables
+unsigned appStringHash(const char *str);
 
 void appNormalizeFilename(char *filename);
 void appMakeDirectory(const char *dirname);
@@ -309,6 +313,8 @@ unsigned appGetFileType(const char *filename);
 // Memory management
 
 void* appMalloc(int size, int alignment = 8);
+// the same as appMalloc(), but memory is not zeroed
+void* appMallocNoInit(int size, int alignment = 8);
 void* appRealloc(void *ptr, int newSize);
 void appFree(void *ptr);
 
@@ -346,7 +352,9 @@ FORCEINLINE void* operator new(size_t /*size*/, void* ptr)
 class CMemoryChain
 {
 public:
+	// allocated memory is zeroed
 	void* Alloc(size_t size, int alignment = DEFAULT_ALIGNMENT);
+	void* AllocNoInit(size_t size, int alignment = DEFAULT_ALIGNMENT);
 	// creating chain
 	void* operator new(size_t size, int dataSize = MEM_CHUNK_SIZE);
 	// deleting chain
@@ -361,6 +369,16 @@ private:
 	byte*			end;
 };
 
+// Memory arenas. Small blocks are allocated from the memory chain, larger ones are taken from
+// the heap. Any block could be passed to appRealloc() and appFree(), but appFree() does nothing
+// for arena blocks: their memory is returned with deletion of the chain.
+// Allocation from an arena is thread-safe.
+void* appArenaMalloc(CMemoryChain* Arena, int size, bool zero = true);
+// Arena of the current thread used by array serializers for loaded data, NULL when not set.
+// Returns previous arena.
+CMemoryChain* appSetThreadArena(CMemoryChain* Arena);
+CMemoryChain* appGetThreadArena();
+
 
 #if PROFILE
 // number of dynamic allocations
@@ -467,7 +485,7 @@ long win32ExceptFilter(struct _EXCEPTION_POINTERS *info);
 void appUnwindPrefix(const char *fmt);		// not vararg (will display function name for unguardf only)
 NORETURN void appUnwindThrow(const char *fmt, ...);
 
-extern char GErrorHistory[2048];
+extern THREAD_LOCAL char GErrorHistory[2048];		// each thread has own error history
 
 #else  // DO_GUARD
 
@@ -1,4 +1,5 @@
 #include "Core.h"
+#include "Parallel.h"
 
 #if DEBUG_MEMORY
 #define MAX_STACK_TRACE			16
@@ -14,8 +15,11 @@ size_t GTotalAllocationSize = 0;
 int    GTotalAllocationCount = 0;
 
 #define BLOCK_MAGIC		0xAE
+#define ARENA_MAGIC		0xAD		// block allocated with appArenaMalloc()
 #define FREE_BLOCK		0xFE
 
+#define MAX_ARENA_ALLOC	16384		// larger blocks are allocated from heap
+
 
 #if DEBUG_MEMORY
 
@@ -97,9 +101,9 @@ CBlockHeader* CBlockHeader::first = NULL;
 	Primary allocation functions
 -----------------------------------------------------------------------------*/
 
-void *appMalloc(int size, int alignment)
+void *appMallocNoInit(int size, int alignment)
 {
-	guard(appMalloc);
+	guard(appMallocNoInit);
 	if (size < 0 || size >= (256<<20))		// upper limit to allocation is 256Mb
 		appError("Trying to allocate %d bytes", size);
 	assert(alignment > 1 && alignment <= 256 && ((alignment & (alignment - 1)) == 0));
@@ -107,8 +111,6 @@ void *appMalloc(int size, int alignment)
 	if (!block)
 		appError("Failed to allocate %d bytes", size);
 	void *ptr = Align(OffsetPointer(block, sizeof(CBlockHeader)), alignment);
-	if (size > 0)
-		memset(ptr, 0, size);
 	CBlockHeader *hdr = (CBlockHeader*)ptr - 1;
 	byte offset = (byte*)ptr - (byte*)block;
 	hdr->magic     = BLOCK_MAGIC;
@@ -141,17 +143,25 @@ void *appMalloc(int size, int alignment)
 	hdr->stack = found;
 #endif // DEBUG_MEMORY
 
-	// statistics
-	GTotalAllocationSize += size;
-	GTotalAllocationCount++;
+	// statistics; memory is allocated from different threads
+	appInterlockedAdd(&GTotalAllocationSize, size);
+	appInterlockedAdd(&GTotalAllocationCount, 1);
 #if PROFILE
-	GNumAllocs++;
+	appInterlockedAdd(&GNumAllocs, 1);
 #endif
 
 	return ptr;
 	unguardf("size=%d", size);
 }
 
+void *appMalloc(int size, int alignment)
+{
+	void *ptr = appMallocNoInit(size, alignment);
+	if (size > 0)
+		memset(ptr, 0, size);
+	return ptr;
+}
+
 void* appRealloc(void *ptr, int newSize)
 {
 	guard(appRealloc);
@@ -164,6 +174,16 @@ void* appRealloc(void *ptr, int newSize)
 	int oldSize = hdr->blockSize;
 	if (oldSize == newSize) return ptr;	// size not changed
 
+	if (hdr->magic == ARENA_MAGIC)
+	{
+		// move data to the heap, old block will be released with its arena
+		void *newData = appMallocNoInit(newSize, hdr->align + 1);
+		memcpy(newData, ptr, min(newSize, oldSize));
+		if (newSize > oldSize)
+			memset(OffsetPointer(newData, oldSize), 0, newSize - oldSize);
+		return newData;
+	}
+
 	assert(hdr->magic == BLOCK_MAGIC);
 	hdr->magic--;		// modify to any value
 #if DEBUG_MEMORY
@@ -171,9 +191,11 @@ void* appRealloc(void *ptr, int newSize)
 #endif
 
 	int alignment = hdr->align + 1;
-	void *newData = appMalloc(newSize, alignment);
+	void *newData = appMallocNoInit(newSize, alignment);
 
 	memcpy(newData, ptr, min(newSize, oldSize));
+	if (newSize > oldSize)
+		memset(OffsetPointer(newData, oldSize), 0, newSize - oldSize);
 
 	int offset = hdr->offset + 1;
 	void *block = OffsetPointer(ptr, -offset);
@@ -185,11 +207,11 @@ void* appRealloc(void *ptr, int newSize)
 
 	// statistics: we're allocating a new block with appMalloc, which counts statistics
 	// for this allocation, so only eliminate statistics from old memory block here
-	GTotalAllocationSize -= oldSize;
-	GTotalAllocationCount--;
+	appInterlockedAdd(&GTotalAllocationSize, (size_t)-oldSize);
+	appInterlockedAdd(&GTotalAllocationCount, -1);
 
 #if PROFILE
-	GNumAllocs++;
+	appInterlockedAdd(&GNumAllocs, 1);
 #endif
 
 	return newData;
@@ -206,6 +228,15 @@ void appFree(void *ptr)
 	int offset = hdr->offset + 1;
 	void *block = OffsetPointer(ptr, -offset);
 
+	if (hdr->magic == ARENA_MAGIC)
+	{
+		// memory is owned by arena
+#if DEBUG_MEMORY
+		memset(ptr, FREE_BLOCK, hdr->blockSize);
+#endif
+		return;
+	}
+
 	assert(hdr->magic == BLOCK_MAGIC);
 	hdr->magic--;		// modify to any value
 #if DEBUG_MEMORY
@@ -214,8 +245,8 @@ void appFree(void *ptr)
 #endif
 
 	// statistics
-	GTotalAllocationSize -= hdr->blockSize;
-	GTotalAllocationCount--;
+	appInterlockedAdd(&GTotalAllocationSize, (size_t)-hdr->blockSize);
+	appInterlockedAdd(&GTotalAllocationCount, -1);
 
 	free(block);
 
@@ -231,16 +262,13 @@ void* CMemoryChain::operator new(size_t size, int dataSize)
 {
 	guard(CMemoryChain::new);
 	int alloc = Align(size + dataSize, MEM_CHUNK_SIZE);
-	CMemoryChain *chain = (CMemoryChain *) appMalloc(alloc);	//!! allocate
-	if (!chain)
-		appError("Failed to allocate %d bytes", alloc);
+	// memory is zeroed by Alloc()
+	CMemoryChain *chain = (CMemoryChain *) appMallocNoInit(alloc);
 	chain->size = alloc;
 	chain->next = NULL;
 	chain->data = (byte*) OffsetPointer(chain, size);
 	chain->end  = (byte*) OffsetPointer(chain, alloc);
 
-	memset(chain->data, 0, chain->end - chain->data);
-
 	return chain;
 	unguard;
 }
@@ -254,7 +282,7 @@ void CMemoryChain::operator delete(void *ptr)
 	{
 		// free memory block
 		next = curr->next;
-		free(curr);				//!! deallocate
+		appFree(curr);
 	}
 	unguard;
 }
@@ -262,7 +290,16 @@ void CMemoryChain::operator delete(void *ptr)
 
 void *CMemoryChain::Alloc(size_t size, int alignment)
 {
-	guard(CMemoryChain::Alloc);
+	void *ptr = AllocNoInit(size, alignment);
+	if (ptr)
+		memset(ptr, 0, size);
+	return ptr;
+}
+
+
+void *CMemoryChain::AllocNoInit(size_t size, int alignment)
+{
+	guard(CMemoryChain::AllocNoInit);
 	if (!size) return NULL;
 
 	// sequence of blocks (with using "next" field): 1(==this)->5(last)->4->3->2->NULL
@@ -272,8 +309,9 @@ void *CMemoryChain::Alloc(size_t size, int alignment)
 	if (start + size > b->end)
 	{
 		//?? may be, search in other blocks ...
-		// allocate in the new block
-		b = new (size + alignment - 1) CMemoryChain;
+		// allocate in the new block, not smaller than the first one
+		int dataSize = max((int)(size + alignment - 1), this->size - (int)sizeof(CMemoryChain));
+		b = new (dataSize) CMemoryChain;
 		// insert new block immediately after 1st block (==this)
 		b->next = next;
 		next = b;
@@ -296,6 +334,57 @@ int CMemoryChain::GetSize() const
 }
 
 
+/*-----------------------------------------------------------------------------
+	Memory arenas
+-----------------------------------------------------------------------------*/
+
+static CSpinLock ArenaLock;
+static THREAD_LOCAL CMemoryChain* GThreadArena;
+
+void* appArenaMalloc(CMemoryChain* Arena, int size, bool zero)
+{
+	guard(appArenaMalloc);
+
+	if (!Arena || size < 0 || size > MAX_ARENA_ALLOC)
+		return zero ? appMalloc(size) : appMallocNoInit(size);
+
+	// block has the same header as heap allocation, so appFree() and appRealloc() could recognize it
+	int headerSize = Align(sizeof(CBlockHeader), DEFAULT_ALIGNMENT);
+	ArenaLock.Lock();
+	void *block = Arena->AllocNoInit(size + headerSize, DEFAULT_ALIGNMENT);
+	ArenaLock.Unlock();
+
+	void *ptr = OffsetPointer(block, headerSize);
+	CBlockHeader *hdr = (CBlockHeader*)ptr - 1;
+	hdr->magic     = ARENA_MAGIC;
+	hdr->offset    = headerSize - 1;
+	hdr->align     = DEFAULT_ALIGNMENT - 1;
+	hdr->blockSize = size;
+#if DEBUG_MEMORY
+	hdr->prev  = hdr->next = NULL;
+	hdr->stack = NULL;
+#endif
+
+	if (zero)
+		memset(ptr, 0, size);
+	return ptr;
+
+	unguardf("size=%d", size);
+}
+
+CMemoryChain* appSetThreadArena(CMemoryChain* Arena)
+{
+	CMemoryChain* Prev = GThreadArena;
+	GThreadArena = Arena;
+	return Prev;
+}
+
+CMemoryChain* appGetThreadArena()
+{
+	return GThreadArena;
+}
+
+
 /*-----------------------------------------------------------------------------
 	Debugging information
 -----------------------------------------------------------------------------*/
@@ -0,0 +1,300 @@
+#include "Core.h"
+#include "Parallel.h"
+
+#if _WIN32
+#define WIN32_LEAN_AND_MEAN			// exclude rarely-used services from windown headers
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <semaphore.h>
+#include <unistd.h>					// sysconf()
+#include <sched.h>					// sched_yield()
+#endif
+
+
+int GNumThreads = 1;
+void (*GParallelErrorCleanup)() = NULL;
+
+
+/*-----------------------------------------------------------------------------
+	Platform-specific code
+-----------------------------------------------------------------------------*/
+
+#if _WIN32
+
+typedef HANDLE CSemaphore;
+
+static void InitSemaphore(CSemaphore& Sem)
+{
+	Sem = CreateSemaphore(NULL, 0, MAX_THREADS * 2, NULL);
+	if (!Sem) appError("CreateSemaphore failed");
+}
+
+static void PostSemaphore(CSemaphore& Sem, int Count)
+{
+	ReleaseSemaphore(Sem, Count, NULL);
+}
+
+static void WaitSemaphore(CSemaphore& Sem)
+{
+	WaitForSingleObject(Sem, INFINITE);
+}
+
+#else
+
+typedef sem_t CSemaphore;
+
+static void InitSemaphore(CSemaphore& Sem)
+{
+	if (sem_init(&Sem, 0, 0) != 0) appError("sem_init failed");
+}
+
+static void PostSemaphore(CSemaphore& Sem, int Count)
+{
+	for (int i = 0; i < Count; i++)
+		sem_post(&Sem);
+}
+
+static void WaitSemaphore(CSemaphore& Sem)
+{
+	while (sem_wait(&Sem) != 0)
+	{
+		// interrupted by a signal, try again
+	}
+}
+
+#endif // _WIN32
+
+
+#if _WIN32
+
+staticAssert(sizeof(CRITICAL_SECTION) <= sizeof(CMutex), CMutex_too_small);
+
+CMutex::CMutex()
+{
+	InitializeCriticalSection((CRITICAL_SECTION*)Data);
+}
+
+CMutex::~CMutex()
+{
+	DeleteCriticalSection((CRITICAL_SECTION*)Data);
+}
+
+void CMutex::Lock()
+{
+	EnterCriticalSection((CRITICAL_SECTION*)Data);
+}
+
+void CMutex::Unlock()
+{
+	LeaveCriticalSection((CRITICAL_SECTION*)Data);
+}
+
+#else
+
+staticAssert(sizeof(pthread_mutex_t) <= sizeof(CMutex), CMutex_too_small);
+
+CMutex::CMutex()
+{
+	pthread_mutex_init((pthread_mutex_t*)Data, NULL);
+}
+
+CMutex::~CMutex()
+{
+	pthread_mutex_destroy((pthread_mutex_t*)Data);
+}
+
+void CMutex::Lock()
+{
+	pthread_mutex_lock((pthread_mutex_t*)Data);
+}
+
+void CMutex::Unlock()
+{
+	pthread_mutex_unlock((pthread_mutex_t*)Data);
+}
+
+#endif // _WIN32
+
+
+void appYieldThread()
+{
+#if _WIN32
+	SwitchToThread();
+#else
+	sched_yield();
+#endif
+}
+
+
+int appGetNumCPUs()
+{
+#if _WIN32
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+	int count = si.dwNumberOfProcessors;
+#else
+	int count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	return bound(count, 1, MAX_THREADS);
+}
+
+
+void appSetNumThreads(int Count)
+{
+	if (Count <= 0) Count = appGetNumCPUs();
+#if DEBUG_MEMORY
+	Count = 1;					// memory allocation tracking is not thread-safe
+#endif
+	GNumThreads = bound(Count, 1, MAX_THREADS);
+}
+
+
+/*-----------------------------------------------------------------------------
+	Thread pool
+-----------------------------------------------------------------------------*/
+
+// The pool executes a single job at time. Worker threads are waiting for
+// WakeSemaphore, then process items of the current job until all of them are
+// taken, and report completion with DoneSemaphore. The thread which started
+// a job processes items too, and then waits for all woken workers. Note: a fast
+// worker could consume 2 wake signals for the same job, in this case another
+// worker simply remains sleeping - the number of "done" signals is still equal
+// to the number of "wake" signals.
+
+struct CParallelJob
+{
+	ParallelFunc_t	Func;
+	void*			Context;
+	int				Count;
+	int				Granularity;
+	volatile int	NextIndex;
+	volatile int	ErrorCount;
+	char			ErrorMessage[2048];
+};
+
+static CParallelJob		Job;
+static volatile int		PoolBusy = 0;
+static int				NumWorkers = 0;
+static CSemaphore		WakeSemaphore;
+static CSemaphore		DoneSemaphore;
+
+
+static void ProcessJobItems()
+{
+	while (Job.ErrorCount == 0)
+	{
+		int first = appInterlockedAdd(&Job.NextIndex, Job.Granularity) - Job.Granularity;
+		if (first >= Job.Count) break;
+		int last = min(first + Job.Granularity, Job.Count);
+		Job.Func(Job.Context, first, last);
+	}
+}
+
+// Note: this function should not have local objects with destructors, because
+// it uses SEH when compiled with Visual C++.
+static void ProcessJobItemsSafe()
+{
+#if DO_GUARD
+	TRY
+	{
+#endif
+		ProcessJobItems();
+#if DO_GUARD
+	}
+	CATCH
+	{
+		if (GParallelErrorCleanup)
+			GParallelErrorCleanup();
+		// remember the first error only
+		if (appInterlockedAdd(&Job.ErrorCount, 1) == 1)
+			appStrncpyz(Job.ErrorMessage, GErrorHistory, ARRAY_COUNT(Job.ErrorMessage));
+	}
+#endif // DO_GUARD
+}
+
+#if _WIN32
+static DWORD WINAPI WorkerThread(void* /*Param*/)
+#else
+static void* WorkerThread(void* /*Param*/)
+#endif
+{
+	while (true)
+	{
+		WaitSemaphore(WakeSemaphore);
+		ProcessJobItemsSafe();
+		PostSemaphore(DoneSemaphore, 1);
+	}
+	return 0;
+}
+
+static void StartWorkers(int Count)
+{
+	guard(StartWorkers);
+
+	if (NumWorkers == 0)
+	{
+		InitSemaphore(WakeSemaphore);
+		InitSemaphore(DoneSemaphore);
+	}
+
+	while (NumWorkers < Count)
+	{
+#if _WIN32
+		HANDLE thread = CreateThread(NULL, 0, WorkerThread, NULL, 0, NULL);
+		if (!thread) break;
+		CloseHandle(thread);
+#else
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, WorkerThread, NULL) != 0) break;
+		pthread_detach(thread);
+#endif
+		NumWorkers++;
+	}
+
+	unguard;
+}
+
+
+void appParallelFor(int Count, int Granularity, ParallelFunc_t Func, void* Context)
+{
+	guard(appParallelFor);
+
+	if (Count <= 0) return;
+	if (Granularity < 1) Granularity = 1;
+
+	int numChunks = (Count + Granularity - 1) / Granularity;
+	// execute everything in the calling thread when threading is disabled, when
+	// there's nothing to split, or when the pool is already executing another job
+	if (GNumThreads <= 1 || numChunks <= 1 || appInterlockedCompareExchange(&PoolBusy, 1, 0) != 0)
+	{
+		Func(Context, 0, Count);
+		return;
+	}
+
+	StartWorkers(GNumThreads - 1);
+	int numWake = min(GNumThreads - 1, NumWorkers);
+	numWake = min(numWake, numChunks - 1);
+
+	// setup a job
+	Job.Func        = Func;
+	Job.Context     = Context;
+	Job.Count       = Count;
+	Job.Granularity = Granularity;
+	Job.NextIndex   = 0;
+	Job.ErrorCount  = 0;
+	Job.ErrorMessage[0] = 0;
+
+	// execute it
+	PostSemaphore(WakeSemaphore, numWake);
+	ProcessJobItemsSafe();
+	for (int i = 0; i < numWake; i++)
+		WaitSemaphore(DoneSemaphore);
+
+	PoolBusy = 0;
+
+	if (Job.ErrorCount)
+		appError("%s", Job.ErrorMessage);
+
+	unguard;
+}
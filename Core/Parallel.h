@@ -0,0 +1,146 @@
+#ifndef __PARALLEL_H__
+#define __PARALLEL_H__
+
+/*-----------------------------------------------------------------------------
+	Atomic operations
+-----------------------------------------------------------------------------*/
+
+#if _MSC_VER
+
+// Note: intrinsics are declared in <intrin.h>, which is included from Core.h
+
+// Add 'Delta' to 'Value' and return the new value
+FORCEINLINE int appInterlockedAdd(volatile int* Value, int Delta)
+{
+	return _InterlockedExchangeAdd((volatile long*)Value, Delta) + Delta;
+}
+
+// Set 'Value' to 'Exchange' when it is equal to 'Comparand', return the previous value
+FORCEINLINE int appInterlockedCompareExchange(volatile int* Value, int Exchange, int Comparand)
+{
+	return _InterlockedCompareExchange((volatile long*)Value, Exchange, Comparand);
+}
+
+// Pointer-sized version of appInterlockedAdd(), negative 'Delta' should be passed as (size_t)-x
+FORCEINLINE size_t appInterlockedAdd(volatile size_t* Value, size_t Delta)
+{
+#ifdef _WIN64
+	return _InterlockedExchangeAdd64((volatile __int64*)Value, Delta) + Delta;
+#else
+	return _InterlockedExchangeAdd((volatile long*)Value, Delta) + Delta;
+#endif
+}
+
+// Full memory barrier: memory accesses are not moved across this call by compiler and CPU
+FORCEINLINE void appMemoryBarrier()
+{
+	_ReadWriteBarrier();
+	_mm_mfence();
+	_ReadWriteBarrier();
+}
+
+#else
+
+FORCEINLINE int appInterlockedAdd(volatile int* Value, int Delta)
+{
+	return __sync_add_and_fetch(Value, Delta);
+}
+
+FORCEINLINE int appInterlockedCompareExchange(volatile int* Value, int Exchange, int Comparand)
+{
+	return __sync_val_compare_and_swap(Value, Comparand, Exchange);
+}
+
+FORCEINLINE size_t appInterlockedAdd(volatile size_t* Value, size_t Delta)
+{
+	return __sync_add_and_fetch(Value, Delta);
+}
+
+FORCEINLINE void appMemoryBarrier()
+{
+	__sync_synchronize();
+}
+
+#endif // _MSC_VER
+
+// Note: storage class for thread-local variables, THREAD_LOCAL, is defined in Core.h
+
+
+// Give up the rest of time slice of the calling thread
+void appYieldThread();
+
+// Lightweight lock for protection of short code fragments. Not recursive.
+class CSpinLock
+{
+public:
+	CSpinLock()
+	:	Value(0)
+	{}
+
+	FORCEINLINE void Lock()
+	{
+		while (appInterlockedCompareExchange(&Value, 1, 0) != 0)
+			appYieldThread();
+	}
+
+	FORCEINLINE void Unlock()
+	{
+		appInterlockedCompareExchange(&Value, 0, 1);
+	}
+
+protected:
+	volatile int	Value;
+};
+
+// Blocking lock for code which could hold it for a long time (file reading, object
+// serialization): waiting threads are put to sleep instead of spinning. Not recursive.
+class CMutex
+{
+public:
+	CMutex();
+	~CMutex();
+	void Lock();
+	void Unlock();
+
+protected:
+	void*			Data[8];		// storage for CRITICAL_SECTION or pthread_mutex_t
+};
+
+
+/*-----------------------------------------------------------------------------
+	Thread pool for data-parallel loops
+-----------------------------------------------------------------------------*/
+
+#define MAX_THREADS				64
+
+// Number of threads used by appParallelFor(), including the calling thread.
+// Value 1 (default) disables threading completely.
+extern int GNumThreads;
+
+int appGetNumCPUs();
+// Set number of threads for appParallelFor(); when 'Count' is 0 or negative,
+// number of CPU cores will be used.
+void appSetNumThreads(int Count);
+
+// Callback for appParallelFor(), should process items [First, Last).
+typedef void (*ParallelFunc_t)(void* Context, int First, int Last);
+
+// Split 'Count' items into groups of 'Granularity' items and process them using
+// all available threads, including the calling one. Function returns when all
+// items are processed. Errors in worker threads are rethrown in the calling
+// thread. Nested calls (from inside of the callback) are executed serially.
+void appParallelFor(int Count, int Granularity, ParallelFunc_t Func, void* Context);
+
+// Optional function which is called by a thread after an error in appParallelFor() callback
+// was caught, should release locks and other per-thread state left by the failed callback.
+extern void (*GParallelErrorCleanup)();
+
+// wrapper to avoid typecasts to ParallelFunc_t
+template<class T>
+FORCEINLINE void appParallelFor(int Count, int Granularity, void (*Func)(T*, int, int), T* Context)
+{
+	appParallelFor(Count, Granularity, (ParallelFunc_t)Func, (void*)Context);
+}
+
+
+#endif // __PARALLEL_H__
@@ -337,6 +337,8 @@ void ExportMd5Anim(const CAnimSet *Anim)
 		Ar->Printf("}\n\n");
 
 		// baseframe and frames
+		TArray<CAnimTrackCursor> Cursors;
+		Cursors.AddZeroed(numBones);
 		for (int Frame = -1; Frame < S.NumFrames; Frame++)
 		{
 			int t = Frame;
@@ -352,7 +354,7 @@ void ExportMd5Anim(const CAnimSet *Anim)
 			{
 				CVec3 BP;
 				CQuat BO;
-				S.Tracks[b].GetBonePosition(t, S.NumFrames, false, BP, BO);
+				S.GetTrack(b).GetBonePosition(t, S.NumFrames, false, BP, BO, &Cursors[b]);
 				if (!b) BO.Conjugate();			// root bone
 #if MIRROR_MESH
 				BO.y  *= -1;
@@ -460,9 +460,12 @@ void ExportPsa(const CAnimSet *Anim)
 	KeyHdr.DataSize  = sizeof(VQuatAnimKey);
 	SAVE_CHUNK(KeyHdr, "ANIMKEYS");
 	bool requireConfig = false;
+	TArray<CAnimTrackCursor> Cursors;
 	for (i = 0; i < numAnims; i++)
 	{
 		const CAnimSequence &S = Anim->Sequences[i];
+		Cursors.Empty(numBones);
+		Cursors.AddZeroed(numBones);
 		for (int t = 0; t < S.NumFrames; t++)
 		{
 			for (int b = 0; b < numBones; b++)
@@ -473,7 +476,8 @@ void ExportPsa(const CAnimSet *Anim)
 
 				BP.Set(0, 0, 0);			// GetBonePosition() will not alter BP and BO when animation tracks are not exists
 				BO.Set(0, 0, 0, 1);
-				S.Tracks[b].GetBonePosition(t, S.NumFrames, false, BP, BO);
+				CAnimTrackView Track = S.GetTrack(b);
+				Track.GetBonePosition(t, S.NumFrames, false, BP, BO, &Cursors[b]);
 
 				K.Position    = (FVector&) BP;
 				K.Orientation = (FQuat&)   BO;
@@ -488,7 +492,7 @@ void ExportPsa(const CAnimSet *Anim)
 				keysCount--;
 
 				// check for user error
-				if ((S.Tracks[b].KeyPos.Num() == 0) || (S.Tracks[b].KeyQuat.Num() == 0))
+				if ((Track.NumPosKeys == 0) || (Track.NumQuatKeys == 0))
 					requireConfig = true;
 			}
 		}
@@ -537,9 +541,10 @@ void ExportPsa(const CAnimSet *Anim)
 #define FLAG_NO_ROTATION		2
 				static const char *FlagInfo[] = { "", "trans", "rot", "all" };
 				int flag = 0;
-				if (S.Tracks[b].KeyPos.Num() == 0)
+				CAnimTrackView Track = S.GetTrack(b);
+				if (Track.NumPosKeys == 0)
 					flag |= FLAG_NO_TRANSLATION;
-				if (S.Tracks[b].KeyQuat.Num() == 0)
+				if (Track.NumQuatKeys == 0)
 					flag |= FLAG_NO_ROTATION;
 				if (flag)
 					Ar1->Printf("%s.%d=%s\n", *S.Name, b, FlagInfo[flag]);
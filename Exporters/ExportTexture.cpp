@@ -4,220 +4,479 @@
 #include "UnCore.h"
 #include "UnObject.h"
 #include "UnMaterial.h"
+#include "UnMaterial3.h"
 
 #include "Exporters.h"
+#include "ImageWriter.h"
 
 
-#define TGA_SAVE_BOTTOMLEFT	1
+bool GNoTgaCompress = false;
+bool GExportPNG = false;
+bool GExportDDS = false;
+bool GExportKTX = false;
+int  GExportTextureMip = 0;
+int  GExportTextureMaxSize = 0;
+
 
+/*-----------------------------------------------------------------------------
+	DDS and KTX2 export
+-----------------------------------------------------------------------------*/
 
-#define TGA_ORIGIN_MASK		0x30
-#define TGA_BOTLEFT			0x00
-#define TGA_BOTRIGHT		0x10					// unused
-#define TGA_TOPLEFT			0x20
-#define TGA_TOPRIGHT		0x30					// unused
+// Texture containers are holding original block data of all mip levels and cubemap
+// faces, nothing is decoded or recompressed.
 
 #if _MSC_VER
 #pragma pack(push,1)
 #endif
 
-struct GCC_PACK tgaHdr_t
+struct GCC_PACK ktx2Hdr_t
+{
+	byte	identifier[12];
+	uint32	vkFormat;
+	uint32	typeSize;
+	uint32	pixelWidth, pixelHeight, pixelDepth;
+	uint32	layerCount, faceCount, levelCount;
+	uint32	supercompressionScheme;
+	uint32	dfdByteOffset, dfdByteLength;
+	uint32	kvdByteOffset, kvdByteLength;
+	uint64	sgdByteOffset, sgdByteLength;
+};
+
+struct GCC_PACK ktx2Level_t
 {
-	byte 	id_length, colormap_type, image_type;
-	uint16	colormap_index, colormap_length;
-	byte	colormap_size;
-	uint16	x_origin, y_origin;				// unused
-	uint16	width, height;
-	byte	pixel_size, attributes;
+	uint64	byteOffset;
+	uint64	byteLength;
+	uint64	uncompressedByteLength;
 };
 
 #if _MSC_VER
 #pragma pack(pop)
 #endif
 
+// Color models of KTX2 data format descriptor (Khronos Data Format Specification)
+#define KDF_MODEL_RGBSDA		1
+#define KDF_MODEL_BC1A			128
+#define KDF_MODEL_BC2			129
+#define KDF_MODEL_BC3			130
+#define KDF_MODEL_BC5			132
+#define KDF_MODEL_BC7			134
+#define KDF_MODEL_ETC2			161
+#define KDF_MODEL_PVRTC			164
 
-bool GNoTgaCompress = false;
-bool GExportDDS = false;
+#define KDF_SAMPLE_SIGNED		0x40		// sample qualifier, combined with channel id
 
-//?? place this function outside (cannot place to Core - using FArchive)
+static int GetMipDataSize(const CPixelFormatInfo &Info, const CMipMap &Mip)
+{
+	int blocksX = (Mip.USize + Info.BlockSizeX - 1) / Info.BlockSizeX;
+	int blocksY = (Mip.VSize + Info.BlockSizeY - 1) / Info.BlockSizeY;
+	return blocksX * blocksY * Info.BytesPerBlock;
+}
 
-void WriteTGA(FArchive &Ar, int width, int height, byte *pic)
+// Returns number of mip levels which form a complete mip chain starting from Mips[0]
+static int GetMipChainLength(const CTextureData &TexData)
 {
-	guard(WriteTGA);
+	const CPixelFormatInfo &Info = PixelFormatInfo[TexData.Format];
+	int n;
+	for (n = 0; n < TexData.Mips.Num(); n++)
+	{
+		const CMipMap &Mip = TexData.Mips[n];
+		if (!Mip.CompressedData || Mip.DataSize < GetMipDataSize(Info, Mip))
+			break;									// no data, or XBox360 mip which was not untiled
+		if (n > 0)
+		{
+			const CMipMap &Prev = TexData.Mips[n - 1];
+			if (Mip.USize != max(1, Prev.USize / 2) || Mip.VSize != max(1, Prev.VSize / 2))
+				break;								// some mip levels are missing
+		}
+	}
+	return n;
+}
 
-	int		i;
+static void WriteDDS(FArchive &Ar, const CTextureData *Faces, int NumFaces, int NumMips)
+{
+	guard(WriteDDS);
 
-	byte *src;
-	int size = width * height;
-	// convert RGB to BGR (inplace!)
-	for (i = 0, src = pic; i < size; i++, src += 4)
-		Exchange(src[0], src[2]);
+	const CTextureData &TexData = Faces[0];
+	const CPixelFormatInfo &Info = PixelFormatInfo[TexData.Format];
+	const CMipMap &Mip = TexData.Mips[0];
 
-	// check for 24 bit image possibility
-	int colorBytes = 3;
-	for (i = 0, src = pic + 3; i < size; i++, src += 4)
-		if (src[0] != 255)									// src initialized with offset 3
+	nv::DDSHeader header;
+	if (Info.FourCC)
+	{
+		// legacy header is understood by more tools
+		unsigned fourCC = Info.FourCC;
+		header.setFourCC(fourCC & 0xFF, (fourCC >> 8) & 0xFF, (fourCC >> 16) & 0xFF, (fourCC >> 24) & 0xFF);
+	}
+	else
+	{
+		header.setFourCC('D', 'X', '1', '0');
+		header.setDX10Format(Info.DXGIFormat);
+		header.setTexture2D();
+		header.header10.arraySize = 1;
+	}
+	header.setWidth(Mip.USize);
+	header.setHeight(Mip.VSize);
+	if (NumFaces == 6)
+	{
+		header.setTextureCube();
+		// DX10 cubemap is a single array element with "texture cube" flag
+		header.header10.arraySize = 1;
+		header.header10.miscFlag  = 4;				// DDS_RESOURCE_MISC_TEXTURECUBE
+	}
+	header.setMipmapCount(NumMips);
+	if (Info.BlockSizeX > 1)
+		header.setLinearSize(GetMipDataSize(Info, Mip));
+	else
+		header.setPitch(Mip.USize * Info.BytesPerBlock);
+
+	byte headerBuffer[148];							// DDS header with DX10 extension
+	memset(headerBuffer, 0, sizeof(headerBuffer));
+	int headerSize = WriteDDSHeader(headerBuffer, header);
+	Ar.Serialize(headerBuffer, headerSize);
+
+	// all mip levels of the first face, then the next face
+	for (int face = 0; face < NumFaces; face++)
+	{
+		for (int i = 0; i < NumMips; i++)
 		{
-			colorBytes = 4;
-			break;
+			const CMipMap &M = Faces[face].Mips[i];
+			Ar.Serialize(const_cast<byte*>(M.CompressedData), GetMipDataSize(Info, M));
 		}
+	}
 
-	byte *packed = (byte*)appMalloc(width * height * colorBytes);
-	byte *threshold = packed + width * height * colorBytes - 16; // threshold for "dst"
+	unguard;
+}
 
-	src = pic;
-	byte *dst = packed;
-	int column = 0;
-	byte *flag = NULL;
-	bool rle = false;
+// Fill basic data format descriptor for KTX2 file, returns its size in bytes
+static int BuildKTX2DFD(ETexturePixelFormat Format, uint32 *DFD)
+{
+	const CPixelFormatInfo &Info = PixelFormatInfo[Format];
+	uint32 *s = DFD + 7;							// samples are following total size and 6-word block header
+	int model = KDF_MODEL_RGBSDA;
+
+#define SAMPLE(channel, offset, length, lower, upper)				\
+	{																\
+		s[0] = (offset) | (((length) - 1) << 16) | ((channel) << 24); \
+		s[1] = 0;													\
+		s[2] = (lower);												\
+		s[3] = (upper);												\
+		s += 4;														\
+	}
+#define SAMPLE8(channel, offset)	SAMPLE(channel, offset, 8, 0, 255)
 
-	bool useCompression = true;
-	if (GNoTgaCompress)
-		threshold = dst;									// will break compression loop immediately
+	switch (Format)
+	{
+	case TPF_G8:
+		SAMPLE8(0, 0);
+		break;
+	case TPF_RGB8:
+		SAMPLE8(0, 0); SAMPLE8(1, 8); SAMPLE8(2, 16);
+		break;
+	case TPF_RGBA8:
+		SAMPLE8(0, 0); SAMPLE8(1, 8); SAMPLE8(2, 16); SAMPLE8(15, 24);
+		break;
+	case TPF_BGRA8:
+		SAMPLE8(2, 0); SAMPLE8(1, 8); SAMPLE8(0, 16); SAMPLE8(15, 24);
+		break;
+	case TPF_V8U8:
+		SAMPLE(0 | KDF_SAMPLE_SIGNED, 0, 8, (uint32)-127, 127);
+		SAMPLE(1 | KDF_SAMPLE_SIGNED, 8, 8, (uint32)-127, 127);
+		break;
+	case TPF_V8U8_2:
+		SAMPLE8(0, 0); SAMPLE8(1, 8);
+		break;
+	case TPF_RGBA4:
+		SAMPLE(15, 0, 4, 0, 15); SAMPLE(2, 4, 4, 0, 15); SAMPLE(1, 8, 4, 0, 15); SAMPLE(0, 12, 4, 0, 15);
+		break;
+	case TPF_DXT1:
+		model = KDF_MODEL_BC1A;
+		SAMPLE(1, 0, 64, 0, 0xFFFFFFFF);			// color with alpha
+		break;
+	case TPF_DXT3:
+	case TPF_DXT5:
+	case TPF_DXT5N:
+		model = (Format == TPF_DXT3) ? KDF_MODEL_BC2 : KDF_MODEL_BC3;
+		SAMPLE(15, 0, 64, 0, 0xFFFFFFFF);			// alpha
+		SAMPLE(0, 64, 64, 0, 0xFFFFFFFF);			// color
+		break;
+	case TPF_BC5:
+		model = KDF_MODEL_BC5;
+		SAMPLE(0, 0, 64, 0, 0xFFFFFFFF);			// red
+		SAMPLE(1, 64, 64, 0, 0xFFFFFFFF);			// green
+		break;
+	case TPF_BC7:
+		model = KDF_MODEL_BC7;
+		SAMPLE(0, 0, 128, 0, 0xFFFFFFFF);
+		break;
+#if SUPPORT_IPHONE
+	case TPF_PVRTC2:
+	case TPF_PVRTC4:
+		model = KDF_MODEL_PVRTC;
+		SAMPLE(0, 0, 64, 0, 0xFFFFFFFF);
+		break;
+#endif
+#if SUPPORT_ANDROID
+	case TPF_ETC1:
+	case TPF_ETC2:
+		model = KDF_MODEL_ETC2;
+		SAMPLE(2, 0, 64, 0, 0xFFFFFFFF);			// ETC2 color
+		break;
+#endif
+	default:
+		appError("BuildKTX2DFD: unsupported format %s", Info.Name);
+	}
 
-	for (i = 0; i < size; i++)
+#undef SAMPLE
+#undef SAMPLE8
+
+	int blockSize = (s - DFD - 1) * 4;
+	DFD[0] = blockSize + 4;							// dfdTotalSize
+	DFD[1] = 0;										// vendor and descriptor type: Khronos, basic
+	DFD[2] = 2 | (blockSize << 16);					// version 1.3
+	DFD[3] = model | (1 << 8) | (1 << 16);			// BT.709 primaries, linear transfer function, straight alpha
+	DFD[4] = (Info.BlockSizeX - 1) | ((Info.BlockSizeY - 1) << 8);
+	DFD[5] = Info.BytesPerBlock;					// bytesPlane0
+	DFD[6] = 0;
+	return DFD[0];
+}
+
+static void WriteKTX2(FArchive &Ar, const CTextureData *Faces, int NumFaces, int NumMips)
+{
+	guard(WriteKTX2);
+
+	static const byte KTX2Identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+	const CTextureData &TexData = Faces[0];
+	const CPixelFormatInfo &Info = PixelFormatInfo[TexData.Format];
+	const CMipMap &Mip = TexData.Mips[0];
+
+	uint32 DFD[64];
+	int dfdSize = BuildKTX2DFD(TexData.Format, DFD);
+
+	ktx2Hdr_t header;
+	staticAssert(sizeof(header) == 80, Wrong_KTX2_header_size);
+	memset(&header, 0, sizeof(header));
+	memcpy(header.identifier, KTX2Identifier, sizeof(KTX2Identifier));
+	header.vkFormat      = Info.VkFormat;
+	header.typeSize      = (TexData.Format == TPF_RGBA4) ? 2 : 1;	// size of data type, 1 for block-compressed formats
+	header.pixelWidth    = Mip.USize;
+	header.pixelHeight   = Mip.VSize;
+	header.faceCount     = NumFaces;
+	header.levelCount    = NumMips;
+	header.dfdByteOffset = sizeof(ktx2Hdr_t) + NumMips * sizeof(ktx2Level_t);
+	header.dfdByteLength = dfdSize;
+	Ar.Serialize(&header, sizeof(header));
+
+	// Mip levels are stored from the smallest one, every level is aligned to lcm(block size, 4)
+	int levelAlign = Info.BytesPerBlock;
+	while (levelAlign & 3) levelAlign += Info.BytesPerBlock;
+
+	TArray<ktx2Level_t> Levels;
+	Levels.AddZeroed(NumMips);
+	int64 pos = header.dfdByteOffset + dfdSize;
+	int i;
+	for (i = NumMips - 1; i >= 0; i--)
+	{
+		pos = (pos + levelAlign - 1) / levelAlign * levelAlign;
+		ktx2Level_t &L = Levels[i];
+		L.byteOffset = pos;
+		L.byteLength = L.uncompressedByteLength = (int64)GetMipDataSize(Info, TexData.Mips[i]) * NumFaces;
+		pos += L.byteLength;
+	}
+	Ar.Serialize(Levels.GetData(), NumMips * sizeof(ktx2Level_t));
+	Ar.Serialize(DFD, dfdSize);
+
+	pos = header.dfdByteOffset + dfdSize;
+	for (i = NumMips - 1; i >= 0; i--)
 	{
-		if (dst >= threshold)								// when compressed is too large, same uncompressed
+		static byte padding[16];
+		Ar.Serialize(padding, (int)(Levels[i].byteOffset - pos));
+		for (int face = 0; face < NumFaces; face++)
 		{
-			useCompression = false;
-			break;
+			const CMipMap &M = Faces[face].Mips[i];
+			Ar.Serialize(const_cast<byte*>(M.CompressedData), GetMipDataSize(Info, M));
 		}
+		pos = Levels[i].byteOffset + Levels[i].byteLength;
+	}
 
-		byte b = *src++;
-		byte g = *src++;
-		byte r = *src++;
-		byte a = *src++;
+	unguard;
+}
 
-		if (column < width - 1 &&							// not on screen edge; NOTE: when i == size-1, col==width-1
-			b == src[0] && g == src[1] && r == src[2] && a == src[3] &&	// next pixel will be the same
-			!(rle && flag && *flag == 254))					// flag overflow
-		{
-			if (!rle || !flag)
-			{
-				// starting new RLE sequence
-				flag = dst++;
-				*flag = 128 - 1;							// will be incremented below
-				*dst++ = b; *dst++ = g; *dst++ = r;			// store RGB
-				if (colorBytes == 4) *dst++ = a;			// store alpha
-			}
-			(*flag)++;										// enqueue one more texel
-			rle = true;
-		}
-		else
-		{
-			if (rle)
-			{
-				// previous block was RLE, and next (now: current) byte was
-				// the same - enqueue it to previous block and close block
-				(*flag)++;
-				flag = NULL;
-			}
-			else
-			{
-				if (column == 0)							// check for screen edge
-					flag = NULL;
-				if (!flag)
-				{
-					// start new copy sequence
-					flag = dst++;
-					*flag = 255;
-				}
-				*dst++ = b; *dst++ = g; *dst++ = r;			// store RGB
-				if (colorBytes == 4) *dst++ = a;			// store alpha
-				(*flag)++;
-				if (*flag == 127) flag = NULL;				// check for overflow
-			}
-			rle = false;
-		}
+// Write texture to DDS or KTX2 file, depending on command line. Returns false when this
+// is not possible, and texture should be exported in other way.
+static bool ExportTextureContainer(const UObject *Obj, const CTextureData *Faces, int NumFaces)
+{
+	guard(ExportTextureContainer);
 
-		if (++column == width) column = 0;
+	const CTextureData &TexData = Faces[0];
+	const CPixelFormatInfo &Info = PixelFormatInfo[TexData.Format];
+	if (GExportKTX ? !Info.VkFormat : !(Info.FourCC || Info.DXGIFormat))
+		return false;
+
+	// all faces should have the same format and size, mip chain is limited by the shortest one
+	int NumMips = 32;
+	for (int i = 0; i < NumFaces; i++)
+	{
+		const CTextureData &Face = Faces[i];
+		if (!Face.Mips.Num() || Face.Format != TexData.Format ||
+			Face.Mips[0].USize != TexData.Mips[0].USize || Face.Mips[0].VSize != TexData.Mips[0].VSize)
+			return false;
+		NumMips = min(NumMips, GetMipChainLength(Face));
 	}
+	if (!NumMips) return false;
 
-	// write header
-	tgaHdr_t header;
-	memset(&header, 0, sizeof(header));
-	header.width  = width;
-	header.height = height;
-#if 0
-	// debug: write black/white image
-	header.pixel_size = 8;
-	header.image_type = 3;
-	fwrite(&header, 1, sizeof(header), f);
-	for (i = 0; i < width * height; i++, pic += 4)
+	FArchive *Ar = CreateExportArchive(Obj, GExportKTX ? "%s.ktx2" : "%s.dds", Obj->Name);
+	if (Ar)
 	{
-		int c = (pic[0]+pic[1]+pic[2]) / 3;
-		fwrite(&c, 1, 1, f);
+		if (GExportKTX)
+			WriteKTX2(*Ar, Faces, NumFaces, NumMips);
+		else
+			WriteDDS(*Ar, Faces, NumFaces, NumMips);
+		delete Ar;
 	}
-#else
-	header.pixel_size = colorBytes * 8;
-#if TGA_SAVE_BOTTOMLEFT
-	header.attributes = TGA_BOTLEFT;
-#else
-	header.attributes = TGA_TOPLEFT;
-#endif
-	if (useCompression)
+	return true;
+
+	unguard;
+}
+
+
+// Texture export is split into 2 stages: decompression and TGA or PNG encoding could be
+// performed in a worker thread, and file writing is done in the main thread.
+struct CTextureExportJob
+{
+	const UUnrealMaterial *Tex;
+	CTextureData	TexData;
+	bool			HasData;
+	char			Name[256];					// Tex->Name could be temporarily changed by ExportObject()
+	FMemWriter		Output;
+};
+
+// Textures of this size or larger are exported by strips, without decoding the whole image
+#define STRIP_EXPORT_PIXELS		(2048*2048)
+// Number of pixels decoded at once by strip export
+#define STRIP_PIXELS			(1024*1024)
+
+// Returns false for formats which never have alpha channel
+static bool FormatHasAlpha(ETexturePixelFormat Format)
+{
+	switch (Format)
 	{
-		header.image_type = 10;		// RLE
-		// write data
-		Ar.Serialize(&header, sizeof(header));
-		Ar.Serialize(packed, dst - packed);
+	case TPF_G8:
+	case TPF_RGB8:
+	case TPF_DXT5N:
+	case TPF_V8U8:
+	case TPF_V8U8_2:
+	case TPF_BC5:
+		return false;
+	default:
+		return true;
 	}
+}
+
+// Decode and write TGA or PNG by horizontal strips, so memory usage doesn't depend on texture
+// size. Used for large textures; called from the main thread, so decoder and encoder could use
+// worker threads.
+static void ExportTextureStrips(CTextureData &TexData, FArchive &Ar)
+{
+	guard(ExportTextureStrips);
+
+	const CMipMap &Mip = TexData.Mips[0];
+	int width  = Mip.USize;
+	int height = Mip.VSize;
+	int stripRows = Align(max(STRIP_PIXELS / width, 1), PixelFormatInfo[TexData.Format].BlockSizeY);
+	int numStrips = (height + stripRows - 1) / stripRows;
+	int pitch = width * 4;
+
+	byte *strip = (byte*)appMallocNoInit(pitch * stripRows);
+
+	// check for 24 bit image possibility; stop at the first translucent strip
+	bool alpha = false;
+	if (FormatHasAlpha(TexData.Format))
+	{
+		for (int i = 0; i < numStrips && !alpha; i++)
+		{
+			int numRows = min(stripRows, height - i * stripRows);
+			TexData.DecompressRows(0, i * stripRows, numRows, strip, true);
+			alpha = ImageHasAlpha(strip, width * numRows);
+		}
+	}
+
+	CImageWriter *Writer;
+	if (GExportPNG)
+		Writer = new CPNGWriter(Ar, width, height, alpha, true);
 	else
+		Writer = new CTGAWriter(Ar, width, height, alpha, true, !GNoTgaCompress);
+
+	for (int i = 0; i < numStrips; i++)
 	{
-		header.image_type = 2;		// uncompressed
-		// convert to 24 bits image, when needed
-		if (colorBytes == 3)
-			for (i = 0, src = dst = pic; i < size; i++)
-			{
-				*dst++ = *src++;
-				*dst++ = *src++;
-				*dst++ = *src++;
-				src++;
-			}
-		// write data
-		Ar.Serialize(&header, sizeof(header));
-		Ar.Serialize(pic, size * colorBytes);
+		int stripIndex = Writer->BottomUp ? numStrips - 1 - i : i;
+		int numRows = min(stripRows, height - stripIndex * stripRows);
+		TexData.DecompressRows(0, stripIndex * stripRows, numRows, strip, true);
+		if (Writer->BottomUp)
+			Writer->WriteRows(strip + (numRows - 1) * pitch, numRows, -pitch);
+		else
+			Writer->WriteRows(strip, numRows, pitch);
 	}
-#endif
+	Writer->Finish();
 
-	appFree(packed);
+	delete Writer;
+	appFree(strip);
 
 	unguard;
 }
 
-
-static void WriteDDS(const CTextureData &TexData, const char *Filename)
+static void ProcessTextureExport(CTextureExportJob *Job)
 {
-	guard(WriteDDS);
+	guard(ProcessTextureExport);
 
-	if (!TexData.Mips.Num()) return;
-	const CMipMap& Mip = TexData.Mips[0];
+	const CTextureData &TexData = Job->TexData;
 
-	unsigned fourCC = TexData.GetFourCC();
+	byte *pic = NULL;
+	int width, height;
 
-	// code from CTextureData::Decompress()
-	if (!fourCC)
-		appError("unknown texture format %d \n", TexData.Format);	// should not happen - IsDXT() should not pass execution here
+	if (Job->HasData)
+	{
+		width = TexData.Mips[0].USize;
+		height = TexData.Mips[0].VSize;
+		pic = Job->TexData.Decompress(0, true);		// BGRA is native layout of TGA
+	}
 
-	nv::DDSHeader header;
-	header.setFourCC(fourCC & 0xFF, (fourCC >> 8) & 0xFF, (fourCC >> 16) & 0xFF, (fourCC >> 24) & 0xFF);
-//	header.setPixelFormat(32, 0xFF, 0xFF << 8, 0xFF << 16, 0xFF << 24);	// bit count and per-channel masks
-	//!! Note: should use setFourCC for compressed formats, and setPixelFormat for uncompressed - these functions are
-	//!! incompatible. When fourcc is used, color masks are zero, and vice versa.
-	header.setWidth(Mip.USize);
-	header.setHeight(Mip.VSize);
-//	header.setNormalFlag(TexData.Format == TPF_DXT5N || TexData.Format == TPF_3DC); -- required for decompression only
-	header.setLinearSize(Mip.DataSize);
+	if (!pic)
+	{
+		appPrintf("WARNING: texture %s has no valid mipmaps\n", Job->Name);
+		// produce 1x1-pixel image
+		// should erase file?
+		width = height = 1;
+		pic = new byte[4];
+	}
+
+	// TGA is saved with bottom-left origin (UnrealEd for UE2 have a bug with importing
+	// TGA_TOPLEFT images, it simply ignores orientation flags), writer reverses rows
+	if (GExportPNG)
+		WritePNG(Job->Output, width, height, pic, true);
+	else
+		WriteTGA(Job->Output, width, height, pic, true, true);
+
+	delete pic;
 
-	appMakeDirectoryForFile(Filename);
+	unguardf("%s", Job->Name);
+}
 
-	byte headerBuffer[128];							// DDS header is 128 bytes long
-	memset(headerBuffer, 0, 128);
-	WriteDDSHeader(headerBuffer, header);
-	FArchive *Ar = new FFileWriter(Filename);
-	Ar->Serialize(headerBuffer, 128);
-	Ar->Serialize(const_cast<byte*>(Mip.CompressedData), Mip.DataSize);
-	delete Ar;
+static void FinishTextureExport(CTextureExportJob *Job, bool Success)
+{
+	guard(FinishTextureExport);
+
+	FArchive *Ar = Success ? CreateExportArchive(Job->Tex, GExportPNG ? "%s.png" : "%s.tga", Job->Name) : NULL;
+	if (Ar)
+	{
+		Ar->Serialize(const_cast<byte*>(Job->Output.GetData()), Job->Output.GetFileSize());
+		delete Ar;
+	}
+
+	const UUnrealMaterial *Tex = Job->Tex;
+	delete Job;
+
+	Tex->ReleaseTextureData();
 
 	unguard;
 }
@@ -230,61 +489,90 @@ void ExportTexture(const UUnrealMaterial *Tex)
 	if (GDontOverwriteFiles)
 	{
 		if (CheckExportFilePresence(Tex, "%s.tga", Tex->Name)) return;
+		if (CheckExportFilePresence(Tex, "%s.png", Tex->Name)) return;
 		if (CheckExportFilePresence(Tex, "%s.dds", Tex->Name)) return;
+		if (CheckExportFilePresence(Tex, "%s.ktx2", Tex->Name)) return;
 	}
 
 	//!! for UTexture3, can check SourceArt for PNG data and save it if available
 
-	byte *pic = NULL;
-	int width, height;
+	CTextureExportJob *Job = new CTextureExportJob;
+	Job->Tex = Tex;
+	appStrncpyz(Job->Name, Tex->Name, ARRAY_COUNT(Job->Name));
 
-	CTextureData TexData;
-	if (Tex->GetTextureData(TexData))
+	Job->TexData.SkipMips   = GExportTextureMip;
+	Job->TexData.MaxMipSize = GExportTextureMaxSize;
+	Job->HasData = Tex->GetTextureData(Job->TexData);
+	if (Job->HasData)
 	{
-		if (GExportDDS && TexData.IsDXT())
+		if ((GExportDDS || GExportKTX) && ExportTextureContainer(Tex, &Job->TexData, 1))
 		{
-			WriteDDS(TexData, GetExportFileName(Tex, "%s.dds", Tex->Name));
+			delete Job;
+			Tex->ReleaseTextureData();
+			return;
+		}
+		const CMipMap &Mip = Job->TexData.Mips[0];
+		if (Mip.USize * Mip.VSize >= STRIP_EXPORT_PIXELS && Job->TexData.CanDecompressRows())
+		{
+			// large texture: decode and write it immediately, bypassing export job queue
+			FArchive *Ar = CreateExportArchive(Tex, GExportPNG ? "%s.png" : "%s.tga", Tex->Name);
+			if (Ar)
+			{
+				ExportTextureStrips(Job->TexData, *Ar);
+				delete Ar;
+			}
+			delete Job;
+			Tex->ReleaseTextureData();
 			return;
 		}
-
-		width = TexData.Mips[0].USize;
-		height = TexData.Mips[0].VSize;
-		pic = TexData.Decompress();
 	}
 
-	if (!pic)
-	{
-		appPrintf("WARNING: texture %s has no valid mipmaps\n", Tex->Name);
-		// produce 1x1-pixel tga
-		// should erase file?
-		width = height = 1;
-		pic = new byte[4];
-	}
+	// texture data is read from the package here, the rest of work is done in
+	// ProcessTextureExport() and FinishTextureExport()
+	AddExportJob(ProcessTextureExport, FinishTextureExport, Job);
 
-#if TGA_SAVE_BOTTOMLEFT
-	// flip image vertically (UnrealEd for UE2 have a bug with importing TGA_TOPLEFT images,
-	// it simply ignores orientation flags)
-	for (int i = 0; i < height / 2; i++)
-	{
-		byte *p1 = pic + width * 4 * i;
-		byte *p2 = pic + width * 4 * (height - i - 1);
-		for (int j = 0; j < width * 4; j++)
-			Exchange(p1[j], p2[j]);
-	}
-#endif
+	unguard;
+}
 
-	FArchive *Ar = CreateExportArchive(Tex, "%s.tga", Tex->Name);
-	if (!Ar)
+
+#if UNREAL3
+
+void ExportTextureCube(const UTextureCube *Tex)
+{
+	guard(ExportTextureCube);
+
+	if (GExportDDS || GExportKTX)
 	{
-		delete pic;
-		return;
-	}
-	WriteTGA(*Ar, width, height, pic);
-	delete Ar;
+		if (GDontOverwriteFiles)
+		{
+			if (CheckExportFilePresence(Tex, "%s.dds", Tex->Name)) return;
+			if (CheckExportFilePresence(Tex, "%s.ktx2", Tex->Name)) return;
+		}
 
-	delete pic;
+		// face order is the same in Unreal Engine, DDS and KTX2: +X, -X, +Y, -Y, +Z, -Z
+		const UTexture2D *FaceTex[6] = { Tex->FacePosX, Tex->FaceNegX, Tex->FacePosY, Tex->FaceNegY, Tex->FacePosZ, Tex->FaceNegZ };
+		CTextureData Faces[6];
+		bool hasData = true;
+		int i;
+		for (i = 0; i < 6 && hasData; i++)
+		{
+			Faces[i].SkipMips   = GExportTextureMip;
+			Faces[i].MaxMipSize = GExportTextureMaxSize;
+			hasData = FaceTex[i] && FaceTex[i]->GetTextureData(Faces[i]);
+		}
+		bool exported = hasData && ExportTextureContainer(Tex, Faces, 6);
+		for (i = 0; i < 6; i++)
+		{
+			Faces[i].ReleaseCompressedData();
+			if (FaceTex[i]) FaceTex[i]->ReleaseTextureData();
+		}
+		if (exported) return;
+	}
 
-	Tex->ReleaseTextureData();
+	// export as material
+	ExportMaterial(Tex);
 
 	unguard;
 }
+
+#endif // UNREAL3
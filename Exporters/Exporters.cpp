@@ -1,5 +1,6 @@
 #include "Core.h"
 #include "UnCore.h"
+#include "Parallel.h"
 
 #include "UnObject.h"
 #include "UnPackage.h"		// for Package->Name
@@ -171,6 +172,130 @@ bool ExportObject(const UObject *Obj)
 }
 
 
+/*-----------------------------------------------------------------------------
+	Parallel export
+-----------------------------------------------------------------------------*/
+
+// number of queued jobs per thread; limits memory used by unfinished jobs
+#define EXPORT_JOBS_PER_THREAD		4
+
+struct CExportJob
+{
+	ExportJobFunc_t	ProcessFunc;
+	ExportFinishFunc_t FinishFunc;
+	void			*Job;
+	char			*ErrorMessage;			// not NULL when ProcessFunc has failed
+};
+
+static TArray<CExportJob> ExportJobs;
+static bool ParallelExport = false;
+
+// Execute ProcessFunc and catch its error, so all jobs are completed and released.
+// Note: this function should not have local objects with destructors, because it
+// uses SEH when compiled with Visual C++.
+static void ProcessExportJob(CExportJob &J)
+{
+	J.ErrorMessage = NULL;
+#if DO_GUARD
+	TRY
+	{
+#endif
+		J.ProcessFunc(J.Job);
+#if DO_GUARD
+	}
+	CATCH
+	{
+		// GErrorHistory is thread-local, so the message belongs to this job
+		J.ErrorMessage = appStrdup(GErrorHistory);
+		GErrorHistory[0] = 0;
+		int len = strlen(J.ErrorMessage);
+		if (len && J.ErrorMessage[len-1] == '\n') J.ErrorMessage[len-1] = 0;
+	}
+#endif // DO_GUARD
+}
+
+static void ProcessExportJobs(CExportJob* Jobs, int First, int Last)
+{
+	for (int i = First; i < Last; i++)
+		ProcessExportJob(Jobs[i]);
+}
+
+// Call FinishFunc for all jobs in original order, report errors of failed jobs
+static void FinishExportJobs(CExportJob* Jobs, int Count)
+{
+	guard(FinishExportJobs);
+
+	char FirstError[2048];
+	FirstError[0] = 0;
+	for (int i = 0; i < Count; i++)
+	{
+		CExportJob &J = Jobs[i];
+		J.FinishFunc(J.Job, J.ErrorMessage == NULL);
+		if (J.ErrorMessage)
+		{
+			appPrintf("ERROR: %s\n", J.ErrorMessage);
+			if (!FirstError[0])
+				appStrncpyz(FirstError, J.ErrorMessage, ARRAY_COUNT(FirstError));
+			appFree(J.ErrorMessage);
+			J.ErrorMessage = NULL;
+		}
+	}
+	if (FirstError[0])
+		appError("%s", FirstError);
+
+	unguard;
+}
+
+static void FlushExportJobs()
+{
+	guard(FlushExportJobs);
+
+	int numJobs = ExportJobs.Num();
+	if (!numJobs) return;
+	appParallelFor(numJobs, 1, ProcessExportJobs, ExportJobs.GetData());
+	// write results in original order; jobs are removed from the queue before reporting errors
+	TArray<CExportJob> Jobs;
+	Exchange(Jobs, ExportJobs);
+	FinishExportJobs(Jobs.GetData(), numJobs);
+
+	unguard;
+}
+
+void AddExportJob(ExportJobFunc_t ProcessFunc, ExportFinishFunc_t FinishFunc, void *Job)
+{
+	guard(AddExportJob);
+
+	CExportJob J;
+	J.ProcessFunc = ProcessFunc;
+	J.FinishFunc  = FinishFunc;
+	J.Job         = Job;
+
+	if (!ParallelExport || GNumThreads <= 1)
+	{
+		ProcessExportJob(J);
+		FinishExportJobs(&J, 1);
+		return;
+	}
+
+	ExportJobs.Add(J);
+	if (ExportJobs.Num() >= GNumThreads * EXPORT_JOBS_PER_THREAD)
+		FlushExportJobs();
+
+	unguard;
+}
+
+void BeginParallelExport()
+{
+	ParallelExport = true;
+}
+
+void EndParallelExport()
+{
+	FlushExportJobs();
+	ParallelExport = false;
+}
+
+
 /*-----------------------------------------------------------------------------
 	Export path functions
 -----------------------------------------------------------------------------*/
@@ -32,11 +32,41 @@ bool CheckExportFilePresence(const UObject *Obj, const char *fmt, ...);
 // Function may return NULL.
 FArchive *CreateExportArchive(const UObject *Obj, const char *fmt, ...);
 
+// Parallel export support. Export of an object is split into 3 stages: object data is read
+// from the package by the exporter in the main thread, before AddExportJob() call; ProcessFunc
+// performs data conversion and should not access packages, files and export path functions,
+// so it could be executed in a worker thread; FinishFunc is called from the main thread, in
+// order of AddExportJob() calls, writes results and releases the job. Loading of packages
+// is not overlapped with export, packages are loaded in parallel by LoadWholePackages().
+// FinishFunc is called with Success=false when ProcessFunc has failed, in this case it should
+// only release the job; errors of all failed jobs are printed, then the first one is raised
+// with appError(). Outside of BeginParallelExport() and EndParallelExport() both functions
+// are called immediately.
+typedef void (*ExportJobFunc_t)(void*);
+typedef void (*ExportFinishFunc_t)(void*, bool Success);
+
+void AddExportJob(ExportJobFunc_t ProcessFunc, ExportFinishFunc_t FinishFunc, void *Job);
+
+// wrapper to avoid typecasts to ExportJobFunc_t
+template<class T>
+FORCEINLINE void AddExportJob(void (*ProcessFunc)(T*), void (*FinishFunc)(T*, bool), T *Job)
+{
+	AddExportJob((ExportJobFunc_t)ProcessFunc, (ExportFinishFunc_t)FinishFunc, (void*)Job);
+}
+
+void BeginParallelExport();
+// Execute all pending export jobs and return to serial export mode
+void EndParallelExport();
+
 // configuration
 extern bool GExportScripts;
 extern bool GExportLods;
 extern bool GNoTgaCompress;
+extern bool GExportPNG;
 extern bool GExportDDS;
+extern bool GExportKTX;
+extern int  GExportTextureMip;
+extern int  GExportTextureMaxSize;
 extern bool GUncook;
 extern bool GUseGroups;
 extern bool GDontOverwriteFiles;
@@ -45,6 +75,7 @@ extern bool GDontOverwriteFiles;
 class UObject;
 class UVertMesh;
 class UUnrealMaterial;
+class UTextureCube;
 class USound;
 class USoundNodeWave;
 class USwfMovie;
@@ -64,8 +95,10 @@ void ExportMd5Mesh(const CSkeletalMesh *Mesh);
 void ExportMd5Anim(const CAnimSet *Anim);
 // 3D
 void Export3D (const UVertMesh *Mesh);
-// TGA
+// TGA or PNG
 void ExportTexture(const UUnrealMaterial *Tex);
+// DDS or KTX2 cubemap, or material
+void ExportTextureCube(const UTextureCube *Tex);
 // UUnrealMaterial
 void ExportMaterial(const UUnrealMaterial *Mat);
 // sound
@@ -102,7 +135,12 @@ struct UniqueNameList
 	}
 };
 
-void WriteTGA(FArchive &Ar, int width, int height, byte *pic);
+// Write 32-bit image to TGA file; 'pic' has RGBA layout, or BGRA when 'isBGRA' is true.
+// Rows are stored from the bottom of the image (OpenGL order), or from the top when 'topDown'
+// is true.
+void WriteTGA(FArchive &Ar, int width, int height, const byte *pic, bool isBGRA = false, bool topDown = false);
+// Write 32-bit image to PNG file, rows are stored from the top of the image
+void WritePNG(FArchive &Ar, int width, int height, const byte *pic, bool isBGRA = false);
 
 
 #endif // __EXPORT_H__
@@ -0,0 +1,1410 @@
+#include "Core.h"
+#include "UnCore.h"
+
+#include "Exporters.h"
+#include "ImageWriter.h"
+
+#include "Parallel.h"
+
+#define USE_SSE2			1		// use SSE2 for run detection and pixel conversion
+#define VERIFY_DEFLATE		0		// decompress every PNG band with zlib and compare with source data
+
+#if USE_SSE2
+#	include <emmintrin.h>
+#endif
+
+#if VERIFY_DEFLATE
+#	include "zlib/zlib.h"
+#endif
+
+// Note: code assumes little-endian platform - 32-bit pixel has red (or blue) channel in the
+// lowest byte, and alpha in the highest one.
+
+
+/*-----------------------------------------------------------------------------
+	Per-thread scratch memory
+-----------------------------------------------------------------------------*/
+
+// Writers are never allocating memory per image: each thread has a set of memory blocks which
+// are growing on demand and reused by all subsequent images. Different slots are used by
+// code which could be active at the same time in a single thread (for example, PNG writer
+// keeps its buffers between WriteRows() calls, and calling thread also executes filter and
+// deflate jobs).
+
+enum
+{
+	SCRATCH_ROW,					// single converted row, TGA and PNG filter jobs
+	SCRATCH_DEFLATE,				// deflate job state
+	SCRATCH_PNG_DATA,				// PNG: previous row, deflate window and filtered rows
+	SCRATCH_PNG_OUTPUT,				// PNG: compressed bands
+
+	NUM_SCRATCH_SLOTS
+};
+
+static THREAD_LOCAL byte* ScratchData[NUM_SCRATCH_SLOTS];
+static THREAD_LOCAL int   ScratchSize[NUM_SCRATCH_SLOTS];
+
+// Returns memory block of at least 'Size' bytes, previous contents of the block is not preserved
+static byte* GetScratch(int Slot, int Size)
+{
+	if (ScratchSize[Slot] < Size)
+	{
+		if (ScratchData[Slot]) appFree(ScratchData[Slot]);
+		Size = Align(Size, 65536);
+		ScratchData[Slot] = (byte*)appMallocNoInit(Size, 16);
+		ScratchSize[Slot] = Size;
+	}
+	return ScratchData[Slot];
+}
+
+
+/*-----------------------------------------------------------------------------
+	Common functions
+-----------------------------------------------------------------------------*/
+
+// RGBA <-> BGRA, 'Src' and 'Dst' could point to the same buffer
+static void SwapRB(const byte *Src, byte *Dst, int Count)
+{
+	const uint32 *s = (const uint32*)Src;
+	uint32 *d = (uint32*)Dst;
+	int i = 0;
+#if USE_SSE2
+	const __m128i maskAG = _mm_set1_epi32(0xFF00FF00);
+	for ( ; i + 4 <= Count; i += 4)
+	{
+		__m128i p  = _mm_loadu_si128((const __m128i*)(s + i));
+		__m128i ag = _mm_and_si128(p, maskAG);
+		__m128i rb = _mm_andnot_si128(maskAG, p);
+		rb = _mm_or_si128(_mm_srli_epi32(rb, 16), _mm_slli_epi32(rb, 16));
+		_mm_storeu_si128((__m128i*)(d + i), _mm_or_si128(ag, rb));
+	}
+#endif // USE_SSE2
+	for ( ; i < Count; i++)
+	{
+		uint32 p = s[i];
+		d[i] = (p & 0xFF00FF00) | ((p >> 16) & 0xFF) | ((p & 0xFF) << 16);
+	}
+}
+
+bool ImageHasAlpha(const byte *Pic, int NumPixels)
+{
+	const uint32 *p = (const uint32*)Pic;
+	int i = 0;
+#if USE_SSE2
+	const __m128i maskA = _mm_set1_epi32(0xFF000000);
+	for ( ; i + 16 <= NumPixels; i += 16)
+	{
+		// 'and' of 4 vectors has opaque alpha only when all 16 pixels are opaque
+		__m128i v = _mm_and_si128(
+			_mm_and_si128(_mm_loadu_si128((const __m128i*)(p + i)),     _mm_loadu_si128((const __m128i*)(p + i + 4))),
+			_mm_and_si128(_mm_loadu_si128((const __m128i*)(p + i + 8)), _mm_loadu_si128((const __m128i*)(p + i + 12))));
+		v = _mm_cmpeq_epi32(_mm_and_si128(v, maskA), maskA);
+		if (_mm_movemask_epi8(v) != 0xFFFF)
+			return true;
+	}
+#endif // USE_SSE2
+	for ( ; i < NumPixels; i++)
+		if ((p[i] >> 24) != 255)
+			return true;
+	return false;
+}
+
+static FORCEINLINE void PutBE32(byte *Dst, uint32 Value)
+{
+	Dst[0] = Value >> 24;
+	Dst[1] = (Value >> 16) & 0xFF;
+	Dst[2] = (Value >> 8) & 0xFF;
+	Dst[3] = Value & 0xFF;
+}
+
+
+/*-----------------------------------------------------------------------------
+	TGA writer
+-----------------------------------------------------------------------------*/
+
+#define TGA_SAVE_BOTTOMLEFT	1
+
+
+#define TGA_ORIGIN_MASK		0x30
+#define TGA_BOTLEFT			0x00
+#define TGA_BOTRIGHT		0x10					// unused
+#define TGA_TOPLEFT			0x20
+#define TGA_TOPRIGHT		0x30					// unused
+
+#if _MSC_VER
+#pragma pack(push,1)
+#endif
+
+struct GCC_PACK tgaHdr_t
+{
+	byte 	id_length, colormap_type, image_type;
+	uint16	colormap_index, colormap_length;
+	byte	colormap_size;
+	uint16	x_origin, y_origin;				// unused
+	uint16	width, height;
+	byte	pixel_size, attributes;
+};
+
+#if _MSC_VER
+#pragma pack(pop)
+#endif
+
+// Buffer size enough for a single TGA row in the worst case: pixel data plus packet headers
+#define TGA_MAX_ROW_SIZE(width)		((width) * 5 + 16)
+
+// Number of bits in 4-bit value before the first set bit, 4 for zero
+static const byte FirstSetBit4[16] = { 4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0 };
+
+// Find the first pixel in [First, Last) which is equal to the next one, return 'Last' when
+// there's no such pixel. Pixel with index 'Last' should exist.
+static int FindRunStart(const uint32 *p, int First, int Last)
+{
+	int i = First;
+#if USE_SSE2
+	for ( ; i + 4 <= Last; i += 4)
+	{
+		__m128i eq = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(p + i)), _mm_loadu_si128((const __m128i*)(p + i + 1)));
+		int mask = _mm_movemask_ps(_mm_castsi128_ps(eq));
+		if (mask) return i + FirstSetBit4[mask];
+	}
+#endif // USE_SSE2
+	for ( ; i < Last; i++)
+		if (p[i] == p[i + 1]) return i;
+	return Last;
+}
+
+// Find the first pixel in [First, Last) which differs from the next one, return 'Last' when
+// all pixels are the same
+static int FindRunEnd(const uint32 *p, int First, int Last)
+{
+	int i = First;
+#if USE_SSE2
+	for ( ; i + 4 <= Last; i += 4)
+	{
+		__m128i eq = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(p + i)), _mm_loadu_si128((const __m128i*)(p + i + 1)));
+		int mask = ~_mm_movemask_ps(_mm_castsi128_ps(eq)) & 15;
+		if (mask) return i + FirstSetBit4[mask];
+	}
+#endif // USE_SSE2
+	for ( ; i < Last; i++)
+		if (p[i] != p[i + 1]) return i;
+	return Last;
+}
+
+// Store 'Count' BGRA pixels as 24 or 32-bit, returns pointer to the end of stored data.
+// Note: 24-bit version writes one extra byte after the data.
+static FORCEINLINE byte* StoreTGAPixels(const uint32 *p, int Count, int colorBytes, byte *dst)
+{
+	if (colorBytes == 4)
+	{
+		memcpy(dst, p, Count * 4);
+		return dst + Count * 4;
+	}
+	for (int i = 0; i < Count; i++, dst += 3)
+		memcpy(dst, p + i, 4);
+	return dst;
+}
+
+// Compress a row of BGRA pixels with TGA RLE. Runs of 2 or more equal pixels are stored as RLE
+// packets, everything else as raw packets. Packets never cross the row boundary, so rows are
+// compressed independently. Returns number of bytes written to 'dst'.
+static int CompressTGARow(const byte *src, int width, int colorBytes, byte *dst)
+{
+	const uint32 *p = (const uint32*)src;
+	byte *start = dst;
+	int last = width - 1;
+	int i = 0;
+
+	while (i < width)
+	{
+		// raw pixels, up to the next run
+		int runStart = FindRunStart(p, i, last);
+		int rawEnd = (runStart < last) ? runStart : width;
+		while (i < rawEnd)
+		{
+			int n = min(rawEnd - i, 128);
+			*dst++ = n - 1;
+			dst = StoreTGAPixels(p + i, n, colorBytes, dst);
+			i += n;
+		}
+		if (i >= width) break;
+
+		// run of equal pixels
+		int count = FindRunEnd(p, i, last) - i + 1;
+		while (count >= 2)
+		{
+			int n = min(count, 128);
+			*dst++ = 128 + n - 1;
+			dst = StoreTGAPixels(p + i, 1, colorBytes, dst);
+			i += n;
+			count -= n;
+		}
+		// when a single pixel remains, it is stored with following raw pixels
+	}
+
+	return dst - start;
+}
+
+CTGAWriter::CTGAWriter(FArchive &InAr, int InWidth, int InHeight, bool InAlpha, bool InBGRA, bool InCompress)
+:	CImageWriter(InAr, InWidth, InHeight, InAlpha, InBGRA)
+,	StopWhenEnlarged(false)
+,	Enlarged(false)
+,	Compress(InCompress)
+,	PackedSize(0)
+{
+	BottomUp = TGA_SAVE_BOTTOMLEFT;
+	int colorBytes = Alpha ? 4 : 3;
+	Threshold = Width * Height * colorBytes - 16;
+
+	tgaHdr_t header;
+	memset(&header, 0, sizeof(header));
+	header.width  = Width;
+	header.height = Height;
+	header.pixel_size = colorBytes * 8;
+#if TGA_SAVE_BOTTOMLEFT
+	header.attributes = TGA_BOTLEFT;
+#else
+	header.attributes = TGA_TOPLEFT;
+#endif
+	header.image_type = Compress ? 10 : 2;		// RLE or uncompressed
+	Ar.Serialize(&header, sizeof(header));
+}
+
+void CTGAWriter::WriteRows(const byte *Pic, int NumRows, int Pitch)
+{
+	guard(CTGAWriter::WriteRows);
+
+	if (Enlarged) return;
+
+	int colorBytes = Alpha ? 4 : 3;
+	int rowSize = Width * 4;
+	byte *row = GetScratch(SCRATCH_ROW, TGA_MAX_ROW_SIZE(Width) + rowSize);
+	byte *swapped = row + TGA_MAX_ROW_SIZE(Width);
+
+	for (int i = 0; i < NumRows; i++, Pic += Pitch)
+	{
+		const byte *src = Pic;
+		if (!BGRA)
+		{
+			SwapRB(src, swapped, Width);
+			src = swapped;
+		}
+		if (!Compress && colorBytes == 4)
+		{
+			// no conversion required
+			Ar.Serialize(const_cast<byte*>(src), rowSize);
+			continue;
+		}
+		int size = Compress
+			? CompressTGARow(src, Width, colorBytes, row)
+			: (int)(StoreTGAPixels((const uint32*)src, Width, colorBytes, row) - row);
+		if (Compress && StopWhenEnlarged && PackedSize + size >= Threshold)
+		{
+			Enlarged = true;
+			return;
+		}
+		Ar.Serialize(row, size);
+		PackedSize += size;
+	}
+
+	unguard;
+}
+
+void WriteTGA(FArchive &Ar, int width, int height, const byte *pic, bool isBGRA, bool topDown)
+{
+	guard(WriteTGA);
+
+	// check for 24 bit image possibility
+	bool alpha = ImageHasAlpha(pic, width * height);
+	int pitch = width * 4;
+	if (topDown == (TGA_SAVE_BOTTOMLEFT != 0))
+	{
+		// rows should be passed in file order, reverse them
+		pic += (height - 1) * pitch;
+		pitch = -pitch;
+	}
+
+	if (!GNoTgaCompress)
+	{
+		int start = Ar.Tell();
+		CTGAWriter Writer(Ar, width, height, alpha, isBGRA, true);
+		Writer.StopWhenEnlarged = true;
+		Writer.WriteRows(pic, height, pitch);
+		if (!Writer.Enlarged) return;
+		// compressed image is too large, save uncompressed; new data will overwrite
+		// everything which was written
+		Ar.Seek(start);
+	}
+
+	CTGAWriter Writer(Ar, width, height, alpha, isBGRA, false);
+	Writer.WriteRows(pic, height, pitch);
+
+	unguard;
+}
+
+
+/*-----------------------------------------------------------------------------
+	Deflate encoder
+-----------------------------------------------------------------------------*/
+
+// Deflate (RFC 1951) encoder: LZ77 matching using hash chains with one-step lazy evaluation,
+// the same scheme as zlib uses for levels 4-9, and blocks encoded with dynamic Huffman codes,
+// fixed codes or stored, whatever is smaller. Data is compressed in independent bands, every
+// band could use data preceding it as a dictionary, so bands could be compressed in parallel
+// with almost no loss of compression ratio.
+
+#define DEFLATE_WINDOW			32768
+#define DEFLATE_HASH_BITS		15
+#define DEFLATE_MIN_MATCH		3
+#define DEFLATE_MAX_MATCH		258
+#define DEFLATE_MAX_CHAIN		128
+#define DEFLATE_GOOD_MATCH		8		// use shorter chain when previous match is at least that long
+#define DEFLATE_MAX_LAZY		16		// don't try to find a better match when previous match is that long
+#define DEFLATE_NICE_MATCH		128		// stop searching when match of this length is found
+#define DEFLATE_TOO_FAR			4096	// minimal matches with larger distance are not worth encoding
+#define DEFLATE_MAX_SYMBOLS		16384	// number of literals and matches in a single block
+
+// Upper limit of compressed data size, when every block is stored; includes flush marker
+#define DEFLATE_BOUND(size)		((size) + (size) / 1024 + 64)
+
+struct CDeflateState
+{
+	int			Head[1 << DEFLATE_HASH_BITS];
+	int			Prev[DEFLATE_WINDOW];
+	uint32		Symbols[DEFLATE_MAX_SYMBOLS];	// literal, or (distance << 9) | length
+};
+
+static const byte CodeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+static const uint16 LengthBase[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const byte LengthExtra[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16 DistBase[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769,
+	1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const byte DistExtra[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+// Tables computed at startup
+static byte   LengthCode[DEFLATE_MAX_MATCH + 1];	// match length -> length code index
+static byte   DistCode[512];						// see GetDistCode()
+static byte   FixedLitLengths[288];
+static uint16 FixedLitCodes[288];
+static byte   FixedDistLengths[30];
+static uint16 FixedDistCodes[30];
+static uint32 CRCTable[256];
+
+static FORCEINLINE int GetDistCode(int Dist)
+{
+	Dist--;
+	return (Dist < 256) ? DistCode[Dist] : DistCode[256 + (Dist >> 7)];
+}
+
+// Compute canonical Huffman codes for given code lengths; codes are bit-reversed, because
+// deflate stores them starting from the most significant bit
+static void BuildHuffmanCodes(const byte *Lengths, int Count, uint16 *Codes)
+{
+	int numCodes[16], nextCode[16];
+	memset(numCodes, 0, sizeof(numCodes));
+	int i;
+	for (i = 0; i < Count; i++)
+		numCodes[Lengths[i]]++;
+	numCodes[0] = 0;
+	int code = 0;
+	for (i = 1; i < 16; i++)
+	{
+		code = (code + numCodes[i - 1]) << 1;
+		nextCode[i] = code;
+	}
+	for (i = 0; i < Count; i++)
+	{
+		int len = Lengths[i];
+		if (!len) continue;
+		unsigned c = nextCode[len]++;
+		unsigned r = 0;
+		for (int j = 0; j < len; j++, c >>= 1)
+			r = (r << 1) | (c & 1);
+		Codes[i] = r;
+	}
+}
+
+static int CompareHuffmanKeys(const void *a, const void *b)
+{
+	uint32 k1 = *(const uint32*)a, k2 = *(const uint32*)b;
+	return (k1 < k2) ? -1 : (k1 > k2) ? 1 : 0;
+}
+
+// Compute Huffman code lengths, limited to 'MaxBits'. Uses in-place algorithm by Moffat and
+// Katajainen, and then limits code lengths keeping Kraft sum equal to 1.
+static void BuildHuffmanLengths(const int *Freq, int Count, int MaxBits, byte *Lengths)
+{
+	uint32 keys[288];
+	int A[288];
+	int n = 0, i;
+
+	memset(Lengths, 0, Count);
+	// sort used symbols by frequency; key is (frequency << 9) | symbol
+	for (i = 0; i < Count; i++)
+		if (Freq[i]) keys[n++] = (Freq[i] << 9) | i;
+	// deflate decoders require at least 2 codes (zlib does the same)
+	for (i = 0; n < 2 && i < Count; i++)
+		if (!Freq[i]) keys[n++] = (1 << 9) | i;
+	qsort(keys, n, sizeof(keys[0]), CompareHuffmanKeys);
+	for (i = 0; i < n; i++)
+		A[i] = keys[i] >> 9;
+
+	// compute code lengths, result is placed to A[], from the longest code to the shortest one
+	int root, leaf, next;
+	A[0] += A[1];
+	root = 0;
+	leaf = 2;
+	for (next = 1; next < n - 1; next++)
+	{
+		if (leaf >= n || A[root] < A[leaf])
+		{
+			A[next] = A[root];
+			A[root++] = next;
+		}
+		else
+		{
+			A[next] = A[leaf++];
+		}
+		if (leaf >= n || (root < next && A[root] < A[leaf]))
+		{
+			A[next] += A[root];
+			A[root++] = next;
+		}
+		else
+		{
+			A[next] += A[leaf++];
+		}
+	}
+	A[n - 2] = 0;
+	for (next = n - 3; next >= 0; next--)
+		A[next] = A[A[next]] + 1;
+	int avail = 1, used = 0, depth = 0;
+	root = n - 2;
+	next = n - 1;
+	while (avail > 0)
+	{
+		while (root >= 0 && A[root] == depth)
+		{
+			used++;
+			root--;
+		}
+		while (avail > used)
+		{
+			A[next--] = depth;
+			avail--;
+		}
+		avail = 2 * used;
+		depth++;
+		used = 0;
+	}
+
+	// limit code lengths
+	int numCodes[33];
+	memset(numCodes, 0, sizeof(numCodes));
+	for (i = 0; i < n; i++)
+		numCodes[min(A[i], 32)]++;
+	for (i = MaxBits + 1; i <= 32; i++)
+		numCodes[MaxBits] += numCodes[i];
+	uint32 total = 0;
+	for (i = MaxBits; i > 0; i--)
+		total += (uint32)numCodes[i] << (MaxBits - i);
+	while (total != (1u << MaxBits))
+	{
+		numCodes[MaxBits]--;
+		for (i = MaxBits - 1; i > 0; i--)
+		{
+			if (numCodes[i])
+			{
+				numCodes[i]--;
+				numCodes[i + 1] += 2;
+				break;
+			}
+		}
+		total--;
+	}
+
+	// the most frequent symbols are receiving the shortest codes
+	next = n;
+	for (i = 1; i <= MaxBits; i++)
+		for (int j = numCodes[i]; j > 0; j--)
+			Lengths[keys[--next] & 511] = i;
+}
+
+struct CBitWriter
+{
+	byte		*Dst;
+	uint64		Bits;
+	int			Count;
+
+	CBitWriter(byte *InDst)
+	:	Dst(InDst)
+	,	Bits(0)
+	,	Count(0)
+	{}
+
+	FORCEINLINE void Put(uint32 Value, int NumBits)
+	{
+		Bits |= (uint64)Value << Count;
+		Count += NumBits;
+		if (Count >= 32)
+		{
+			Dst[0] = (byte)Bits;
+			Dst[1] = (byte)(Bits >> 8);
+			Dst[2] = (byte)(Bits >> 16);
+			Dst[3] = (byte)(Bits >> 24);
+			Dst += 4;
+			Bits >>= 32;
+			Count -= 32;
+		}
+	}
+
+	// Pad to the byte boundary
+	void Align()
+	{
+		while (Count > 0)
+		{
+			*Dst++ = (byte)Bits;
+			Bits >>= 8;
+			Count -= 8;
+		}
+		Bits = 0;
+		Count = 0;
+	}
+};
+
+static void WriteStoredBlocks(CBitWriter &Bits, const byte *Data, int Size, bool Final)
+{
+	do
+	{
+		int n = min(Size, 65535);
+		Size -= n;
+		Bits.Put((Final && !Size) ? 1 : 0, 3);		// BFINAL, BTYPE = 00
+		Bits.Align();
+		byte *d = Bits.Dst;
+		d[0] = n & 0xFF;
+		d[1] = n >> 8;
+		d[2] = ~n & 0xFF;
+		d[3] = (~n >> 8) & 0xFF;
+		if (n) memcpy(d + 4, Data, n);
+		Bits.Dst = d + 4 + n;
+		Data += n;
+	} while (Size > 0);
+}
+
+static void WriteSymbols(CBitWriter &Bits, const uint32 *Symbols, int NumSymbols,
+	const byte *LitLengths, const uint16 *LitCodes, const byte *DistLengths, const uint16 *DistCodes)
+{
+	for (int i = 0; i < NumSymbols; i++)
+	{
+		uint32 s = Symbols[i];
+		if (s < 256)
+		{
+			Bits.Put(LitCodes[s], LitLengths[s]);
+			continue;
+		}
+		int len = s & 511;
+		int dist = s >> 9;
+		int lc = LengthCode[len];
+		Bits.Put(LitCodes[257 + lc], LitLengths[257 + lc]);
+		if (LengthExtra[lc]) Bits.Put(len - LengthBase[lc], LengthExtra[lc]);
+		int dc = GetDistCode(dist);
+		Bits.Put(DistCodes[dc], DistLengths[dc]);
+		if (DistExtra[dc]) Bits.Put(dist - DistBase[dc], DistExtra[dc]);
+	}
+	Bits.Put(LitCodes[256], LitLengths[256]);		// end of block
+}
+
+// Encode a block of symbols which were produced from 'RawSize' bytes at 'Raw'
+static void WriteBlock(CBitWriter &Bits, const uint32 *Symbols, int NumSymbols, const byte *Raw, int RawSize, bool Final)
+{
+	int litFreq[286], distFreq[30];
+	memset(litFreq, 0, sizeof(litFreq));
+	memset(distFreq, 0, sizeof(distFreq));
+	int i;
+	for (i = 0; i < NumSymbols; i++)
+	{
+		uint32 s = Symbols[i];
+		if (s < 256)
+		{
+			litFreq[s]++;
+		}
+		else
+		{
+			litFreq[257 + LengthCode[s & 511]]++;
+			distFreq[GetDistCode(s >> 9)]++;
+		}
+	}
+	litFreq[256] = 1;
+
+	byte litLengths[286], distLengths[30];
+	BuildHuffmanLengths(litFreq, 286, 15, litLengths);
+	BuildHuffmanLengths(distFreq, 30, 15, distLengths);
+
+	int numLit = 286, numDist = 30;
+	while (numLit > 257 && !litLengths[numLit - 1]) numLit--;
+	while (numDist > 1 && !distLengths[numDist - 1]) numDist--;
+
+	// run-length encode code lengths of both trees, symbol is (code | (extra bits value << 8))
+	byte lengths[286 + 30];
+	memcpy(lengths, litLengths, numLit);
+	memcpy(lengths + numLit, distLengths, numDist);
+	int total = numLit + numDist;
+	uint32 clSymbols[286 + 30];
+	int numClSymbols = 0;
+	int clFreq[19];
+	memset(clFreq, 0, sizeof(clFreq));
+	for (i = 0; i < total; )
+	{
+		int len = lengths[i];
+		int run = 1;
+		while (i + run < total && lengths[i + run] == len) run++;
+		i += run;
+		if (len == 0)
+		{
+			while (run >= 11)
+			{
+				int n = min(run, 138);
+				clSymbols[numClSymbols++] = 18 | ((n - 11) << 8);
+				run -= n;
+			}
+			if (run >= 3)
+			{
+				clSymbols[numClSymbols++] = 17 | ((run - 3) << 8);
+				run = 0;
+			}
+		}
+		else
+		{
+			clSymbols[numClSymbols++] = len;
+			run--;
+			while (run >= 3)
+			{
+				int n = min(run, 6);
+				clSymbols[numClSymbols++] = 16 | ((n - 3) << 8);
+				run -= n;
+			}
+		}
+		while (run-- > 0)
+			clSymbols[numClSymbols++] = len;
+	}
+	for (i = 0; i < numClSymbols; i++)
+		clFreq[clSymbols[i] & 0xFF]++;
+	byte clLengths[19];
+	BuildHuffmanLengths(clFreq, 19, 7, clLengths);
+	int numCl = 19;
+	while (numCl > 4 && !clLengths[CodeLengthOrder[numCl - 1]]) numCl--;
+
+	// compute sizes of all block types
+	int extraBits = 0, dynamicBits = 0, fixedBits = 0;
+	for (i = 0; i < 286; i++)
+	{
+		dynamicBits += litFreq[i] * litLengths[i];
+		fixedBits   += litFreq[i] * FixedLitLengths[i];
+		if (i > 256) extraBits += litFreq[i] * LengthExtra[i - 257];
+	}
+	for (i = 0; i < 30; i++)
+	{
+		dynamicBits += distFreq[i] * distLengths[i];
+		fixedBits   += distFreq[i] * 5;
+		extraBits   += distFreq[i] * DistExtra[i];
+	}
+	dynamicBits += extraBits + 3 + 14 + numCl * 3;
+	for (i = 0; i < 19; i++)
+		dynamicBits += clFreq[i] * clLengths[i];
+	dynamicBits += clFreq[16] * 2 + clFreq[17] * 3 + clFreq[18] * 7;
+	fixedBits += extraBits + 3;
+	int storedBits = RawSize * 8 + (RawSize / 65535 + 1) * 42;
+
+	if (storedBits < dynamicBits && storedBits < fixedBits)
+	{
+		WriteStoredBlocks(Bits, Raw, RawSize, Final);
+	}
+	else if (fixedBits <= dynamicBits)
+	{
+		Bits.Put(Final ? 3 : 2, 3);					// BFINAL, BTYPE = 01
+		WriteSymbols(Bits, Symbols, NumSymbols, FixedLitLengths, FixedLitCodes, FixedDistLengths, FixedDistCodes);
+	}
+	else
+	{
+		uint16 litCodes[286], distCodes[30], clCodes[19];
+		BuildHuffmanCodes(litLengths, 286, litCodes);
+		BuildHuffmanCodes(distLengths, 30, distCodes);
+		BuildHuffmanCodes(clLengths, 19, clCodes);
+		Bits.Put(Final ? 5 : 4, 3);					// BFINAL, BTYPE = 10
+		Bits.Put(numLit - 257, 5);
+		Bits.Put(numDist - 1, 5);
+		Bits.Put(numCl - 4, 4);
+		for (i = 0; i < numCl; i++)
+			Bits.Put(clLengths[CodeLengthOrder[i]], 3);
+		static const byte clExtra[3] = { 2, 3, 7 };
+		for (i = 0; i < numClSymbols; i++)
+		{
+			int code = clSymbols[i] & 0xFF;
+			Bits.Put(clCodes[code], clLengths[code]);
+			if (code >= 16) Bits.Put(clSymbols[i] >> 8, clExtra[code - 16]);
+		}
+		WriteSymbols(Bits, Symbols, NumSymbols, litLengths, litCodes, distLengths, distCodes);
+	}
+}
+
+static FORCEINLINE uint32 DeflateHash(const byte *p)
+{
+	uint32 v = p[0] | (p[1] << 8) | (p[2] << 16);
+	return (v * 0x9E3779B1) >> (32 - DEFLATE_HASH_BITS);
+}
+
+static FORCEINLINE int MatchLength(const byte *a, const byte *b, int MaxLength)
+{
+	int len = 0;
+	while (len + 4 <= MaxLength)
+	{
+		uint32 x, y;
+		memcpy(&x, a + len, 4);
+		memcpy(&y, b + len, 4);
+		if (x != y) break;
+		len += 4;
+	}
+	while (len < MaxLength && a[len] == b[len])
+		len++;
+	return len;
+}
+
+// Compress Data[Start, End), bytes from Data[DictStart] are used as dictionary. When 'Final' is
+// false, data is terminated with an empty stored block, so it ends on the byte boundary, and
+// the next band could be appended. Returns size of compressed data.
+static int DeflateBlock(const byte *Data, int DictStart, int Start, int End, bool Final, byte *Out)
+{
+	CDeflateState *S = (CDeflateState*)GetScratch(SCRATCH_DEFLATE, sizeof(CDeflateState));
+	memset(S->Head, 0xFF, sizeof(S->Head));
+
+	int pos;
+	for (pos = DictStart; pos < Start && pos + DEFLATE_MIN_MATCH <= End; pos++)
+	{
+		uint32 h = DeflateHash(Data + pos);
+		S->Prev[pos & (DEFLATE_WINDOW - 1)] = S->Head[h];
+		S->Head[h] = pos;
+	}
+
+	CBitWriter Bits(Out);
+	int numSymbols = 0;
+	int blockStart = Start;
+	int done = Start;						// all data before this position is encoded
+
+	// match found at the previous position, it is emitted only when the current position
+	// has no better match
+	int prevLen = DEFLATE_MIN_MATCH - 1;
+	int prevDist = 0;
+
+	for (pos = Start; pos < End; pos++)
+	{
+		int bestLen = DEFLATE_MIN_MATCH - 1;
+		int bestDist = 0;
+		int maxLen = min(End - pos, DEFLATE_MAX_MATCH);
+		if (maxLen >= DEFLATE_MIN_MATCH)
+		{
+			const byte *p = Data + pos;
+			uint32 h = DeflateHash(p);
+			int cand = S->Head[h];
+			S->Prev[pos & (DEFLATE_WINDOW - 1)] = cand;
+			S->Head[h] = pos;
+			if (prevLen < DEFLATE_MAX_LAZY && prevLen < maxLen)
+			{
+				// look for a match which is longer than the previous one
+				bestLen = prevLen;
+				int minPos = max(pos - DEFLATE_WINDOW, -1);
+				int chain = (prevLen >= DEFLATE_GOOD_MATCH) ? DEFLATE_MAX_CHAIN / 4 : DEFLATE_MAX_CHAIN;
+				for ( ; cand > minPos && chain > 0; chain--)
+				{
+					const byte *c = Data + cand;
+					if (c[bestLen] == p[bestLen] && c[0] == p[0] && c[1] == p[1])
+					{
+						int len = MatchLength(c, p, maxLen);
+						if (len > bestLen)
+						{
+							bestLen = len;
+							bestDist = pos - cand;
+							if (len >= DEFLATE_NICE_MATCH || len == maxLen) break;
+						}
+					}
+					int next = S->Prev[cand & (DEFLATE_WINDOW - 1)];
+					if (next >= cand) break;		// slot was reused by newer position
+					cand = next;
+				}
+				if (!bestDist || (bestLen == DEFLATE_MIN_MATCH && bestDist > DEFLATE_TOO_FAR))
+				{
+					bestLen = DEFLATE_MIN_MATCH - 1;
+					bestDist = 0;
+				}
+			}
+		}
+
+		if (prevDist && bestLen <= prevLen)
+		{
+			// the previous match is better, emit it
+			S->Symbols[numSymbols++] = (prevDist << 9) | prevLen;
+			done = pos - 1 + prevLen;
+			// insert skipped positions to the hash
+			int last = min(done, End - DEFLATE_MIN_MATCH + 1);
+			for (int i = pos + 1; i < last; i++)
+			{
+				uint32 h = DeflateHash(Data + i);
+				S->Prev[i & (DEFLATE_WINDOW - 1)] = S->Head[h];
+				S->Head[h] = i;
+			}
+			pos = done - 1;
+			prevLen = DEFLATE_MIN_MATCH - 1;
+			prevDist = 0;
+		}
+		else
+		{
+			// emit the previous byte as literal, and defer decision for the current one
+			if (pos > done)
+			{
+				S->Symbols[numSymbols++] = Data[pos - 1];
+				done = pos;
+			}
+			prevLen = bestLen;
+			prevDist = bestDist;
+		}
+
+		if (numSymbols == DEFLATE_MAX_SYMBOLS)
+		{
+			WriteBlock(Bits, S->Symbols, numSymbols, Data + blockStart, done - blockStart, Final && done == End);
+			numSymbols = 0;
+			blockStart = done;
+		}
+	}
+	if (done < End)
+	{
+		// the last byte, it has no match
+		S->Symbols[numSymbols++] = Data[End - 1];
+		done = End;
+	}
+	if (numSymbols || blockStart == Start)
+		WriteBlock(Bits, S->Symbols, numSymbols, Data + blockStart, done - blockStart, Final);
+
+	if (!Final)
+		WriteStoredBlocks(Bits, NULL, 0, false);	// sync marker, aligns data to byte boundary
+	Bits.Align();
+	return Bits.Dst - Out;
+}
+
+static uint32 Adler32(const byte *Data, int Size)
+{
+	const uint32 BASE = 65521;
+	uint32 s1 = 1, s2 = 0;
+	while (Size > 0)
+	{
+		int n = min(Size, 5552);			// largest n which doesn't overflow s2
+		Size -= n;
+		for (int i = 0; i < n; i++)
+		{
+			s1 += Data[i];
+			s2 += s1;
+		}
+		Data += n;
+		s1 %= BASE;
+		s2 %= BASE;
+	}
+	return s1 | (s2 << 16);
+}
+
+// Compute Adler-32 of concatenated data, the same code as adler32_combine() from zlib
+static uint32 Adler32Combine(uint32 Adler1, uint32 Adler2, int Size2)
+{
+	const uint32 BASE = 65521;
+	uint32 rem = Size2 % BASE;
+	uint32 sum1 = Adler1 & 0xFFFF;
+	uint32 sum2 = (rem * sum1) % BASE;
+	sum1 += (Adler2 & 0xFFFF) + BASE - 1;
+	sum2 += (Adler1 >> 16) + (Adler2 >> 16) + BASE - rem;
+	if (sum1 >= BASE) sum1 -= BASE;
+	if (sum1 >= BASE) sum1 -= BASE;
+	if (sum2 >= (BASE << 1)) sum2 -= (BASE << 1);
+	if (sum2 >= BASE) sum2 -= BASE;
+	return sum1 | (sum2 << 16);
+}
+
+static uint32 UpdateCRC(uint32 CRC, const byte *Data, int Size)
+{
+	CRC = ~CRC;
+	for (int i = 0; i < Size; i++)
+		CRC = CRCTable[(CRC ^ Data[i]) & 0xFF] ^ (CRC >> 8);
+	return ~CRC;
+}
+
+static struct CImageWriterTables
+{
+	CImageWriterTables()
+	{
+		int i, j;
+		for (i = 0; i < 28; i++)
+			for (j = 0; j < (1 << LengthExtra[i]); j++)
+				LengthCode[LengthBase[i] + j] = i;
+		LengthCode[DEFLATE_MAX_MATCH] = 28;			// code 27 covers 258 too, but 258 has own code
+		for (i = 0; i < 30; i++)
+		{
+			for (j = 0; j < (1 << DistExtra[i]); j++)
+			{
+				int dist = DistBase[i] + j - 1;
+				if (dist < 256)
+					DistCode[dist] = i;
+				else
+					DistCode[256 + (dist >> 7)] = i;
+			}
+		}
+		for (i = 0; i < 288; i++)
+			FixedLitLengths[i] = (i < 144) ? 8 : (i < 256) ? 9 : (i < 280) ? 7 : 8;
+		BuildHuffmanCodes(FixedLitLengths, 288, FixedLitCodes);
+		for (i = 0; i < 30; i++)
+			FixedDistLengths[i] = 5;
+		BuildHuffmanCodes(FixedDistLengths, 30, FixedDistCodes);
+		for (i = 0; i < 256; i++)
+		{
+			uint32 c = i;
+			for (j = 0; j < 8; j++)
+				c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+			CRCTable[i] = c;
+		}
+	}
+} ImageWriterTables;
+
+
+/*-----------------------------------------------------------------------------
+	PNG writer
+-----------------------------------------------------------------------------*/
+
+// Rows are filtered and compressed in parallel by bands of this size
+#define PNG_BAND_SIZE			(256*1024)
+
+// Convert a row of 32-bit pixels to PNG layout; returns 'Src' when conversion is not required.
+// Note: 3-byte version writes one extra byte after the data.
+static const byte* ConvertPNGRow(const byte *Src, byte *Dst, int Width, int ColorBytes, bool BGRA)
+{
+	if (ColorBytes == 4)
+	{
+		if (!BGRA) return Src;
+		SwapRB(Src, Dst, Width);
+		return Dst;
+	}
+	const uint32 *s = (const uint32*)Src;
+	if (BGRA)
+	{
+		for (int i = 0; i < Width; i++, Dst += 3)
+		{
+			uint32 p = s[i];
+			p = ((p >> 16) & 0xFF) | (p & 0xFF00) | ((p & 0xFF) << 16);
+			memcpy(Dst, &p, 4);
+		}
+	}
+	else
+	{
+		for (int i = 0; i < Width; i++, Dst += 3)
+			memcpy(Dst, s + i, 4);
+	}
+	return Dst - Width * 3;
+}
+
+static FORCEINLINE int FilterCost(int v)
+{
+	v &= 0xFF;
+	return (v < 128) ? v : 256 - v;
+}
+
+static FORCEINLINE int PaethPredictor(int a, int b, int c)
+{
+	int pa = abs(b - c);
+	int pb = abs(a - c);
+	int pc = abs(a + b - c - c);
+	if (pa <= pb && pa <= pc) return a;
+	return (pb <= pc) ? b : c;
+}
+
+#if USE_SSE2
+
+// Absolute value of signed bytes, as unsigned bytes
+static FORCEINLINE __m128i FilterCost16(__m128i v)
+{
+	return _mm_min_epu8(v, _mm_sub_epi8(_mm_setzero_si128(), v));
+}
+
+static FORCEINLINE __m128i Abs16(__m128i v)
+{
+	return _mm_max_epi16(v, _mm_sub_epi16(_mm_setzero_si128(), v));
+}
+
+// PaethPredictor() for 8 16-bit values
+static FORCEINLINE __m128i PaethPredictor8(__m128i a, __m128i b, __m128i c)
+{
+	__m128i p1 = _mm_sub_epi16(b, c);
+	__m128i p2 = _mm_sub_epi16(a, c);
+	__m128i pa = Abs16(p1);
+	__m128i pb = Abs16(p2);
+	__m128i pc = Abs16(_mm_add_epi16(p1, p2));
+	__m128i notA = _mm_or_si128(_mm_cmpgt_epi16(pa, pb), _mm_cmpgt_epi16(pa, pc));
+	__m128i useC = _mm_cmpgt_epi16(pb, pc);
+	__m128i bc = _mm_or_si128(_mm_and_si128(useC, c), _mm_andnot_si128(useC, b));
+	return _mm_or_si128(_mm_and_si128(notA, bc), _mm_andnot_si128(notA, a));
+}
+
+#endif // USE_SSE2
+
+// Apply all PNG filters to the row and store the one with minimal sum of absolute values, this
+// is heuristic suggested by PNG specification. 'Temp' should have space for 4 rows.
+static void FilterPNGRow(const byte *Cur, const byte *Prev, int Size, int Bpp, byte *Dst, byte *Temp)
+{
+	byte *sub = Temp, *up = Temp + Size, *avg = Temp + Size * 2, *paeth = Temp + Size * 3;
+	int cost[5] = { 0, 0, 0, 0, 0 };
+	int i;
+	for (i = 0; i < Bpp; i++)
+	{
+		int x = Cur[i], b = Prev[i];
+		sub[i]   = x;
+		up[i]    = x - b;
+		avg[i]   = x - (b >> 1);
+		paeth[i] = x - b;
+		cost[0] += FilterCost(x);
+		cost[1] += FilterCost(x);
+		cost[2] += FilterCost(x - b);
+		cost[3] += FilterCost(x - (b >> 1));
+		cost[4] += FilterCost(x - b);
+	}
+#if USE_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one  = _mm_set1_epi8(1);
+	__m128i sum[5];
+	for (int k = 0; k < 5; k++) sum[k] = zero;
+	for ( ; i + 16 <= Size; i += 16)
+	{
+		__m128i x = _mm_loadu_si128((const __m128i*)(Cur + i));
+		__m128i a = _mm_loadu_si128((const __m128i*)(Cur + i - Bpp));
+		__m128i b = _mm_loadu_si128((const __m128i*)(Prev + i));
+		__m128i c = _mm_loadu_si128((const __m128i*)(Prev + i - Bpp));
+		// _mm_avg_epu8() rounds up, PNG requires rounding down
+		__m128i ab = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+		__m128i p = _mm_packus_epi16(
+			PaethPredictor8(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero), _mm_unpacklo_epi8(c, zero)),
+			PaethPredictor8(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero), _mm_unpackhi_epi8(c, zero)));
+		__m128i v1 = _mm_sub_epi8(x, a);
+		__m128i v2 = _mm_sub_epi8(x, b);
+		__m128i v3 = _mm_sub_epi8(x, ab);
+		__m128i v4 = _mm_sub_epi8(x, p);
+		_mm_storeu_si128((__m128i*)(sub + i),   v1);
+		_mm_storeu_si128((__m128i*)(up + i),    v2);
+		_mm_storeu_si128((__m128i*)(avg + i),   v3);
+		_mm_storeu_si128((__m128i*)(paeth + i), v4);
+		sum[0] = _mm_add_epi64(sum[0], _mm_sad_epu8(FilterCost16(x),  zero));
+		sum[1] = _mm_add_epi64(sum[1], _mm_sad_epu8(FilterCost16(v1), zero));
+		sum[2] = _mm_add_epi64(sum[2], _mm_sad_epu8(FilterCost16(v2), zero));
+		sum[3] = _mm_add_epi64(sum[3], _mm_sad_epu8(FilterCost16(v3), zero));
+		sum[4] = _mm_add_epi64(sum[4], _mm_sad_epu8(FilterCost16(v4), zero));
+	}
+	for (int k = 0; k < 5; k++)
+		cost[k] += _mm_cvtsi128_si32(sum[k]) + _mm_cvtsi128_si32(_mm_srli_si128(sum[k], 8));
+#endif // USE_SSE2
+	for ( ; i < Size; i++)
+	{
+		int x = Cur[i], a = Cur[i - Bpp], b = Prev[i], c = Prev[i - Bpp];
+		int v;
+		cost[0] += FilterCost(x);
+		v = x - a;                      sub[i]   = v; cost[1] += FilterCost(v);
+		v = x - b;                      up[i]    = v; cost[2] += FilterCost(v);
+		v = x - ((a + b) >> 1);         avg[i]   = v; cost[3] += FilterCost(v);
+		v = x - PaethPredictor(a, b, c); paeth[i] = v; cost[4] += FilterCost(v);
+	}
+
+	int best = 0;
+	for (i = 1; i < 5; i++)
+		if (cost[i] < cost[best]) best = i;
+	Dst[0] = best;
+	memcpy(Dst + 1, best ? Temp + (best - 1) * Size : Cur, Size);
+}
+
+struct CPNGFilterJob
+{
+	const byte	*Pic;
+	int			Pitch;
+	const byte	*PrevRow;				// converted row preceding Pic[0], NULL for the first row of image
+	int			Width;
+	int			ColorBytes;
+	bool		BGRA;
+	byte		*Dst;
+	int			RowSize;
+};
+
+static void FilterPNGRows(CPNGFilterJob *Job, int First, int Last)
+{
+	int size = Job->Width * Job->ColorBytes;
+	int rowAlloc = Job->Width * 4 + 16;
+	byte *temp    = GetScratch(SCRATCH_ROW, size * 4 + rowAlloc * 3);
+	byte *curBuf  = temp + size * 4;
+	byte *prevBuf = curBuf + rowAlloc;
+	byte *zeroRow = prevBuf + rowAlloc;
+
+	const byte *prev;
+	if (First > 0)
+	{
+		prev = ConvertPNGRow(Job->Pic + (First - 1) * Job->Pitch, prevBuf, Job->Width, Job->ColorBytes, Job->BGRA);
+	}
+	else if (Job->PrevRow)
+	{
+		prev = Job->PrevRow;
+	}
+	else
+	{
+		memset(zeroRow, 0, size);
+		prev = zeroRow;
+	}
+
+	for (int i = First; i < Last; i++)
+	{
+		const byte *cur = ConvertPNGRow(Job->Pic + i * Job->Pitch, curBuf, Job->Width, Job->ColorBytes, Job->BGRA);
+		FilterPNGRow(cur, prev, size, Job->ColorBytes, Job->Dst + i * Job->RowSize, temp);
+		// converted row becomes the previous one
+		prev = cur;
+		Exchange(curBuf, prevBuf);
+	}
+}
+
+struct CDeflateBand
+{
+	const byte	*Data;
+	int			DictStart;
+	int			Start;
+	int			End;
+	bool		Final;
+	byte		*Out;
+	int			OutSize;
+	uint32		Adler;
+};
+
+static void DeflateBands(CDeflateBand *Bands, int First, int Last)
+{
+	for (int i = First; i < Last; i++)
+	{
+		CDeflateBand &B = Bands[i];
+		B.OutSize = DeflateBlock(B.Data, B.DictStart, B.Start, B.End, B.Final, B.Out);
+		B.Adler = Adler32(B.Data + B.Start, B.End - B.Start);
+	}
+}
+
+#if VERIFY_DEFLATE
+
+// Decompress the band with zlib's inflate and compare result with source data. Band's dictionary
+// is passed to the inflater as stored blocks preceding the compressed data (bands are starting on
+// a byte boundary, so the streams could be concatenated).
+static void VerifyDeflateBand(const CDeflateBand &B)
+{
+	guard(VerifyDeflateBand);
+
+	int dictSize = B.Start - B.DictStart;
+	int dataSize = B.End - B.Start;
+	byte *Stream = (byte*)appMalloc(DEFLATE_BOUND(dictSize) + B.OutSize);
+	CBitWriter Bits(Stream);
+	WriteStoredBlocks(Bits, B.Data + B.DictStart, dictSize, false);
+	Bits.Align();
+	int streamSize = Bits.Dst - Stream;
+	memcpy(Stream + streamSize, B.Out, B.OutSize);
+	streamSize += B.OutSize;
+
+	int decodedSize = dictSize + dataSize;
+	byte *Decoded = (byte*)appMalloc(decodedSize + 1);	// extra byte to detect extra output
+	z_stream z;
+	memset(&z, 0, sizeof(z));
+	if (inflateInit2(&z, -MAX_WBITS) != Z_OK)
+		appError("inflateInit2 failed");
+	z.next_in   = Stream;
+	z.avail_in  = streamSize;
+	z.next_out  = Decoded;
+	z.avail_out = decodedSize + 1;
+	int r = inflate(&z, Z_SYNC_FLUSH);
+	int ExpectedResult = B.Final ? Z_STREAM_END : Z_OK;
+	if (r != ExpectedResult || z.avail_in != 0 || (int)z.total_out != decodedSize)
+		appError("Band [%d, %d): inflate returned %d, %d bytes left, %d bytes decoded instead of %d",
+			B.Start, B.End, r, z.avail_in, (int)z.total_out, decodedSize);
+	inflateEnd(&z);
+	if (memcmp(Decoded, B.Data + B.DictStart, decodedSize) != 0)
+		appError("Band [%d, %d): decompressed data differs from source", B.Start, B.End);
+
+	appFree(Stream);
+	appFree(Decoded);
+
+	unguard;
+}
+
+#endif // VERIFY_DEFLATE
+
+CPNGWriter::CPNGWriter(FArchive &InAr, int InWidth, int InHeight, bool InAlpha, bool InBGRA)
+:	CImageWriter(InAr, InWidth, InHeight, InAlpha, InBGRA)
+,	RowsWritten(0)
+,	WindowSize(0)
+,	PendingSize(0)
+,	Adler(1)
+,	StreamStarted(false)
+{
+	guard(CPNGWriter::CPNGWriter);
+
+	ColorBytes = Alpha ? 4 : 3;
+	RowSize = Width * ColorBytes + 1;
+	MaxPendingSize = max(PNG_BAND_SIZE * GNumThreads, RowSize);
+	int prevRowSize = Align(Width * 4 + 16, 16);
+	PrevRow = GetScratch(SCRATCH_PNG_DATA, prevRowSize + DEFLATE_WINDOW + MaxPendingSize);
+	Buffer  = PrevRow + prevRowSize;
+
+	static const byte Signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	Ar.Serialize(const_cast<byte*>(Signature), sizeof(Signature));
+
+	byte header[13];
+	PutBE32(header, Width);
+	PutBE32(header + 4, Height);
+	header[8]  = 8;								// bit depth
+	header[9]  = Alpha ? 6 : 2;					// color type: RGBA or RGB
+	header[10] = 0;								// compression: deflate
+	header[11] = 0;								// filter method: adaptive
+	header[12] = 0;								// no interlace
+	WriteChunk("IHDR", header, sizeof(header));
+
+	unguard;
+}
+
+void CPNGWriter::WriteChunk(const char *Type, const byte *Data, int Size)
+{
+	byte buf[8];
+	PutBE32(buf, Size);
+	memcpy(buf + 4, Type, 4);
+	Ar.Serialize(buf, 8);
+	if (Size) Ar.Serialize(const_cast<byte*>(Data), Size);
+	PutBE32(buf, UpdateCRC(UpdateCRC(0, buf + 4, 4), Data, Size));
+	Ar.Serialize(buf, 4);
+}
+
+void CPNGWriter::WriteRows(const byte *Pic, int NumRows, int Pitch)
+{
+	guard(CPNGWriter::WriteRows);
+
+	while (NumRows > 0)
+	{
+		int n = min(NumRows, (MaxPendingSize - PendingSize) / RowSize);
+		if (n <= 0)
+		{
+			FlushData(false);
+			continue;
+		}
+
+		CPNGFilterJob Job;
+		Job.Pic        = Pic;
+		Job.Pitch      = Pitch;
+		Job.PrevRow    = RowsWritten ? PrevRow : NULL;
+		Job.Width      = Width;
+		Job.ColorBytes = ColorBytes;
+		Job.BGRA       = BGRA;
+		Job.Dst        = Buffer + WindowSize + PendingSize;
+		Job.RowSize    = RowSize;
+		appParallelFor(n, max(16384 / RowSize, 1), FilterPNGRows, &Job);
+
+		// remember the last row for filtering of the next group
+		const byte *last = Pic + (n - 1) * Pitch;
+		if (ConvertPNGRow(last, PrevRow, Width, ColorBytes, BGRA) == last)
+			memcpy(PrevRow, last, Width * ColorBytes);
+
+		PendingSize += n * RowSize;
+		RowsWritten += n;
+		Pic += n * Pitch;
+		NumRows -= n;
+	}
+
+	unguard;
+}
+
+// Compress pending data and write it to IDAT chunks, one chunk per band
+void CPNGWriter::FlushData(bool Final)
+{
+	guard(CPNGWriter::FlushData);
+
+	CDeflateBand Bands[MAX_THREADS];
+	int numBands = bound(PendingSize / PNG_BAND_SIZE, 1, MAX_THREADS);
+	int bandSize = PendingSize / numBands;
+	int outSize = DEFLATE_BOUND(bandSize + numBands) + 8;	// reserve space for zlib header and checksum
+	byte *out = GetScratch(SCRATCH_PNG_OUTPUT, outSize * numBands);
+
+	int i;
+	for (i = 0; i < numBands; i++)
+	{
+		CDeflateBand &B = Bands[i];
+		B.Data      = Buffer;
+		B.Start     = WindowSize + i * bandSize;
+		B.End       = (i == numBands - 1) ? WindowSize + PendingSize : B.Start + bandSize;
+		B.DictStart = max(B.Start - DEFLATE_WINDOW, 0);
+		B.Final     = Final && (i == numBands - 1);
+		B.Out       = out + i * outSize + 2;
+	}
+	appParallelFor(numBands, 1, DeflateBands, Bands);
+#if VERIFY_DEFLATE
+	// zlib inflate builds its tables on first use, so don't call it from worker threads
+	for (i = 0; i < numBands; i++)
+		VerifyDeflateBand(Bands[i]);
+#endif
+
+	for (i = 0; i < numBands; i++)
+	{
+		const CDeflateBand &B = Bands[i];
+		byte *data = B.Out;
+		int size = B.OutSize;
+		if (!StreamStarted)
+		{
+			// zlib header: deflate with 32K window, default compression
+			data -= 2;
+			data[0] = 0x78;
+			data[1] = 0x9C;
+			size += 2;
+			StreamStarted = true;
+		}
+		Adler = Adler32Combine(Adler, B.Adler, B.End - B.Start);
+		if (B.Final)
+		{
+			PutBE32(data + size, Adler);
+			size += 4;
+		}
+		WriteChunk("IDAT", data, size);
+	}
+
+	// keep the end of data as dictionary for the next bands
+	int total = WindowSize + PendingSize;
+	int keep = min(total, DEFLATE_WINDOW);
+	memmove(Buffer, Buffer + total - keep, keep);
+	WindowSize = keep;
+	PendingSize = 0;
+
+	unguard;
+}
+
+void CPNGWriter::Finish()
+{
+	guard(CPNGWriter::Finish);
+
+	if (RowsWritten != Height)
+		appError("PNG: %d rows written, %d expected", RowsWritten, Height);
+	FlushData(true);
+	WriteChunk("IEND", NULL, 0);
+
+	unguard;
+}
+
+void WritePNG(FArchive &Ar, int width, int height, const byte *pic, bool isBGRA)
+{
+	guard(WritePNG);
+
+	CPNGWriter Writer(Ar, width, height, ImageHasAlpha(pic, width * height), isBGRA);
+	Writer.WriteImage(pic);
+
+	unguard;
+}
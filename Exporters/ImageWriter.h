@@ -0,0 +1,106 @@
+#ifndef __IMAGE_WRITER_H__
+#define __IMAGE_WRITER_H__
+
+
+/*-----------------------------------------------------------------------------
+	Streaming image writers
+-----------------------------------------------------------------------------*/
+
+// Writers are receiving 32-bit image by groups of rows, so the whole image is not required
+// to be in memory. Temporary buffers are allocated per thread and reused by all images
+// written by this thread, so only one writer could be active in a thread at time.
+
+class CImageWriter
+{
+public:
+	CImageWriter(FArchive &InAr, int InWidth, int InHeight, bool InAlpha, bool InBGRA)
+	:	Ar(InAr)
+	,	Width(InWidth)
+	,	Height(InHeight)
+	,	Alpha(InAlpha)
+	,	BGRA(InBGRA)
+	,	BottomUp(false)
+	{}
+	virtual ~CImageWriter()
+	{}
+
+	// Append 'NumRows' rows of RGBA (or BGRA) pixels to the image. Rows are passed from the
+	// top of the image, or from the bottom when 'BottomUp' is set. 'Pitch' is the distance
+	// between rows in bytes, could be negative.
+	virtual void WriteRows(const byte *Pic, int NumRows, int Pitch) = 0;
+	// Complete the file, should be called after all rows were written
+	virtual void Finish()
+	{}
+
+	// Write the whole image, rows of 'Pic' are stored from the top
+	void WriteImage(const byte *Pic)
+	{
+		int Pitch = Width * 4;
+		if (BottomUp)
+			WriteRows(Pic + (Height - 1) * Pitch, Height, -Pitch);
+		else
+			WriteRows(Pic, Height, Pitch);
+		Finish();
+	}
+
+protected:
+	FArchive	&Ar;
+	int			Width;
+	int			Height;
+	bool		Alpha;					// when false, alpha channel is not saved
+	bool		BGRA;					// layout of source pixels
+
+public:
+	bool		BottomUp;				// file format requires rows in bottom to top order
+};
+
+
+class CTGAWriter : public CImageWriter
+{
+public:
+	CTGAWriter(FArchive &InAr, int InWidth, int InHeight, bool InAlpha, bool InBGRA, bool InCompress);
+
+	virtual void WriteRows(const byte *Pic, int NumRows, int Pitch);
+
+	// When set, writer stops as soon as compressed data becomes not smaller than uncompressed
+	// image, and sets 'Enlarged'; the image should be written again without compression.
+	bool		StopWhenEnlarged;
+	bool		Enlarged;
+
+protected:
+	bool		Compress;
+	int			PackedSize;
+	int			Threshold;
+};
+
+
+class CPNGWriter : public CImageWriter
+{
+public:
+	CPNGWriter(FArchive &InAr, int InWidth, int InHeight, bool InAlpha, bool InBGRA);
+
+	virtual void WriteRows(const byte *Pic, int NumRows, int Pitch);
+	virtual void Finish();
+
+protected:
+	int			ColorBytes;
+	int			RowSize;				// size of filtered row, including filter type byte
+	int			RowsWritten;
+	byte		*PrevRow;				// last row of the previous WriteRows() call, converted
+	byte		*Buffer;				// deflate window followed by filtered rows
+	int			WindowSize;
+	int			PendingSize;
+	int			MaxPendingSize;
+	unsigned	Adler;
+	bool		StreamStarted;
+
+	void FlushData(bool Final);
+	void WriteChunk(const char *Type, const byte *Data, int Size);
+};
+
+
+// Returns true when any pixel of 32-bit image is not opaque
+bool ImageHasAlpha(const byte *Pic, int NumPixels);
+
+
+#endif // __IMAGE_WRITER_H__
@@ -239,8 +239,13 @@ protected:
 	void				 *DataBlock;// all following data is resided here, aligned to 16 bytes
 	struct CMeshBoneData *BoneData;
 	struct CSkinVert     *Skinned;	// soft-skinned vertices
+	CQuat		*PoseQuat;			// animated bone poses for primary and secondary animations, 2*NumBones items
+	CVec3		*PosePos;
+	int			*PoseTracks;		// animation track for each bone of evaluated pose
+	struct CAnimTrackCursor *Cursors; // 2 arrays for each animation channel, for primary and secondary animations
 	CVec3		*InfColors;			// debug: color-by-influence for vertices
 	int			LastLodNum;			// used to detect requirement to rebuild Wedges[]
+	int			SkinnedLod;			// LOD which vertices are stored in Skinned[], -1 if none
 	// animation state
 	CAnimChan	Channels[MAX_SKELANIMCHANNELS];
 	int			MaxAnimChannel;
@@ -8,6 +8,7 @@
 
 #include "GlWindow.h"
 #include "UnMathTools.h"
+#include "Parallel.h"
 
 
 // debugging
@@ -42,6 +43,7 @@ struct CMeshBoneData
 #if USE_SSE
 	CCoords4	Transform4;			// SSE version
 #endif
+	bool		TransformChanged;	// Transform was changed since last SkinMeshVerts() call
 	// data for tweening; bone-space
 	CVec3		Pos;				// current position of bone
 	CQuat		Quat;				// current orientation quaternion
@@ -91,11 +93,13 @@ CSkelMeshInstance::CSkelMeshInstance()
 ,	UVIndex(0)
 ,	RotationMode(EARO_AnimSet)
 ,	LastLodNum(-2)				// differs from LodNum and from all other values
+,	SkinnedLod(-1)
 ,	MaxAnimChannel(-1)
 ,	Animation(NULL)
 ,	DataBlock(NULL)
 ,	BoneData(NULL)
 ,	Skinned(NULL)
+,	Cursors(NULL)
 ,	InfColors(NULL)
 {
 	ClearSkelAnims();
@@ -105,6 +109,7 @@ CSkelMeshInstance::CSkelMeshInstance()
 CSkelMeshInstance::~CSkelMeshInstance()
 {
 	if (DataBlock) appFree(DataBlock);
+	if (Cursors) appFree(Cursors);
 	if (InfColors) delete[] InfColors;
 	if (pMesh) pMesh->UnlockMaterials();
 }
@@ -207,12 +212,17 @@ void CSkelMeshInstance::SetMesh(CSkeletalMesh *Mesh)
 		InfColors = NULL;
 	}
 	// allocate data arrays in a single block
-	int DataSize = sizeof(CMeshBoneData) * NumBones + sizeof(CSkinVert) * NumVerts;
-	DataBlock = appMalloc(DataSize, 16);
-	BoneData  = (CMeshBoneData*)DataBlock;
-	Skinned   = (CSkinVert*)(BoneData + NumBones);
+	int DataSize = sizeof(CMeshBoneData) * NumBones + sizeof(CSkinVert) * NumVerts
+		+ (sizeof(CQuat) * 2 + sizeof(CVec3) * 2 + sizeof(int)) * NumBones;
+	DataBlock  = appMalloc(DataSize, 16);
+	BoneData   = (CMeshBoneData*)DataBlock;
+	Skinned    = (CSkinVert*)(BoneData + NumBones);
+	PoseQuat   = (CQuat*)(Skinned + NumVerts);
+	PosePos    = (CVec3*)(PoseQuat + NumBones * 2);
+	PoseTracks = (int*)(PosePos + NumBones * 2);
 
 	LastLodNum = -2;
+	SkinnedLod = -1;
 
 	CMeshBoneData *data;
 	for (i = 0, data = BoneData; i < NumBones; i++, data++)
@@ -289,6 +299,12 @@ void CSkelMeshInstance::SetAnim(const CAnimSet *Anim)
 
 	Animation = Anim;
 
+	// allocate key cursors
+	if (Cursors) appFree(Cursors);
+	Cursors = NULL;
+	if (Animation && Animation->TrackBoneNames.Num())
+		Cursors = (CAnimTrackCursor*)appMalloc(sizeof(CAnimTrackCursor) * Animation->TrackBoneNames.Num() * MAX_SKELANIMCHANNELS * 2);
+
 	int i;
 	CMeshBoneData *data;
 	for (i = 0, data = BoneData; i < pMesh->RefSkeleton.Num(); i++, data++)
@@ -449,6 +465,29 @@ void CSkelMeshInstance::UpdateSkeleton()
 
 		int i;
 		CMeshBoneData *data;
+
+		// evaluate animations for all bones in range at once
+		int NumBones = pMesh->RefSkeleton.Num();
+		int NumPoseBones = lastBone - firstBone + 1;
+		if (AnimSeq1)
+		{
+			for (i = 0, data = BoneData + firstBone; i < NumPoseBones; i++, data++)
+			{
+				const CSkelMeshBone &Bone = pMesh->RefSkeleton[firstBone + i];
+				// default position - from bind pose
+				PosePos[i]  = PosePos[NumBones + i]  = Bone.Position;
+				PoseQuat[i] = PoseQuat[NumBones + i] = Bone.Orientation;
+				// skip bones which will be overrided in following channel(s)
+				PoseTracks[i] = (Stage < data->FirstChannel) ? INDEX_NONE : data->BoneMap;
+			}
+			int NumTracks = Animation->TrackBoneNames.Num();
+			CAnimTrackCursor *ChnCursors = Cursors + Stage * 2 * NumTracks;
+			if (!AnimSeq2 || Chn->SecondaryBlend != 1.0f)
+				AnimSeq1->GetPose(Chn->Time, Chn->Looped, NumPoseBones, PoseTracks, PosePos, PoseQuat, ChnCursors);
+			if (AnimSeq2)
+				AnimSeq2->GetPose(Time2, Chn->Looped, NumPoseBones, PoseTracks, PosePos + NumBones, PoseQuat + NumBones, ChnCursors + NumTracks);
+		}
+
 		for (i = firstBone, data = BoneData + firstBone; i <= lastBone; i++, data++)
 		{
 			if (Stage < data->FirstChannel)
@@ -477,20 +516,21 @@ void CSkelMeshInstance::UpdateSkeleton()
 				// get bone position from track
 				if (!AnimSeq2 || Chn->SecondaryBlend != 1.0f)
 				{
-					AnimSeq1->Tracks[BoneIndex].GetBonePosition(Chn->Time, AnimSeq1->NumFrames, Chn->Looped, BP, BO);
+					BP = PosePos[i - firstBone];
+					BO = PoseQuat[i - firstBone];
 //const char *bname = *Bone.Name;
 //CQuat BOO = BO;
 //if (!strcmp(bname, "b_MF_UpperArm_L")) { BO.Set(-0.225, -0.387, -0.310,  0.839); }
 #if SHOW_ANIM
 //if (i == 6 || i == 8 || i == 10 || i == 11 || i == 29)	//??
 					DrawTextLeft("%s%d Bone (%s) : P{ %8.3f %8.3f %8.3f }  Q{ %6.3f %6.3f %6.3f %6.3f }",
-						AnimSeq1->Tracks[BoneIndex].HasKeys() ? S_GREEN : S_BLUE,
+						AnimSeq1->GetTrack(BoneIndex).HasKeys() ? S_GREEN : S_BLUE,
 						i, *Bone.Name, VECTOR_ARG(BP), QUAT_ARG(BO));
 //if (!strcmp(bname, "b_MF_UpperArm_L")) DrawTextLeft("%g %g %g %g [%g %g]", BO.x-BOO.x,BO.y-BOO.y,BO.z-BOO.z,BO.w-BOO.w, BO.w, BOO.w);
 #endif
 //BO.Normalize();
 #if SHOW_BONE_UPDATES
-					if (AnimSeq1->Tracks[BoneIndex].HasKeys())
+					if (AnimSeq1->GetTrack(BoneIndex).HasKeys())
 						BoneUpdateCounts[i]++;
 #endif
 				}
@@ -499,9 +539,8 @@ void CSkelMeshInstance::UpdateSkeleton()
 				{
 					CVec3 BP2;
 					CQuat BO2;
-					BP2 = Bone.Position;		// default position - from bind pose
-					BO2 = Bone.Orientation;		// ...
-					AnimSeq2->Tracks[BoneIndex].GetBonePosition(Time2, AnimSeq2->NumFrames, Chn->Looped, BP2, BO2);
+					BP2 = PosePos[NumBones + i - firstBone];
+					BO2 = PoseQuat[NumBones + i - firstBone];
 					if (Chn->SecondaryBlend == 1.0f)
 					{
 						BO = BO2;
@@ -582,10 +621,17 @@ void CSkelMeshInstance::UpdateSkeleton()
 		}
 		// compute transformation of world-space model vertices from reference
 		// pose to desired pose
-		BC.UnTransformCoords(data->RefCoordsInv, data->Transform);
+		CCoords Transform;
+		BC.UnTransformCoords(data->RefCoordsInv, Transform);
+		// vertices affected by this bone should be skinned again
+		if (memcmp(&Transform, &data->Transform, sizeof(CCoords)) != 0)
+		{
+			data->Transform = Transform;
+			data->TransformChanged = true;
 #if USE_SSE
-		data->Transform4.Set(data->Transform);
+			data->Transform4.Set(data->Transform);
 #endif
+		}
 #if 0
 //!!
 if (i == 32 || i == 34)
@@ -940,22 +986,42 @@ void CSkelMeshInstance::DrawAttachments()
 }
 
 
-#if !USE_SSE
+struct CSkinJob
+{
+	const CSkelMeshVertex	*Verts;
+	CSkinVert				*Skinned;
+	const CMeshBoneData		*BoneData;
+	int						NumBones;
+	bool					SkinAll;		// when false, skip vertices which bones were not moved
+};
 
-// Software skinning - FPU version
-void CSkelMeshInstance::SkinMeshVerts()
+// Returns true when any bone affecting the vertex was moved since the previous skinning
+static FORCEINLINE bool IsVertexChanged(const CSkelMeshVertex &V, const CMeshBoneData *BoneData)
 {
-	guard(CSkelMeshInstance::SkinMeshVerts);
+	for (int j = 0; j < NUM_INFLUENCES; j++)
+	{
+		int iBone = V.Bone[j];
+		if (iBone < 0) break;
+		if (BoneData[iBone].TransformChanged) return true;
+	}
+	return false;
+}
 
-	const CSkelMeshLod& Mesh = pMesh->Lods[LodNum];
-	int NumVerts = Mesh.NumVerts;
 
-	memset(Skinned, 0, sizeof(CSkinVert) * NumVerts);
+#if !USE_SSE
 
-	for (int i = 0; i < NumVerts; i++)
+// Software skinning - FPU version
+static void SkinVerts(CSkinJob *Job, int First, int Last)
+{
+	const CMeshBoneData *BoneData = Job->BoneData;
+
+	for (int i = First; i < Last; i++)
 	{
-		const CSkelMeshVertex &V = Mesh.Verts[i];
-		CSkinVert             &D = Skinned[i];
+		const CSkelMeshVertex &V = Job->Verts[i];
+		CSkinVert             &D = Job->Skinned[i];
+
+		if (!Job->SkinAll && !IsVertexChanged(V, BoneData))
+			continue;
 
 		CVec4 UnpackedWeights;
 		V.UnpackWeights(UnpackedWeights);
@@ -971,7 +1037,7 @@ void CSkelMeshInstance::SkinMeshVerts()
 		{
 			int iBone = V.Bone[j];
 			if (iBone < 0) break;
-			assert(iBone < pMesh->RefSkeleton.Num());	// validate bone index
+			assert(iBone < Job->NumBones);				// validate bone index
 
 			const CMeshBoneData &data = BoneData[iBone];
 			CoordsMA(transform, UnpackedWeights.v[j], data.Transform);
@@ -991,26 +1057,22 @@ void CSkelMeshInstance::SkinMeshVerts()
 		// Preserve Normal.W to be able to compute binormal correctly
 		D.Normal.v[3] = V.Normal.GetW();
 	}
-
-	unguard;
 }
 
 #else // USE_SSE
 
 // Software skinning - SSE version
-void CSkelMeshInstance::SkinMeshVerts()
+static void SkinVerts(CSkinJob *Job, int First, int Last)
 {
-	guard(CSkelMeshInstance::SkinMeshVerts);
-
-	const CSkelMeshLod& Mesh = pMesh->Lods[LodNum];
-	int NumVerts = Mesh.NumVerts;
-
-	memset(Skinned, 0, sizeof(CSkinVert) * NumVerts);
+	const CMeshBoneData *BoneData = Job->BoneData;
 
-	for (int i = 0; i < NumVerts; i++)
+	for (int i = First; i < Last; i++)
 	{
-		const CSkelMeshVertex &V = Mesh.Verts[i];
-		CSkinVert             &D = Skinned[i];
+		const CSkelMeshVertex &V = Job->Verts[i];
+		CSkinVert             &D = Job->Skinned[i];
+
+		if (!Job->SkinAll && !IsVertexChanged(V, BoneData))
+			continue;
 
 		CVec4 UnpackedWeights;
 		V.UnpackWeights(UnpackedWeights);
@@ -1035,7 +1097,7 @@ void CSkelMeshInstance::SkinMeshVerts()
 		{
 			int iBone = V.Bone[j];
 			if (iBone < 0) break;
-			assert(iBone < pMesh->RefSkeleton.Num());	// validate bone index
+			assert(iBone < Job->NumBones);				// validate bone index
 
 			const CMeshBoneData &data = BoneData[iBone];
 			x5 = _mm_load1_ps(&UnpackedWeights.v[j]);	// Weight
@@ -1087,13 +1149,36 @@ void CSkelMeshInstance::SkinMeshVerts()
 		// Preserve Normal.W to be able to compute binormal correctly
 		D.Normal.v[3] = V.Normal.GetW();
 	}
-
-	unguard;
 }
 
 #endif // USE_SSE
 
 
+void CSkelMeshInstance::SkinMeshVerts()
+{
+	guard(CSkelMeshInstance::SkinMeshVerts);
+
+	const CSkelMeshLod& Mesh = pMesh->Lods[LodNum];
+
+	CSkinJob Job;
+	Job.Verts    = Mesh.Verts;
+	Job.Skinned  = Skinned;
+	Job.BoneData = BoneData;
+	Job.NumBones = pMesh->RefSkeleton.Num();
+	Job.SkinAll  = (SkinnedLod != LodNum);	// Skinned[] holds data of another LOD, or was not filled yet
+
+	// process vertices in ranges which fit into CPU cache
+	appParallelFor(Mesh.NumVerts, 2048, SkinVerts, &Job);
+
+	// all bone movements are applied now
+	for (int i = 0; i < Job.NumBones; i++)
+		BoneData[i].TransformChanged = false;
+	SkinnedLod = LodNum;
+
+	unguard;
+}
+
+
 void CSkelMeshInstance::DrawMesh(unsigned flags)
 {
 	guard(CSkelMeshInstance::DrawMesh);
@@ -1107,7 +1192,11 @@ void CSkelMeshInstance::DrawMesh(unsigned flags)
 	if (!NumSections || !NumVerts) return;
 
 //	if (!Mesh.HasNormals)  Mesh.BuildNormals();
-	if (!Mesh.HasTangents) Mesh.BuildTangents();
+	if (!Mesh.HasTangents)
+	{
+		Mesh.BuildTangents();
+		SkinnedLod = -1;			// vertex data was changed
+	}
 
 #if 0
 	SkinMeshVerts();
@@ -22,6 +22,7 @@
 #include "UnThirdParty.h"
 
 #include "Exporters/Exporters.h"
+#include "Parallel.h"
 
 #if DECLARE_VIEWER_PROPS
 #include "SkeletalMesh.h"
@@ -298,6 +299,7 @@ static void RegisterExporters()
 	RegisterExporter("SwfMovie",      ExportGfx          );
 	RegisterExporter("FaceFXAnimSet", ExportFaceFXAnimSet);
 	RegisterExporter("FaceFXAsset",   ExportFaceFXAsset  );
+	RegisterExporter("TextureCube",   ExportTextureCube  );
 #endif // UNREAL3
 #if UNREAL4
 	RegisterExporter("SkeletalMesh4", ExportSkeletalMesh4);
@@ -372,6 +374,8 @@ static void PrintUsage()
 			"Options:\n"
 			"    -path=PATH      path to game installation directory; if not specified,\n"
 			"                    program will search for packages in current directory\n"
+			"    -cache=file     keep game directory contents in the file to speed up\n"
+			"                    the next startup\n"
 			"    -game=tag       override game autodetection (see -taglist for variants)\n"
 			"    -pkgver=nnn     override package version (advanced option!)\n"
 			"    -pkg=package    load extra package (in addition to <package>)\n"
@@ -411,16 +415,26 @@ static void PrintUsage()
 			"    -md5            use md5mesh/md5anim format for skeletal mesh\n"
 			"    -lods           export all available mesh LOD levels\n"
 			"    -dds            export textures in DDS format whenever possible\n"
+			"    -ktx            export textures in KTX2 format whenever possible\n"
+			"    -png            export textures in PNG format instead of TGA\n"
 			"    -notgacomp      disable TGA compression\n"
+			"    -mip=N          export texture mip level N instead of the largest one\n"
+			"    -maxsize=N      export the largest texture mip level which is not\n"
+			"                    larger than NxN pixels\n"
 			"    -nooverwrite    prevent existing files from being overwritten (better\n"
 			"                    performance)\n"
+			"    -threads=N      use N threads for decompression and export, 0 = number\n"
+			"                    of CPU cores\n"
+			"    -membudget=N    export packages one by one, unloading least recently used\n"
+			"                    ones when loaded objects use more than N megabytes (K/M/G\n"
+			"                    suffix could be used)\n"
 			"\n"
 			"Supported resources for export:\n"
 			"    SkeletalMesh    exported as ActorX psk file or MD5Mesh\n"
 			"    MeshAnimation   exported as ActorX psa file or MD5Anim\n"
 			"    VertMesh        exported as Unreal 3d file\n"
 			"    StaticMesh      exported as psk file with no skeleton (pskx)\n"
-			"    Texture         exported in tga or dds format\n"
+			"    Texture         exported in tga, png, dds or ktx2 format\n"
 			"    Sounds          file extension depends on object contents\n"
 			"    ScaleForm       gfx\n"
 			"    FaceFX          fxa\n"
@@ -451,8 +465,9 @@ static void PrintVersionInfo()
 	Package helpers
 -----------------------------------------------------------------------------*/
 
-// Export all loaded objects.
-bool ExportObjects(const TArray<UObject*> *Objects, IProgressCallback* progress)
+// Export all loaded objects. When 'FirstObject' is specified, objects located before this index in
+// GObjObjects are skipped.
+bool ExportObjects(const TArray<UObject*> *Objects, IProgressCallback* progress, int FirstObject)
 {
 	guard(ExportObjects);
 
@@ -462,10 +477,16 @@ bool ExportObjects(const TArray<UObject*> *Objects, IProgressCallback* progress)
 	UnPackage* notifyPackage = NULL;
 	bool hasObjectList = (Objects != NULL) && Objects->Num();
 
+	BeginParallelExport();
+
 	//?? when 'Objects' passed, probably iterate over that list instead of GObjObjects
-	for (int idx = 0; idx < UObject::GObjObjects.Num(); idx++)
+	for (int idx = FirstObject; idx < UObject::GObjObjects.Num(); idx++)
 	{
-		if (progress && !progress->Tick()) return false;
+		if (progress && !progress->Tick())
+		{
+			EndParallelExport();
+			return false;
+		}
 		UObject* ExpObj = UObject::GObjObjects[idx];
 		bool objectSelected = !hasObjectList || (Objects->FindItem(ExpObj) >= 0);
 
@@ -486,12 +507,41 @@ bool ExportObjects(const TArray<UObject*> *Objects, IProgressCallback* progress)
 		}
 	}
 
+	EndParallelExport();
+
 	return true;
 
 	unguard;
 }
 
 
+// Load and export packages by groups. Objects of least recently used packages are released when
+// allocated memory exceeds GMemoryBudget, and loaded again when referenced by other packages.
+// Returns number of loaded objects.
+static int ExportPackagesWithBudget(const TArray<UnPackage*> &Packages)
+{
+	guard(ExportPackagesWithBudget);
+
+	int NumObjects = 0;
+	// group size allows loading packages in parallel
+	int GroupSize = max(GNumThreads, 1);
+	for (int i = 0; i < Packages.Num(); i += GroupSize)
+	{
+		TArray<UnPackage*> Group;
+		for (int j = i; j < Packages.Num() && j < i + GroupSize; j++)
+			Group.Add(Packages[j]);
+		int FirstObject = UObject::GObjObjects.Num();
+		LoadWholePackages(Group);
+		NumObjects += UObject::GObjObjects.Num() - FirstObject;
+		ExportObjects(NULL, NULL, FirstObject);
+		EnforceMemoryBudget();
+	}
+	return NumObjects;
+
+	unguard;
+}
+
+
 struct ClassStats
 {
 	const char*	Name;
@@ -614,6 +664,27 @@ static void SetPathOption(FString& where, const char* value)
 		where.RemoveAt(len-1);
 }
 
+// Parse memory size in megabytes, or with K/M/G suffix
+static size_t ParseMemorySize(const char* value)
+{
+	char* end;
+	double size = strtod(value, &end);
+	switch (toupper(*end))
+	{
+	case 'K':
+		size *= 1024;
+		break;
+	case 'G':
+		size *= 1024.0 * 1024 * 1024;
+		break;
+	default:	// 'M' or no suffix
+		size *= 1024 * 1024;
+	}
+	if (size <= 0) return 0;
+	if (size >= (double)(size_t)-1) return (size_t)-1;
+	return (size_t)size;
+}
+
 // Display error message about wrong command line and then exit.
 static void CommandLineError(const char *fmt, ...)
 {
@@ -709,6 +780,8 @@ int main(int argc, char **argv)
 			OPT_NBOOL("nolightmap", GSettings.UseLightmapTexture)
 			OPT_BOOL ("sounds",  GSettings.UseSound)
 			OPT_BOOL ("dds",     GExportDDS)
+			OPT_BOOL ("ktx",     GExportKTX)
+			OPT_BOOL ("png",     GExportPNG)
 			OPT_BOOL ("notgacomp", GNoTgaCompress)
 			OPT_BOOL ("nooverwrite", GDontOverwriteFiles)
 #if HAS_UI
@@ -735,6 +808,10 @@ int main(int argc, char **argv)
 			SetPathOption(GSettings.GamePath, opt+5);
 			hasRootDir = true;
 		}
+		else if (!strnicmp(opt, "cache=", 6))
+		{
+			appSetGameFileCache(opt+6);
+		}
 		else if (!strnicmp(opt, "out=", 4))
 		{
 			SetPathOption(GSettings.ExportPath, opt+4);
@@ -775,6 +852,22 @@ int main(int argc, char **argv)
 			objectsToLoad.Add(obj);
 			attachAnimName = obj;
 		}
+		else if (!strnicmp(opt, "threads=", 8))
+		{
+			appSetNumThreads(atoi(opt+8));
+		}
+		else if (!strnicmp(opt, "membudget=", 10))
+		{
+			GMemoryBudget = ParseMemorySize(opt+10);
+		}
+		else if (!strnicmp(opt, "mip=", 4))
+		{
+			GExportTextureMip = max(atoi(opt+4), 0);
+		}
+		else if (!strnicmp(opt, "maxsize=", 8))
+		{
+			GExportTextureMaxSize = max(atoi(opt+8), 0);
+		}
 		else if (!stricmp(opt, "3rdparty"))
 		{
 			GSettings.UseScaleForm = GSettings.UseFaceFx = true;
@@ -936,6 +1029,9 @@ int main(int argc, char **argv)
 		return 0;					// already displayed when loaded package; extend it?
 	}
 
+	// with memory budget, packages are exported one by one instead of loading everything at once
+	bool exportByPackage = (mainCmd == CMD_Export && GMemoryBudget && !GApplication.GuiShown);
+
 	// get requested object info
 	if (objectsToLoad.Num())
 	{
@@ -981,11 +1077,18 @@ int main(int argc, char **argv)
 		appPrintf("Found %d object(s)\n", totalFound);
 		UObject::EndLoad();
 	}
+	else if (exportByPackage)
+	{
+		int NumObjects = ExportPackagesWithBudget(Packages);
+		ResetExportedList();
+		// when nothing was loaded, display the same diagnostics as for regular export
+		if (NumObjects || GApplication.GuiShown)
+			return 0;
+	}
 	else
 	{
 		// fully load all packages
-		for (int pkg = 0; pkg < Packages.Num(); pkg++)
-			LoadWholePackage(Packages[pkg]);
+		LoadWholePackages(Packages);
 	}
 
 	if (!UObject::GObjObjects.Num() && !GApplication.GuiShown)
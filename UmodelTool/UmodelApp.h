@@ -92,7 +92,7 @@ extern CUmodelApp GApplication;
 
 // Main.cpp functions
 void InitClassAndExportSystems(int Game);
-bool ExportObjects(const TArray<UObject*> *Objects = NULL, IProgressCallback* progress = NULL);
+bool ExportObjects(const TArray<UObject*> *Objects = NULL, IProgressCallback* progress = NULL, int FirstObject = 0);
 void DisplayPackageStats(const TArray<UnPackage*> &Packages);
 
 
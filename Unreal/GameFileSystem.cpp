@@ -1,6 +1,7 @@
 #include "Core.h"
 #include "UnCore.h"
 #include "GameFileSystem.h"
+#include "Parallel.h"
 
 #include "UnArchiveObb.h"
 #include "UnArchivePak.h"
@@ -8,17 +9,199 @@
 // includes for file enumeration
 #if _WIN32
 #	include <io.h>					// for findfirst() set
+#	include <sys/types.h>
+#	include <sys/stat.h>			// for _stati64()
 #else
 #	include <dirent.h>				// for opendir() etc
 #	include <sys/stat.h>			// for stat()
 #endif
 
 
+/*-----------------------------------------------------------------------------
+	Shared VFS reader
+-----------------------------------------------------------------------------*/
+
+void appReadVfsData(FArchive* Reader, CMutex& ReaderLock, int64 Pos, void* Data, int Size)
+{
+	ReaderLock.Lock();
+#if DO_GUARD
+	TRY
+	{
+#endif
+		Reader->Seek64(Pos);
+		Reader->Serialize(Data, Size);
+#if DO_GUARD
+	}
+	CATCH
+	{
+		// don't leave the reader locked, error will be handled by the caller
+		ReaderLock.Unlock();
+		THROW;
+	}
+#endif // DO_GUARD
+	ReaderLock.Unlock();
+}
+
+
+/*-----------------------------------------------------------------------------
+	Pak file block cache
+-----------------------------------------------------------------------------*/
+
+#if UNREAL4
+
+#define PAK_CACHE_MEMORY		(32 << 20)		// memory budget for decompressed blocks
+#define PAK_CACHE_HASH_SIZE		1024
+
+struct CPakCacheBlock
+{
+	const FArchive*	Reader;
+	int64			Offset;						// position of compressed block in pak file
+	byte*			Data;
+	int				Size;
+	CPakCacheBlock*	HashNext;
+	CPakCacheBlock*	LruPrev;					// more recently used block
+	CPakCacheBlock*	LruNext;					// less recently used block
+};
+
+static CPakCacheBlock* PakCacheHash[PAK_CACHE_HASH_SIZE];
+static CPakCacheBlock* PakCacheFirst = NULL;	// most recently used block
+static CPakCacheBlock* PakCacheLast  = NULL;	// least recently used block
+static int PakCacheSize = 0;
+static CSpinLock PakCacheLock;					// protects all cache data above
+
+static int GetPakCacheHash(const FArchive* Reader, int64 Offset)
+{
+	return (int)((Offset >> 10) ^ ((size_t)Reader >> 4)) & (PAK_CACHE_HASH_SIZE - 1);
+}
+
+static void LinkPakBlock(CPakCacheBlock* Block)
+{
+	Block->LruPrev = NULL;
+	Block->LruNext = PakCacheFirst;
+	if (PakCacheFirst) PakCacheFirst->LruPrev = Block;
+	PakCacheFirst = Block;
+	if (!PakCacheLast) PakCacheLast = Block;
+}
+
+static void UnlinkPakBlock(CPakCacheBlock* Block)
+{
+	if (Block->LruPrev) Block->LruPrev->LruNext = Block->LruNext;
+	else PakCacheFirst = Block->LruNext;
+	if (Block->LruNext) Block->LruNext->LruPrev = Block->LruPrev;
+	else PakCacheLast = Block->LruPrev;
+}
+
+static void FreePakBlock(CPakCacheBlock* Block)
+{
+	// remove from hash
+	CPakCacheBlock** Prev = &PakCacheHash[GetPakCacheHash(Block->Reader, Block->Offset)];
+	while (*Prev != Block) Prev = &(*Prev)->HashNext;
+	*Prev = Block->HashNext;
+	// remove from LRU list
+	UnlinkPakBlock(Block);
+	PakCacheSize -= Block->Size;
+	appFree(Block->Data);
+	delete Block;
+}
+
+static CPakCacheBlock* FindPakBlock(const FArchive* Reader, int64 Offset)
+{
+	for (CPakCacheBlock* Cached = PakCacheHash[GetPakCacheHash(Reader, Offset)]; Cached; Cached = Cached->HashNext)
+	{
+		if (Cached->Reader == Reader && Cached->Offset == Offset)
+			return Cached;
+	}
+	return NULL;
+}
+
+int appReadPakBlock(FArchive* Reader, CMutex& ReaderLock, const FPakEntry* Info, int BlockIndex, int BlockOffset, void* Data, int Size)
+{
+	guard(appReadPakBlock);
+
+	const FPakCompressedBlock& Block = Info->CompressionBlocks[BlockIndex];
+	int ToCopy;
+
+	// find cached block; it could be released by another thread as soon as the cache
+	// is unlocked, so copy data while lock is held
+	PakCacheLock.Lock();
+	CPakCacheBlock* Cached = FindPakBlock(Reader, Block.CompressedStart);
+	if (Cached)
+	{
+		// move block to the head of LRU list
+		UnlinkPakBlock(Cached);
+		LinkPakBlock(Cached);
+		ToCopy = min(Cached->Size - BlockOffset, Size);
+		memcpy(Data, Cached->Data + BlockOffset, ToCopy);
+		PakCacheLock.Unlock();
+		return ToCopy;
+	}
+	PakCacheLock.Unlock();
+
+	int CompressedBlockSize = (int)(Block.CompressedEnd - Block.CompressedStart);
+	int UncompressedBlockSize = (int)min((int64)Info->CompressionBlockSize, Info->UncompressedSize - (int64)BlockIndex * Info->CompressionBlockSize);
+
+	// read and decompress block without holding the cache lock, so other threads could
+	// use the cache meanwhile
+	byte* CompressedData = (byte*)appMalloc(CompressedBlockSize);
+	appReadVfsData(Reader, ReaderLock, Block.CompressedStart, CompressedData, CompressedBlockSize);
+	byte* BlockData = (byte*)appMalloc(UncompressedBlockSize);
+	appDecompress(CompressedData, CompressedBlockSize, BlockData, UncompressedBlockSize, Info->CompressionMethod);
+	appFree(CompressedData);
+
+	ToCopy = min(UncompressedBlockSize - BlockOffset, Size);
+	memcpy(Data, BlockData + BlockOffset, ToCopy);
+
+	// put block to cache
+	PakCacheLock.Lock();
+	if (FindPakBlock(Reader, Block.CompressedStart))
+	{
+		// the same block was decompressed by another thread
+		PakCacheLock.Unlock();
+		appFree(BlockData);
+		return ToCopy;
+	}
+
+	// release least recently used blocks to fit memory budget
+	while (PakCacheLast && PakCacheSize + UncompressedBlockSize > PAK_CACHE_MEMORY)
+		FreePakBlock(PakCacheLast);
+
+	int hash = GetPakCacheHash(Reader, Block.CompressedStart);
+	Cached = new CPakCacheBlock;
+	Cached->Reader   = Reader;
+	Cached->Offset   = Block.CompressedStart;
+	Cached->Data     = BlockData;
+	Cached->Size     = UncompressedBlockSize;
+	Cached->HashNext = PakCacheHash[hash];
+	PakCacheHash[hash] = Cached;
+	LinkPakBlock(Cached);
+	PakCacheSize += UncompressedBlockSize;
+	PakCacheLock.Unlock();
+
+	return ToCopy;
+
+	unguardf("block=%d", BlockIndex);
+}
+
+void appFlushPakBlocks(const FArchive* Reader)
+{
+	PakCacheLock.Lock();
+	CPakCacheBlock* Next;
+	for (CPakCacheBlock* Cached = PakCacheFirst; Cached; Cached = Next)
+	{
+		Next = Cached->LruNext;
+		if (Cached->Reader == Reader)
+			FreePakBlock(Cached);
+	}
+	PakCacheLock.Unlock();
+}
+
+#endif // UNREAL4
+
+
 /*-----------------------------------------------------------------------------
 	Game file system
 -----------------------------------------------------------------------------*/
 
-#define MAX_GAME_FILES			32768		// DC Universe Online has more than 20k upk files
 #define MAX_FOREIGN_FILES		32768
 
 static char RootDirectory[MAX_PACKAGE_PATH];
@@ -131,19 +314,23 @@ static bool FindExtension(const char *Filename, const char **Extensions, int Num
 }
 
 
-static CGameFileInfo *GameFiles[MAX_GAME_FILES];
+static TArray<CGameFileInfo*> GameFiles;
 int GNumGameFiles = 0;
 int GNumPackageFiles = 0;
 int GNumForeignFiles = 0;
 
-#define GAME_FILE_HASH_SIZE		4096
-#define GAME_FILE_HASH_MASK		(GAME_FILE_HASH_SIZE-1)
+// CGameFileInfo structures and their names are allocated here
+static CMemoryChain* GameFileMem = NULL;
+
+// Hash table size is a power of 2; it is doubled when number of files exceeds the
+// table size, so the average chain length is not larger than 1.
+#define GAME_FILE_HASH_SIZE		4096			// initial size
 
 //#define PRINT_HASH_DISTRIBUTION	1
 //#define DEBUG_HASH				1
 //#define DEBUG_HASH_NAME			"MiniMap"
 
-static CGameFileInfo* GGameFileHash[GAME_FILE_HASH_SIZE];
+static TArray<CGameFileInfo*> GGameFileHash;
 
 
 #if UNREAL3
@@ -153,22 +340,22 @@ static int            GStartupPackageInfoWeight = 0;
 #endif
 
 
-static int GetHashForFileName(const char* FileName, bool stripExtension)
+// Returns full 32-bit hash value, use GetGameFileHashIndex() to get index in GGameFileHash
+static unsigned GetHashForFileName(const char* FileName, bool stripExtension)
 {
 	const char* s1 = strrchr(FileName, '/'); // assume path delimiters are normalized
 	s1 = (s1 != NULL) ? s1 + 1 : FileName;
 	const char* s2 = stripExtension ? strrchr(s1, '.') : NULL;
 	int len = (s2 != NULL) ? s2 - s1 : strlen(s1);
 
-	uint16 hash = 0;
+	// FNV-1a hash of lowercased string, the same as appStringHash()
+	unsigned hash = 2166136261u;
 	for (int i = 0; i < len; i++)
 	{
 		char c = s1[i];
 		if (c >= 'A' && c <= 'Z') c += 'a' - 'A'; // lowercase a character
-		hash = ROL16(hash, 5) - hash + ((c << 4) + c ^ 0x13F);	// some crazy hash function
+		hash = (hash ^ (byte)c) * 16777619u;
 	}
-//	hash += (len << 6) - len;
-	hash &= GAME_FILE_HASH_MASK;
 #ifdef DEBUG_HASH_NAME
 	if (strstr(FileName, DEBUG_HASH_NAME))
 		printf("-> hash[%s] (%s,%d) -> %X\n", FileName, s1, len, hash);
@@ -176,13 +363,45 @@ static int GetHashForFileName(const char* FileName, bool stripExtension)
 	return hash;
 }
 
+static FORCEINLINE int GetGameFileHashIndex(unsigned hash)
+{
+	return hash & (GGameFileHash.Num() - 1);
+}
+
+static void InsertGameFileHash(CGameFileInfo* info)
+{
+	int hash = GetGameFileHashIndex(GetHashForFileName(info->ShortFilename, true));
+	info->HashNext = GGameFileHash[hash];
+	GGameFileHash[hash] = info;
+#if DEBUG_HASH
+	printf("--> add(%s) pkg=%d hash=%X\n", info->ShortFilename, info->IsPackage, hash);
+#endif
+}
+
+// Grow the hash table when required, keeping the load factor not larger than 1
+static void ResizeGameFileHash(int NumFiles)
+{
+	int hashSize = GGameFileHash.Num();
+	if (hashSize >= NumFiles && hashSize > 0) return;
+
+	if (!hashSize) hashSize = GAME_FILE_HASH_SIZE;
+	while (hashSize < NumFiles) hashSize <<= 1;
+
+	GGameFileHash.Empty(hashSize);
+	GGameFileHash.AddZeroed(hashSize);
+	// rehash all registered files in order of registration, so chains will have
+	// the same order as without resizing
+	for (int i = 0; i < GameFiles.Num(); i++)
+		InsertGameFileHash(GameFiles[i]);
+}
+
 #if PRINT_HASH_DISTRIBUTION
 
 static void PrintHashDistribution()
 {
 	int hashCounts[1024];
 	memset(hashCounts, 0, sizeof(hashCounts));
-	for (int hash = 0; hash < GAME_FILE_HASH_SIZE; hash++)
+	for (int hash = 0; hash < GGameFileHash.Num(); hash++)
 	{
 		int count = 0;
 		for (CGameFileInfo* info = GGameFileHash[hash]; info; info = info->HashNext)
@@ -199,76 +418,471 @@ static void PrintHashDistribution()
 #endif // PRINT_HASH_DISTRIBUTION
 
 
-//!! add define USE_VFS = SUPPORT_ANDROID || UNREAL4, perhaps || SUPPORT_IOS
+/*-----------------------------------------------------------------------------
+	Game file cache
+-----------------------------------------------------------------------------*/
 
-static TArray<FVirtualFileSystem*> GFileSystems;
+// Scanning of a large game installation takes a lot of time: every directory should be
+// enumerated, and every pak file directory should be read. The cache file holds contents
+// of all scanned directories, VFS directories and package versions found by ScanPackages().
+// Directory contents are reused when the directory modification time was not changed,
+// VFS directory - when VFS file has the same size and time. Whole cache file is loaded
+// with a single read, strings are used in-place.
+
+#define GAME_FILE_CACHE_TAG			0x43464D55		// 'UMFC'
+#define GAME_FILE_CACHE_VERSION		2
 
-static bool RegisterGameFile(const char *FullName, FVirtualFileSystem* parentVfs = NULL)
+struct CGameDirEntry
 {
-	guard(RegisterGameFile);
+	const char*		Name;
+	int64			Size;
+	bool			IsDir;
+};
 
-//	printf("..file %s\n", FullName);
-	// return false when MAX_GAME_FILES
-	if (GNumGameFiles >= ARRAY_COUNT(GameFiles))
-		return false;
+struct CGameDirInfo
+{
+	const char*		Name;						// full path
+	int64			Time;
+	int				FirstEntry;					// index of the first CGameDirEntry
+	int				NumEntries;
+	CGameDirInfo*	HashNext;
+};
+
+struct CGameVfsInfo
+{
+	const char*		Name;						// full path
+	int64			Size;
+	int64			Time;
+	const byte*		Data;						// VFS directory saved with FVirtualFileSystem::SaveDirectory()
+	int				DataSize;
+	FVirtualFileSystem* Vfs;					// mounted file system, used for saving
+	CGameVfsInfo*	HashNext;
+};
+
+struct CGamePackageInfo
+{
+	const char*		Name;						// relative name
+	int				SizeInKb;
+	int				Ver;
+	int				LicVer;
+	CGamePackageInfo* HashNext;
+};
+
+static const char* GGameFileCacheName = NULL;
+static bool GGameFileCacheChanged = false;
+static bool GScanRecurse = true;
 
-	if (!parentVfs)		// no nested VFSs
+// contents of loaded cache file; all strings are pointing here
+static byte* CacheData = NULL;
+
+// information loaded from the cache
+static TArray<CGameDirInfo>		CachedDirs;
+static TArray<CGameDirEntry>	CachedDirEntries;
+static TArray<CGameVfsInfo>		CachedVfs;
+static TArray<CGamePackageInfo>	CachedPackages;
+static TArray<CGameDirInfo*>	CachedDirHash;
+static TArray<CGameVfsInfo*>	CachedVfsHash;
+static TArray<CGamePackageInfo*> CachedPackageHash;
+
+// information collected during current scan, will be saved to the cache
+static TArray<CGameDirInfo>		ScannedDirs;
+static TArray<CGameDirEntry>	ScannedDirEntries;
+static TArray<CGameVfsInfo>		MountedVfs;
+
+
+template<class T>
+static void BuildCacheHash(TArray<T>& Items, TArray<T*>& Hash)
+{
+	int hashSize = 256;
+	while (hashSize < Items.Num()) hashSize <<= 1;
+	Hash.Empty(hashSize);
+	Hash.AddZeroed(hashSize);
+	for (int i = 0; i < Items.Num(); i++)
 	{
-		const char* ext = strrchr(FullName, '.');
-		if (ext)
+		T* item = &Items[i];
+		int hash = appStringHash(item->Name) & (hashSize - 1);
+		item->HashNext = Hash[hash];
+		Hash[hash] = item;
+	}
+}
+
+template<class T>
+static const T* FindCacheItem(const TArray<T*>& Hash, const char* Name)
+{
+	if (!Hash.Num()) return NULL;
+	int hash = appStringHash(Name) & (Hash.Num() - 1);
+	for (const T* item = Hash[hash]; item; item = item->HashNext)
+	{
+		if (!strcmp(item->Name, Name))
+			return item;
+	}
+	return NULL;
+}
+
+// Cache file could be truncated or corrupted, so everything is verified before reading
+
+static bool CacheHasBytes(const FArchive& Ar, int Size)
+{
+	return Size >= 0 && Size <= Ar.GetFileSize() - Ar.Tell();
+}
+
+// Check if 'Count' items of at least 'MinItemSize' bytes could fit into the rest of the cache
+static bool CacheHasItems(const FArchive& Ar, int Count, int MinItemSize)
+{
+	return Count >= 0 && Count <= (Ar.GetFileSize() - Ar.Tell()) / MinItemSize;
+}
+
+// Returns NULL when the string doesn't fit into the cache or is not null-terminated
+static const char* ReadCacheString(FArchive& Ar)
+{
+	int len;
+	if (!CacheHasBytes(Ar, sizeof(int))) return NULL;
+	Ar << len;
+	if (len <= 0 || !CacheHasBytes(Ar, len)) return NULL;
+	const char* s = (const char*)CacheData + Ar.Tell();
+	if (s[len-1] != 0) return NULL;
+	Ar.Seek(Ar.Tell() + len);
+	return s;
+}
+
+// minimal sizes of serialized cache items: string is at least 5 bytes (length and null char)
+#define CACHE_DIR_SIZE				(5 + 8 + 4)
+#define CACHE_DIR_ENTRY_SIZE		(5 + 8 + 4)
+#define CACHE_VFS_SIZE				(5 + 8 + 8 + 4)
+#define CACHE_PACKAGE_SIZE			(5 + 4 + 4 + 4)
+
+// Read everything after the cache header and the root directory, returns false when
+// cache contents are not valid
+static bool ReadGameFileCacheItems(FArchive& Ar)
+{
+	int i, j, Count;
+	// directories
+	if (!CacheHasBytes(Ar, sizeof(int))) return false;
+	Ar << Count;
+	if (!CacheHasItems(Ar, Count, CACHE_DIR_SIZE)) return false;
+	CachedDirs.AddZeroed(Count);
+	for (i = 0; i < Count; i++)
+	{
+		CGameDirInfo& D = CachedDirs[i];
+		D.Name = ReadCacheString(Ar);
+		if (!D.Name || !CacheHasBytes(Ar, 8 + 4)) return false;
+		Ar << D.Time << D.NumEntries;
+		if (!CacheHasItems(Ar, D.NumEntries, CACHE_DIR_ENTRY_SIZE)) return false;
+		D.FirstEntry = CachedDirEntries.Num();
+		CachedDirEntries.AddZeroed(D.NumEntries);
+		for (j = 0; j < D.NumEntries; j++)
 		{
-			guard(MountVFS);
+			CGameDirEntry& E = CachedDirEntries[D.FirstEntry + j];
+			E.Name = ReadCacheString(Ar);
+			if (!E.Name || !CacheHasBytes(Ar, 8 + 4)) return false;
+			Ar << E.Size << E.IsDir;
+		}
+	}
+	// virtual file systems
+	if (!CacheHasBytes(Ar, sizeof(int))) return false;
+	Ar << Count;
+	if (!CacheHasItems(Ar, Count, CACHE_VFS_SIZE)) return false;
+	CachedVfs.AddZeroed(Count);
+	for (i = 0; i < Count; i++)
+	{
+		CGameVfsInfo& V = CachedVfs[i];
+		V.Name = ReadCacheString(Ar);
+		if (!V.Name || !CacheHasBytes(Ar, 8 + 8 + 4)) return false;
+		Ar << V.Size << V.Time << V.DataSize;
+		if (!CacheHasBytes(Ar, V.DataSize)) return false;
+		V.Data = CacheData + Ar.Tell();
+		Ar.Seek(Ar.Tell() + V.DataSize);
+	}
+	// package versions
+	if (!CacheHasBytes(Ar, sizeof(int))) return false;
+	Ar << Count;
+	if (!CacheHasItems(Ar, Count, CACHE_PACKAGE_SIZE)) return false;
+	CachedPackages.AddZeroed(Count);
+	for (i = 0; i < Count; i++)
+	{
+		CGamePackageInfo& P = CachedPackages[i];
+		P.Name = ReadCacheString(Ar);
+		if (!P.Name || !CacheHasBytes(Ar, 4 + 4 + 4)) return false;
+		Ar << P.SizeInKb << P.Ver << P.LicVer;
+	}
+	// the whole file should be used
+	return Ar.Tell() == Ar.GetFileSize();
+}
+
+static void WriteCacheString(FArchive& Ar, const char* s)
+{
+	int len = strlen(s) + 1;
+	Ar << len;
+	Ar.Serialize(const_cast<char*>(s), len);
+}
+
+
+// Get file size and modification time, returns false when file doesn't exist
+static bool GetFileStat(const char* Filename, int64& Size, int64& Time)
+{
+#if _WIN32
+	struct _stati64 buf;
+	if (_stati64(Filename, &buf) < 0) return false;
+#else
+	struct stat64 buf;
+	if (stat64(Filename, &buf) < 0) return false;
+#endif
+	Size = buf.st_size;
+	Time = buf.st_mtime;
+	return true;
+}
+
+
+void appSetGameFileCache(const char *filename)
+{
+	GGameFileCacheName = filename ? appStrdup(filename) : NULL;
+}
+
+
+// Note: this function doesn't use guard because of local FMemReader object
+static void LoadGameFileCache()
+{
+	// drop results of previous scan
+	ScannedDirs.Empty();
+	ScannedDirEntries.Empty();
+	MountedVfs.Empty();
+	CachedDirs.Empty();
+	CachedDirEntries.Empty();
+	CachedVfs.Empty();
+	CachedPackages.Empty();
+	CachedDirHash.Empty();
+	CachedVfsHash.Empty();
+	CachedPackageHash.Empty();
+	if (CacheData)
+	{
+		appFree(CacheData);
+		CacheData = NULL;
+	}
+	GGameFileCacheChanged = true;
 
-			ext++;
-			FVirtualFileSystem* vfs = NULL;
-			FArchive* reader = NULL;
+	if (!GGameFileCacheName) return;
+
+	FILE* f = fopen(GGameFileCacheName, "rb");
+	if (!f) return;
+	fseek(f, 0, SEEK_END);
+	int DataSize = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	bool ok = false;
+	if (DataSize > 0)
+	{
+		CacheData = (byte*)appMalloc(DataSize);
+		ok = (fread(CacheData, DataSize, 1, f) == 1);
+	}
+	fclose(f);
+
+	FMemReader Ar(CacheData, ok ? DataSize : 0);
+	int Tag = 0, Version = 0, StoredSize = 0;
+	if (ok && DataSize >= (int)sizeof(int) * 3)
+		Ar << Tag << Version << StoredSize;
+	if (Tag != GAME_FILE_CACHE_TAG || Version != GAME_FILE_CACHE_VERSION || StoredSize != DataSize)
+	{
+		appPrintf("Ignoring game file cache %s: bad file format\n", GGameFileCacheName);
+		if (CacheData) appFree(CacheData);
+		CacheData = NULL;
+		return;
+	}
+	// the cache is valid only for the same root directory
+	const char* Root = ReadCacheString(Ar);
+	byte Recurse = 0;
+	bool RootOk = Root && CacheHasBytes(Ar, 1);
+	if (RootOk) Ar << Recurse;
+	if (RootOk && (strcmp(Root, RootDirectory) != 0 || Recurse != GScanRecurse))
+	{
+		appFree(CacheData);
+		CacheData = NULL;
+		return;
+	}
+
+	if (!RootOk || !ReadGameFileCacheItems(Ar))
+	{
+		appPrintf("Ignoring game file cache %s: bad file format\n", GGameFileCacheName);
+		CachedDirs.Empty();
+		CachedDirEntries.Empty();
+		CachedVfs.Empty();
+		CachedPackages.Empty();
+		appFree(CacheData);
+		CacheData = NULL;
+		return;
+	}
+
+	BuildCacheHash(CachedDirs, CachedDirHash);
+	BuildCacheHash(CachedVfs, CachedVfsHash);
+	BuildCacheHash(CachedPackages, CachedPackageHash);
+	GGameFileCacheChanged = false;
+}
+
+
+// Note: this function doesn't use guard because of local FMemWriter objects
+void appSaveGameFileCache()
+{
+	if (!GGameFileCacheName || !RootDirectory[0]) return;
+
+	FMemWriter Ar;
+	int i, j, Count, CountPos;
+	int Tag = GAME_FILE_CACHE_TAG, Version = GAME_FILE_CACHE_VERSION, DataSize = 0;
+	Ar << Tag << Version << DataSize;		// DataSize will be updated later
+	WriteCacheString(Ar, RootDirectory);
+	byte Recurse = GScanRecurse;
+	Ar << Recurse;
+
+	// directories
+	Count = ScannedDirs.Num();
+	Ar << Count;
+	for (i = 0; i < Count; i++)
+	{
+		CGameDirInfo& D = ScannedDirs[i];
+		WriteCacheString(Ar, D.Name);
+		Ar << D.Time << D.NumEntries;
+		for (j = 0; j < D.NumEntries; j++)
+		{
+			CGameDirEntry& E = ScannedDirEntries[D.FirstEntry + j];
+			WriteCacheString(Ar, E.Name);
+			Ar << E.Size << E.IsDir;
+		}
+	}
+
+	// virtual file systems; not all of them are supporting caching
+	CountPos = Ar.Tell();
+	Count = 0;
+	Ar << Count;
+	for (i = 0; i < MountedVfs.Num(); i++)
+	{
+		CGameVfsInfo& V = MountedVfs[i];
+		FMemWriter VfsAr;
+		if (!V.Vfs->SaveDirectory(VfsAr)) continue;
+		WriteCacheString(Ar, V.Name);
+		int VfsSize = VfsAr.GetFileSize();
+		Ar << V.Size << V.Time << VfsSize;
+		Ar.Serialize(const_cast<byte*>(VfsAr.GetData()), VfsSize);
+		Count++;
+	}
+	Ar.Seek(CountPos);
+	Ar << Count;
+	Ar.Seek(Ar.GetFileSize());
+
+	// package versions
+	CountPos = Ar.Tell();
+	Count = 0;
+	Ar << Count;
+	for (i = 0; i < GNumGameFiles; i++)
+	{
+		const CGameFileInfo* info = GameFiles[i];
+		if (!info->PackageVer) continue;	// not scanned
+		WriteCacheString(Ar, info->RelativeName);
+		int SizeInKb = info->SizeInKb, Ver = info->PackageVer, LicVer = info->PackageLicVer;
+		Ar << SizeInKb << Ver << LicVer;
+		Count++;
+	}
+	Ar.Seek(CountPos);
+	Ar << Count;
+
+	DataSize = Ar.GetFileSize();
+	Ar.Seek(sizeof(int) * 2);
+	Ar << DataSize;
+
+	FILE* f = fopen(GGameFileCacheName, "wb");
+	if (!f)
+	{
+		appPrintf("WARNING: unable to write game file cache %s\n", GGameFileCacheName);
+		return;
+	}
+	fwrite(Ar.GetData(), DataSize, 1, f);
+	fclose(f);
+	GGameFileCacheChanged = false;
+}
+
+
+// Virtual file system which is mounted during directory scan
+struct CGameVfsMount
+{
+	char			Filename[MAX_PACKAGE_PATH];
+	int				Game;						// value for Reader->Game
+	FVirtualFileSystem* Vfs;					// NULL when mounting failed
+	FArchive*		Reader;
+	int64			Size;
+	int64			Time;
+	bool			FromCache;
+};
+
+// Open VFS file and read its directory; use directory from the game file cache when VFS
+// file was not changed since the last run. This function is called from worker threads.
+// Note: this function doesn't use guard because of local FMemReader object
+static void MountGameVfs(CGameVfsMount& M)
+{
+	M.Reader = new FFileReader(M.Filename);
+	M.Reader->Game = M.Game;
+	GetFileStat(M.Filename, M.Size, M.Time);
+
+	bool Attached = false;
+	const CGameVfsInfo* Cached = FindCacheItem(CachedVfsHash, M.Filename);
+	if (Cached && Cached->Size == M.Size && Cached->Time == M.Time)
+	{
+		FMemReader Ar(Cached->Data, Cached->DataSize);
+		Attached = M.FromCache = M.Vfs->LoadDirectory(M.Reader, Ar);
+	}
+	if (!Attached)
+		Attached = M.Vfs->AttachReader(M.Reader);
+	if (!Attached)
+	{
+		// something goes wrong
+		delete M.Vfs;
+		delete M.Reader;
+		M.Vfs = NULL;
+		M.Reader = NULL;
+	}
+}
+
+static void MountGameVfsWorker(CGameVfsMount* Mounts, int First, int Last)
+{
+	int i = First;
+	guard(MountGameVfs);
+	for ( ; i < Last; i++)
+		MountGameVfs(Mounts[i]);
+	unguardf("%s", Mounts[i].Filename);
+}
+
+
+//!! add define USE_VFS = SUPPORT_ANDROID || UNREAL4, perhaps || SUPPORT_IOS
+
+static TArray<FVirtualFileSystem*> GFileSystems;
+
+// Create VFS object for the file, returns NULL when this is not a VFS file
+static FVirtualFileSystem* CreateGameVfs(const char *FullName, int& Game)
+{
+	const char* ext = strrchr(FullName, '.');
+	if (!ext) return NULL;
+	ext++;
 
 #if SUPPORT_ANDROID
-			if (!stricmp(ext, "obb"))
-			{
-				GForcePlatform = PLATFORM_ANDROID;
-				reader = new FFileReader(FullName);
-				if (!reader) return true;
-				reader->Game = GAME_UE3;
-				vfs = new FObbVFS();
-			}
+	if (!stricmp(ext, "obb"))
+	{
+		GForcePlatform = PLATFORM_ANDROID;
+		Game = GAME_UE3;
+		return new FObbVFS();
+	}
 #endif // SUPPORT_ANDROID
 #if UNREAL4
-			if (!stricmp(ext, "pak"))
-			{
-				reader = new FFileReader(FullName);
-				if (!reader) return true;
-				reader->Game = GAME_UE4;
-				vfs = new FPakVFS();
-				//!! detect game by file name
-			}
+	if (!stricmp(ext, "pak"))
+	{
+		Game = GAME_UE4;
+		return new FPakVFS();
+		//!! detect game by file name
+	}
 #endif // UNREAL4
-			//!! process other VFS types here
-			if (vfs)
-			{
-				assert(reader);
-				// read VF directory
-				if (!vfs->AttachReader(reader))
-				{
-					// something goes wrong
-					delete vfs;
-					delete reader;
-					return true;
-				}
-				// add game files
-				int NumVFSFiles = vfs->NumFiles();
-				for (int i = 0; i < NumVFSFiles; i++)
-				{
-					if (!RegisterGameFile(vfs->FileName(i), vfs))
-						return false;
-				}
-				return true;
-			}
+	//!! process other VFS types here
+	return NULL;
+}
 
-			unguard;
-		}
-	}
+static void RegisterGameFile(const char *FullName, int64 FileSize, FVirtualFileSystem* parentVfs = NULL)
+{
+	guard(RegisterGameFile);
 
+//	printf("..file %s\n", FullName);
 	bool IsPackage;
 	if (FindExtension(FullName, ARRAY_ARG(PackageExtensions)))
 	{
@@ -282,18 +896,19 @@ static bool RegisterGameFile(const char *FullName, FVirtualFileSystem* parentVfs
 		{
 			// perhaps this file was exported by our tool - skip it
 			if (FindExtension(FullName, ARRAY_ARG(SkipExtensions)))
-				return true;
-			// unknown file type
-			if (++GNumForeignFiles >= MAX_FOREIGN_FILES)
+				return;
+			// unknown file type; large number of such files is fine when there are many game files too
+			if (++GNumForeignFiles >= MAX_FOREIGN_FILES && GNumForeignFiles > GNumGameFiles)
 				appError("Too many unknown files - bad root directory (%s)?", RootDirectory);
-			return true;
+			return;
 		}
 		IsPackage = false;
 	}
 
 	// create entry
-	CGameFileInfo *info = new CGameFileInfo;
-	GameFiles[GNumGameFiles++] = info;
+	if (!GameFileMem) GameFileMem = new CMemoryChain();
+	CGameFileInfo *info = (CGameFileInfo*)GameFileMem->Alloc(sizeof(CGameFileInfo));
+	memset(info, 0, sizeof(CGameFileInfo));
 	info->IsPackage = IsPackage;
 	info->FileSystem = parentVfs;
 	if (IsPackage) GNumPackageFiles++;
@@ -301,27 +916,21 @@ static bool RegisterGameFile(const char *FullName, FVirtualFileSystem* parentVfs
 	if (!parentVfs)
 	{
 		// regular file
-		FILE* f = fopen(FullName, "rb");
-		if (f)
-		{
-			fseek(f, 0, SEEK_END);
-			info->SizeInKb = (ftell(f) + 512) / 1024;
-			fclose(f);
-		}
-		else
-		{
-			info->SizeInKb = 0;
-		}
+		info->SizeInKb = (int)((FileSize + 512) / 1024);
 		// cut RootDirectory from filename
 		const char *s = FullName + strlen(RootDirectory) + 1;
 		assert(s[-1] == '/');
-		appStrncpyz(info->RelativeName, s, ARRAY_COUNT(info->RelativeName));
+		int len = strlen(s) + 1;
+		char* name = (char*)GameFileMem->Alloc(len, 1);
+		memcpy(name, s, len);
+		info->RelativeName = name;
 	}
 	else
 	{
-		// file in virtual file system
+		// file in virtual file system; VFS keeps file names until it is destroyed,
+		// and VFS objects are never destroyed, so use the same string
 		info->SizeInKb = parentVfs->GetFileSize(FullName);
-		appStrncpyz(info->RelativeName, FullName, ARRAY_COUNT(info->RelativeName));
+		info->RelativeName = FullName;
 	}
 
 	// find filename
@@ -333,6 +942,17 @@ static bool RegisterGameFile(const char *FullName, FVirtualFileSystem* parentVfs
 	if (s) s++;
 	info->Extension = s;
 
+	if (IsPackage)
+	{
+		// restore package version from the game file cache
+		const CGamePackageInfo* cached = FindCacheItem(CachedPackageHash, info->RelativeName);
+		if (cached && cached->SizeInKb == info->SizeInKb)
+		{
+			info->PackageVer    = cached->Ver;
+			info->PackageLicVer = cached->LicVer;
+		}
+	}
+
 #if UNREAL3
 	if (info->IsPackage && (strnicmp(info->ShortFilename, "startup", 7) == 0))
 	{
@@ -358,72 +978,235 @@ static bool RegisterGameFile(const char *FullName, FVirtualFileSystem* parentVfs
 	}
 #endif // UNREAL3
 
-	// insert CGameFileInfo into hash table
-	int hash = GetHashForFileName(info->ShortFilename, true);
-	info->HashNext = GGameFileHash[hash];
-	GGameFileHash[hash] = info;
-#if DEBUG_HASH
-	printf("--> add(%s) pkg=%d hash=%X\n", info->ShortFilename, info->IsPackage, hash);
-#endif
-
-	return true;
+	// insert CGameFileInfo into hash table, resize it before adding to GameFiles
+	ResizeGameFileHash(GNumGameFiles + 1);
+	InsertGameFileHash(info);
+	GameFiles.Add(info);
+	GNumGameFiles++;
 
 	unguardf("%s", FullName);
 }
 
-static bool ScanGameDirectory(const char *dir, bool recurse)
+// Register all files of mounted VFS
+static void RegisterGameVfs(const CGameVfsMount& M)
 {
-	guard(ScanGameDirectory);
+	guard(RegisterGameVfs);
+
+	// remember VFS for the game file cache
+	CGameVfsInfo* Info = new (MountedVfs) CGameVfsInfo;
+	Info->Name = appStrdupPool(M.Filename);
+	Info->Size = M.Size;
+	Info->Time = M.Time;
+	Info->Vfs  = M.Vfs;
+	if (!M.FromCache) GGameFileCacheChanged = true;
+
+	int NumVFSFiles = M.Vfs->NumFiles();
+	for (int i = 0; i < NumVFSFiles; i++)
+		RegisterGameFile(M.Vfs->FileName(i), 0, M.Vfs);
+
+	unguardf("%s", M.Filename);
+}
+
+// Read directory contents using OS functions, returns false when directory couldn't be opened
+static bool ReadGameDirectory(const char *dir, TArray<CGameDirEntry>& Entries)
+{
+	guard(ReadGameDirectory);
 
 	char Path[MAX_PACKAGE_PATH];
-	bool res = true;
-//	printf("Scan %s\n", dir);
 #if _WIN32
 	appSprintf(ARRAY_ARG(Path), "%s/*.*", dir);
 	_finddatai64_t found;
 	long hFind = _findfirsti64(Path, &found);
-	if (hFind == -1) return true;
+	if (hFind == -1) return false;
 	do
 	{
 		if (found.name[0] == '.') continue;			// "." or ".."
-		appSprintf(ARRAY_ARG(Path), "%s/%s", dir, found.name);
-		// directory -> recurse
-		if (found.attrib & _A_SUBDIR)
-		{
-			if (recurse)
-				res = ScanGameDirectory(Path, recurse);
-			else
-				res = true;
-		}
-		else
-			res = RegisterGameFile(Path);
-	} while (res && _findnexti64(hFind, &found) != -1);
+		CGameDirEntry* E = new (Entries) CGameDirEntry;
+		E->Name  = appStrdupPool(found.name);
+		E->Size  = found.size;
+		E->IsDir = (found.attrib & _A_SUBDIR) != 0;
+	} while (_findnexti64(hFind, &found) != -1);
 	_findclose(hFind);
 #else
 	DIR *find = opendir(dir);
-	if (!find) return true;
+	if (!find) return false;
 	struct dirent *ent;
-	while (/*res &&*/ (ent = readdir(find)))
+	while ((ent = readdir(find)))
 	{
 		if (ent->d_name[0] == '.') continue;			// "." or ".."
 		appSprintf(ARRAY_ARG(Path), "%s/%s", dir, ent->d_name);
-		// directory -> recurse
 		// note: using 'stat64' here because 'stat' ignores large files
 		struct stat64 buf;
 		if (stat64(Path, &buf) < 0) continue;			// or break?
-		if (S_ISDIR(buf.st_mode))
+		CGameDirEntry* E = new (Entries) CGameDirEntry;
+		E->Name  = appStrdupPool(ent->d_name);
+		E->Size  = buf.st_size;
+		E->IsDir = S_ISDIR(buf.st_mode);
+	}
+	closedir(find);
+#endif
+	return true;
+
+	unguard;
+}
+
+// Directory scanning is performed in 3 steps:
+// 1. Directories are read level by level, all directories of the same level are read
+//    in parallel.
+// 2. Files are collected in the same order as with simple recursive directory walk, so
+//    registration order doesn't depend on number of threads. VFS files are mounted in
+//    parallel.
+// 3. Files are registered in the main thread.
+
+struct CScanDir
+{
+	char			Path[MAX_PACKAGE_PATH];
+	int64			Time;
+	bool			Valid;						// false when directory couldn't be read
+	bool			FromCache;
+	int				FirstChild;					// index of the first subdirectory in the directory list
+	TArray<CGameDirEntry> Entries;
+};
+
+struct CScanFile
+{
+	const CScanDir*	Dir;
+	int				Entry;						// index in Dir->Entries
+	int				Mount;						// index of CGameVfsMount, -1 for regular files
+};
+
+static void ReadScanDirWorker(CScanDir** Dirs, int First, int Last)
+{
+	guard(ReadScanDir);
+
+	for (int i = First; i < Last; i++)
+	{
+		CScanDir* D = Dirs[i];
+		// use the game file cache when directory was not changed
+		int64 Size;
+		if (!GetFileStat(D->Path, Size, D->Time)) continue;
+		const CGameDirInfo* cached = FindCacheItem(CachedDirHash, D->Path);
+		if (cached && cached->Time == D->Time)
 		{
-			if (recurse)
-				res = ScanGameDirectory(Path, recurse);
-			else
-				res = true;
+			D->Entries.Empty(cached->NumEntries);
+			for (int j = 0; j < cached->NumEntries; j++)
+				D->Entries.Add(CachedDirEntries[cached->FirstEntry + j]);
+			D->Valid = D->FromCache = true;
 		}
 		else
-			res = RegisterGameFile(Path);
+		{
+			D->Valid = ReadGameDirectory(D->Path, D->Entries);
+		}
 	}
-	closedir(find);
-#endif
-	return res;
+
+	unguard;
+}
+
+static void CollectScanFiles(const TArray<CScanDir*>& Dirs, int DirIndex, bool recurse, TArray<CScanFile>& Files, TArray<CGameVfsMount>& Mounts)
+{
+	const CScanDir* D = Dirs[DirIndex];
+	if (!D->Valid) return;
+
+	// remember directory for the game file cache
+	CGameDirInfo* info = new (ScannedDirs) CGameDirInfo;
+	info->Name       = appStrdupPool(D->Path);
+	info->Time       = D->Time;
+	info->FirstEntry = ScannedDirEntries.Num();
+	info->NumEntries = D->Entries.Num();
+	for (int i = 0; i < D->Entries.Num(); i++)
+		ScannedDirEntries.Add(D->Entries[i]);
+	if (!D->FromCache) GGameFileCacheChanged = true;
+
+	int ChildIndex = D->FirstChild;
+	for (int i = 0; i < D->Entries.Num(); i++)
+	{
+		const CGameDirEntry& E = D->Entries[i];
+		// directory -> recurse
+		if (E.IsDir)
+		{
+			if (recurse)
+				CollectScanFiles(Dirs, ChildIndex++, recurse, Files, Mounts);
+			continue;
+		}
+		CScanFile* F = new (Files) CScanFile;
+		F->Dir   = D;
+		F->Entry = i;
+		F->Mount = -1;
+		// check for VFS file
+		char Path[MAX_PACKAGE_PATH];
+		appSprintf(ARRAY_ARG(Path), "%s/%s", D->Path, E.Name);
+		int Game;
+		FVirtualFileSystem* Vfs = CreateGameVfs(Path, Game);
+		if (Vfs)
+		{
+			F->Mount = Mounts.Num();
+			CGameVfsMount* M = new (Mounts) CGameVfsMount;
+			appStrncpyz(M->Filename, Path, ARRAY_COUNT(M->Filename));
+			M->Game = Game;
+			M->Vfs  = Vfs;
+		}
+	}
+}
+
+static void ScanGameDirectory(const char *dir, bool recurse)
+{
+	guard(ScanGameDirectory);
+
+	int i;
+//	printf("Scan %s\n", dir);
+
+	// read directories
+	TArray<CScanDir*> Dirs;
+	CScanDir* Root = new CScanDir;
+	appStrncpyz(Root->Path, dir, ARRAY_COUNT(Root->Path));
+	Dirs.Add(Root);
+	int FirstDir = 0;
+	while (FirstDir < Dirs.Num())
+	{
+		int LastDir = Dirs.Num();
+		appParallelFor(LastDir - FirstDir, 1, ReadScanDirWorker, Dirs.GetData() + FirstDir);
+		if (!recurse) break;
+		// queue subdirectories for the next level
+		for (i = FirstDir; i < LastDir; i++)
+		{
+			CScanDir* D = Dirs[i];
+			D->FirstChild = Dirs.Num();
+			for (int j = 0; j < D->Entries.Num(); j++)
+			{
+				const CGameDirEntry& E = D->Entries[j];
+				if (!E.IsDir) continue;
+				CScanDir* Child = new CScanDir;
+				appSprintf(ARRAY_ARG(Child->Path), "%s/%s", D->Path, E.Name);
+				Dirs.Add(Child);
+			}
+		}
+		FirstDir = LastDir;
+	}
+
+	// collect files and mount VFSs
+	TArray<CScanFile> Files;
+	TArray<CGameVfsMount> Mounts;
+	CollectScanFiles(Dirs, 0, recurse, Files, Mounts);
+	appParallelFor(Mounts.Num(), 1, MountGameVfsWorker, Mounts.GetData());
+
+	// register files
+	char Path[MAX_PACKAGE_PATH];
+	for (i = 0; i < Files.Num(); i++)
+	{
+		const CScanFile& F = Files[i];
+		if (F.Mount >= 0)
+		{
+			const CGameVfsMount& M = Mounts[F.Mount];
+			if (M.Vfs) RegisterGameVfs(M);
+			continue;
+		}
+		const CGameDirEntry& E = F.Dir->Entries[F.Entry];
+		appSprintf(ARRAY_ARG(Path), "%s/%s", F.Dir->Path, E.Name);
+		RegisterGameFile(Path, E.Size);
+	}
+
+	for (i = 0; i < Dirs.Num(); i++)
+		delete Dirs[i];
 
 	unguard;
 }
@@ -434,11 +1217,15 @@ void appSetRootDirectory(const char *dir, bool recurse)
 	guard(appSetRootDirectory);
 	if (dir[0] == 0) dir = ".";	// using dir="" will cause scanning of "/dir1", "/dir2" etc (i.e. drive root)
 	appStrncpyz(RootDirectory, dir, ARRAY_COUNT(RootDirectory));
+	GScanRecurse = recurse;
+	LoadGameFileCache();
 	ScanGameDirectory(RootDirectory, recurse);
 	appPrintf("Found %d game files (%d skipped)\n", GNumGameFiles, GNumForeignFiles);
 #if PRINT_HASH_DISTRIBUTION
 	PrintHashDistribution();
 #endif
+	if (GGameFileCacheChanged)
+		appSaveGameFileCache();
 	unguardf("dir=%s", dir);
 }
 
@@ -579,7 +1366,8 @@ const CGameFileInfo *appFindGameFile(const char *Filename, const char *Ext)
 	}
 
 	// Get hash before stripping extension (could be required for files with double extension, like .hdr.rtc for games with Redux textures)
-	int hash = GetHashForFileName(buf, /* stripExtension = */ Ext == NULL);
+	if (!GGameFileHash.Num()) return NULL;		// no game files were registered
+	int hash = GetGameFileHashIndex(GetHashForFileName(buf, /* stripExtension = */ Ext == NULL));
 #if DEBUG_HASH
 	printf("--> find(%s) hash=%X\n", buf, hash);
 #endif
@@ -692,6 +1480,10 @@ FArchive *appCreateFileReader(const CGameFileInfo *info)
 		// regular file
 		char buf[MAX_PACKAGE_PATH];
 		appSprintf(ARRAY_ARG(buf), "%s/%s", RootDirectory, info->RelativeName);
+		// prefer memory-mapped reader, fallback to buffered one when file couldn't be mapped
+		FMappedFileReader *Reader = new FMappedFileReader(buf);
+		if (Reader->IsOpen()) return Reader;
+		delete Reader;
 		return new FFileReader(buf);
 	}
 	else
@@ -10,6 +10,17 @@ public:
 	// Attach FArchive which will be used for reading VFS content. This function should
 	// scan VFS directory.
 	virtual bool AttachReader(FArchive* reader) = 0;
+	// Functions for the game file cache. SaveDirectory() stores the scanned directory, and
+	// LoadDirectory() restores it, it is used instead of AttachReader(). Both functions
+	// returns false when VFS doesn't support caching.
+	virtual bool SaveDirectory(FArchive& Ar)
+	{
+		return false;
+	}
+	virtual bool LoadDirectory(FArchive* reader, FArchive& Ar)
+	{
+		return false;
+	}
 	// Open a file from VFS.
 	virtual FArchive* CreateReader(const char* name) = 0;
 
@@ -20,5 +31,11 @@ public:
 	virtual int GetFileSize(const char* name) = 0;
 };
 
+class CMutex;
+
+// Read data from the archive which is shared between all files of VFS. These files could be
+// read from different threads, so seek and read are performed with 'ReaderLock' held.
+void appReadVfsData(FArchive* Reader, CMutex& ReaderLock, int64 Pos, void* Data, int Size);
+
 
 #endif // __GAME_FILE_SYSTEM_H__
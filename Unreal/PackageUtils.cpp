@@ -5,6 +5,7 @@
 #include "UnPackage.h"
 
 #include "PackageUtils.h"
+#include "Parallel.h"
 
 /*-----------------------------------------------------------------------------
 	Package loader/unloader
@@ -15,7 +16,10 @@ bool LoadWholePackage(UnPackage* Package, IProgressCallback* progress)
 {
 	guard(LoadWholePackage);
 
-	if (GFullyLoadedPackages.FindItem(Package) >= 0) return true;	// already loaded
+	UObject::LockObjects();
+	bool AlreadyLoaded = (GFullyLoadedPackages.FindItem(Package) >= 0);
+	UObject::UnlockObjects();
+	if (AlreadyLoaded) return true;
 
 #if PROFILE
 	appResetProfiler();
@@ -30,7 +34,10 @@ bool LoadWholePackage(UnPackage* Package, IProgressCallback* progress)
 		Package->CreateExport(idx);
 	}
 	UObject::EndLoad();
-	GFullyLoadedPackages.Add(Package);
+	UObject::LockObjects();
+	if (GFullyLoadedPackages.FindItem(Package) < 0)
+		GFullyLoadedPackages.Add(Package);
+	UObject::UnlockObjects();
 
 #if PROFILE
 	appPrintProfiler();
@@ -41,6 +48,61 @@ bool LoadWholePackage(UnPackage* Package, IProgressCallback* progress)
 	unguardf("%s", Package->Name);
 }
 
+struct CLoadPackagesJob
+{
+	const TArray<UnPackage*>* Packages;
+};
+
+static void LoadPackagesWorker(CLoadPackagesJob* Job, int First, int Last)
+{
+	// errors are passed to appParallelFor(), which releases locks held by the failed
+	// thread with UObject::ResetLoadingContext()
+	for (int i = First; i < Last; i++)
+		LoadWholePackage((*Job->Packages)[i]);
+}
+
+bool LoadWholePackages(const TArray<UnPackage*>& Packages, IProgressCallback* progress)
+{
+	guard(LoadWholePackages);
+
+	if (progress || GNumThreads <= 1)
+	{
+		// progress callback is not thread-safe, load packages sequentially
+		for (int i = 0; i < Packages.Num(); i++)
+		{
+			if (progress && !progress->Progress(Packages[i]->Name, i, Packages.Num()))
+				return false;
+			if (!LoadWholePackage(Packages[i], progress))
+				return false;
+		}
+		return true;
+	}
+
+	CLoadPackagesJob Job;
+	Job.Packages = &Packages;
+	// objects could import objects which are serialized by another thread, so call
+	// PostLoad() only when all packages are serialized
+	UObject::BeginDeferredPostLoad();
+#if DO_GUARD
+	TRY
+	{
+#endif
+		appParallelFor(Packages.Num(), 1, LoadPackagesWorker, &Job);
+#if DO_GUARD
+	}
+	CATCH
+	{
+		UObject::EndDeferredPostLoad(false);
+		THROW;
+	}
+#endif // DO_GUARD
+	UObject::EndDeferredPostLoad();
+	return true;
+
+	unguard;
+}
+
+
 void ReleaseAllObjects()
 {
 	guard(ReleaseAllObjects);
@@ -53,6 +115,9 @@ void ReleaseAllObjects()
 		delete UObject::GObjObjects[i];
 	UObject::GObjObjects.Empty();
 
+	// all objects were destroyed, release their memory at once
+	UnPackage::ReleaseAllObjectMem();
+
 	GFullyLoadedPackages.Empty();
 
 #if 0
@@ -74,6 +139,116 @@ void ReleaseAllObjects()
 }
 
 
+/*-----------------------------------------------------------------------------
+	Memory budget
+-----------------------------------------------------------------------------*/
+
+size_t GMemoryBudget = 0;
+
+void ReleasePackageObjects(UnPackage* Package)
+{
+	guard(ReleasePackageObjects);
+
+	TArray<UObject*>& Objects = UObject::GObjObjects;
+
+	// collect packages with loaded objects
+	TArray<UnPackage*> Loaded;
+	UnPackage* LastPackage = NULL;
+	for (int i = 0; i < Objects.Num(); i++)
+	{
+		UnPackage* p = Objects[i]->Package;
+		if (p && p != LastPackage && Loaded.FindItem(p) < 0)
+			Loaded.Add(p);
+		LastPackage = p;
+	}
+
+	// objects could reference objects of other packages only with imports, so release packages
+	// which imported anything from released packages too
+	TArray<UnPackage*> Released;
+	Released.Add(Package);
+	bool Changed = true;
+	while (Changed)
+	{
+		Changed = false;
+		for (int i = 0; i < Loaded.Num(); i++)
+		{
+			UnPackage* p = Loaded[i];
+			if (Released.FindItem(p) >= 0) continue;
+			for (int j = 0; j < p->LinkedPackages.Num(); j++)
+			{
+				if (Released.FindItem(p->LinkedPackages[j]) >= 0)
+				{
+					Released.Add(p);
+					Changed = true;
+					break;
+				}
+			}
+		}
+	}
+
+	UObject::LockObjects();
+	// move objects to release to the end of GObjObjects, so they'll be removed from the list
+	// quickly by UObject destructor
+	TArray<UObject*> Garbage;
+	int NumKept = 0;
+	for (int i = 0; i < Objects.Num(); i++)
+	{
+		UObject* Obj = Objects[i];
+		if (Obj->Package && Released.FindItem(Obj->Package) >= 0)
+			Garbage.Add(Obj);
+		else
+			Objects[NumKept++] = Obj;
+	}
+	for (int i = 0; i < Garbage.Num(); i++)
+		Objects[NumKept + i] = Garbage[i];
+	for (int i = Garbage.Num() - 1; i >= 0; i--)
+		delete Garbage[i];
+	assert(Objects.Num() == NumKept);
+
+	for (int i = 0; i < Released.Num(); i++)
+	{
+		UnPackage* p = Released[i];
+		p->ReleaseObjectMem();
+		GFullyLoadedPackages.RemoveSingle(p);
+	}
+	UObject::UnlockObjects();
+
+	// package reader holds file handle and buffers, it will be reopened when needed
+	for (int i = 0; i < Released.Num(); i++)
+	{
+		UnPackage* p = Released[i];
+		p->ReaderLock.Lock();
+		p->CloseReader();
+		p->ReaderLock.Unlock();
+	}
+
+	unguardf("%s", Package->Name);
+}
+
+
+void EnforceMemoryBudget()
+{
+	guard(EnforceMemoryBudget);
+
+	if (!GMemoryBudget) return;
+
+	// only memory which could be released with ReleasePackageObjects() is counted: objects and
+	// their serialized data are allocated in arenas of their packages; package headers, name
+	// pool etc are not released with objects
+	while (true)
+	{
+		UnPackage* Oldest;
+		size_t Size = UnPackage::GetAllObjectMemSize(Oldest);
+		if (Size <= GMemoryBudget || !Oldest) break;
+		appPrintf("Memory budget exceeded (" FORMAT_SIZE("d") " bytes used by objects), releasing package %s\n",
+			Size, Oldest->Name);
+		ReleasePackageObjects(Oldest);
+	}
+
+	unguard;
+}
+
+
 /*-----------------------------------------------------------------------------
 	Package scanner
 -----------------------------------------------------------------------------*/
@@ -84,12 +259,14 @@ struct ScanPackageData
 	:	Progress(NULL)
 	,	Cancelled(false)
 	,	Index(0)
+	,	NumRead(0)
 	{}
 
 	TArray<FileInfo>*	PkgInfo;
 	IProgressCallback*	Progress;
 	bool				Cancelled;
 	int					Index;
+	int					NumRead;			// number of packages with version which was not cached
 };
 
 static int InfoCmp(const FileInfo *p1, const FileInfo *p2)
@@ -112,42 +289,53 @@ static bool ScanPackage(const CGameFileInfo *file, ScanPackageData &data)
 		}
 	}
 
-	// read a few first bytes as integers
-	FArchive *Ar = appCreateFileReader(file);
-	unsigned int FileData[16];
-	Ar->Serialize(FileData, sizeof(FileData));
-	delete Ar;
-
-	unsigned Tag = FileData[0];
-	if (Tag == PACKAGE_FILE_TAG_REV)
-	{
-		// big-endian package
-		appReverseBytes(&FileData, ARRAY_COUNT(FileData), sizeof(FileData[0]));
-	}
-	else if (Tag != PACKAGE_FILE_TAG)	//?? possibly Lineage2 file etc
+	// package version could be already known from the game file cache
+	if (!file->PackageVer)
 	{
-		//!! Use CreatePackageLoader() here to allow scanning of packages with custom header (Lineage etc);
-		//!! do that only when something "strange" within data noticed.
-		//!! Also, this function could react on custom package tags.
-		return true;
-	}
-	unsigned int Version = FileData[1];
+		CGameFileInfo* info = const_cast<CGameFileInfo*>(file);
+		data.NumRead++;
 
-	FileInfo Info;
+		// read a few first bytes as integers
+		FArchive *Ar = appCreateFileReader(file);
+		unsigned int FileData[16];
+		Ar->Serialize(FileData, sizeof(FileData));
+		delete Ar;
+
+		unsigned Tag = FileData[0];
+		if (Tag == PACKAGE_FILE_TAG_REV)
+		{
+			// big-endian package
+			appReverseBytes(&FileData, ARRAY_COUNT(FileData), sizeof(FileData[0]));
+		}
+		else if (Tag != PACKAGE_FILE_TAG)	//?? possibly Lineage2 file etc
+		{
+			//!! Use CreatePackageLoader() here to allow scanning of packages with custom header (Lineage etc);
+			//!! do that only when something "strange" within data noticed.
+			//!! Also, this function could react on custom package tags.
+			info->PackageVer = -1;
+			return true;
+		}
+		unsigned int Version = FileData[1];
 
 #if UNREAL4
-	if ((Version & 0xFFFFF000) == 0xFFFFF000)
-	{
-		// next fields are: int VersionUE3, Version, LicenseeVersion
-		Info.Ver    = FileData[3];
-		Info.LicVer = FileData[4];
-	}
-	else
+		if ((Version & 0xFFFFF000) == 0xFFFFF000)
+		{
+			// next fields are: int VersionUE3, Version, LicenseeVersion
+			info->PackageVer    = FileData[3];
+			info->PackageLicVer = FileData[4];
+		}
+		else
 #endif // UNREAL4
-	{
-		Info.Ver    = Version & 0xFFFF;
-		Info.LicVer = Version >> 16;
+		{
+			info->PackageVer    = Version & 0xFFFF;
+			info->PackageLicVer = Version >> 16;
+		}
 	}
+	if (file->PackageVer < 0) return true;	// not a package
+
+	FileInfo Info;
+	Info.Ver    = file->PackageVer;
+	Info.LicVer = file->PackageLicVer;
 
 	Info.Count  = 0;
 	strcpy(Info.FileName, file->RelativeName);
@@ -191,6 +379,8 @@ bool ScanPackages(TArray<FileInfo>& info, IProgressCallback* progress)
 	data.Progress = progress;
 	appEnumGameFiles(ScanPackage, data);
 	info.Sort(InfoCmp);
+	if (data.NumRead)
+		appSaveGameFileCache();
 
 	return !data.Cancelled;
 }
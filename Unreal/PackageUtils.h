@@ -22,8 +22,20 @@ public:
 
 
 bool LoadWholePackage(UnPackage* Package, IProgressCallback* progress = NULL);
+// Load several packages. When threading is enabled and there's no progress callback, packages are
+// loaded in parallel; this works best for packages which are not referencing each other.
+bool LoadWholePackages(const TArray<UnPackage*>& Packages, IProgressCallback* progress = NULL);
 void ReleaseAllObjects();
 
+// Memory budget in bytes, 0 = unlimited
+extern size_t GMemoryBudget;
+// Destroy objects of the package, and objects of all packages which could reference them.
+// Objects will be loaded again when needed.
+void ReleasePackageObjects(UnPackage* Package);
+// Release objects of least recently used packages until memory used by loaded objects (their
+// package arenas) fits GMemoryBudget
+void EnforceMemoryBudget();
+
 
 // Package scanner
 
@@ -28,9 +28,10 @@ struct CBoneProxy
 };
 
 
-static CBoneProxy Bones[MAX_MESHBONES];		//!! rename or pass to SortBones()
-static CBoneProxy *SortedBones[MAX_MESHBONES];
-static int NumSortedBones;
+// per-thread data, because meshes could be loaded in parallel
+static THREAD_LOCAL CBoneProxy Bones[MAX_MESHBONES];		//!! rename or pass to SortBones()
+static THREAD_LOCAL CBoneProxy *SortedBones[MAX_MESHBONES];
+static THREAD_LOCAL int NumSortedBones;
 
 static void SortBoneArray(CBoneProxy *Parent, int NumBones)
 {
@@ -230,12 +231,11 @@ void CSkeletalMesh::FinalizeMesh()
 
 #define MAX_LINEAR_KEYS		4
 
-static int FindTimeKey(const TArray<float> &KeyTime, float Frame)
+static int FindTimeKey(const float *KeyTime, int NumKeys, float Frame)
 {
 	guard(FindTimeKey);
 
 	// find index in time key array
-	int NumKeys = KeyTime.Num();
 	// *** binary search ***
 	int Low = 0, High = NumKeys-1;
 	while (Low + MAX_LINEAR_KEYS < High)
@@ -264,14 +264,33 @@ static int FindTimeKey(const TArray<float> &KeyTime, float Frame)
 }
 
 
+// Same as above, but starts with the key used in previous call. Playback is usually going
+// forward in small steps, so the frame is in the same or in the next key interval.
+static int FindTimeKey(const float *KeyTime, int NumKeys, float Frame, int &Cursor)
+{
+	int i = Cursor;
+	if (i < NumKeys && KeyTime[i] <= Frame)
+	{
+		if (i + 1 >= NumKeys || Frame < KeyTime[i+1])
+			return i;
+		if (i + 2 >= NumKeys || Frame < KeyTime[i+2])
+		{
+			Cursor = i + 1;
+			return i + 1;
+		}
+	}
+	Cursor = FindTimeKey(KeyTime, NumKeys, Frame);
+	return Cursor;
+}
+
+
 // In:  KeyTime, Frame, NumFrames, Loop
 // Out: X - previous key index, Y - next key index, F - fraction between keys
-static void GetKeyParams(const TArray<float> &KeyTime, float Frame, float NumFrames, bool Loop, int &X, int &Y, float &F)
+static void GetKeyParams(const float *KeyTime, int NumTimeKeys, float Frame, float NumFrames, bool Loop, int &X, int &Y, float &F, int *Cursor)
 {
 	guard(GetKeyParams);
-	X = FindTimeKey(KeyTime, Frame);
+	X = Cursor ? FindTimeKey(KeyTime, NumTimeKeys, Frame, *Cursor) : FindTimeKey(KeyTime, NumTimeKeys, Frame);
 	Y = X + 1;
-	int NumTimeKeys = KeyTime.Num();
 	if (Y >= NumTimeKeys)
 	{
 		if (!Loop)
@@ -297,15 +316,15 @@ static void GetKeyParams(const TArray<float> &KeyTime, float Frame, float NumFra
 
 
 // not 'static', because used in ExportPsa()
-void CAnimTrack::GetBonePosition(float Frame, float NumFrames, bool Loop, CVec3 &DstPos, CQuat &DstQuat) const
+void CAnimTrackView::GetBonePosition(float Frame, float NumFrames, bool Loop, CVec3 &DstPos, CQuat &DstQuat, CAnimTrackCursor *Cursor) const
 {
-	guard(CAnimTrack::GetBonePosition);
+	guard(CAnimTrackView::GetBonePosition);
 
 	// fast case: 1 frame only
-	if (KeyTime.Num() == 1 || NumFrames == 1 || Frame == 0)
+	if (NumTimeKeys == 1 || NumFrames == 1 || Frame == 0)
 	{
-		if (KeyPos.Num())  DstPos  = KeyPos[0];
-		if (KeyQuat.Num()) DstQuat = KeyQuat[0];
+		if (NumPosKeys)  DstPos  = KeyPos[0];
+		if (NumQuatKeys) DstQuat = KeyQuat[0];
 		return;
 	}
 
@@ -314,9 +333,7 @@ void CAnimTrack::GetBonePosition(float Frame, float NumFrames, bool Loop, CVec3
 	int posY, rotY;			// index of next frame
 	float posF, rotF;		// fraction between X and Y for lerping
 
-	int NumTimeKeys = KeyTime.Num();
-	int NumPosKeys  = KeyPos.Num();
-	int NumRotKeys  = KeyQuat.Num();
+	int NumRotKeys = NumQuatKeys;
 
 	if (NumTimeKeys)
 	{
@@ -324,7 +341,7 @@ void CAnimTrack::GetBonePosition(float Frame, float NumFrames, bool Loop, CVec3
 		assert(NumPosKeys <= 1 || NumPosKeys == NumTimeKeys);
 		assert(NumRotKeys == 1 || NumRotKeys == NumTimeKeys);
 
-		GetKeyParams(KeyTime, Frame, NumFrames, Loop, posX, posY, posF);
+		GetKeyParams(KeyTime, NumTimeKeys, Frame, NumFrames, Loop, posX, posY, posF, Cursor ? &Cursor->PosKey : NULL);
 		rotX = posX;
 		rotY = posY;
 		rotF = posF;
@@ -344,9 +361,9 @@ void CAnimTrack::GetBonePosition(float Frame, float NumFrames, bool Loop, CVec3
 	{
 		// empty KeyTime array - keys are evenly spaced on a time line
 		// note: KeyPos and KeyQuat sizes can be different
-		if (KeyPosTime.Num())
+		if (NumPosTimeKeys)
 		{
-			GetKeyParams(KeyPosTime, Frame, NumFrames, Loop, posX, posY, posF);
+			GetKeyParams(KeyPosTime, NumPosTimeKeys, Frame, NumFrames, Loop, posX, posY, posF, Cursor ? &Cursor->PosKey : NULL);
 		}
 		else if (NumPosKeys > 1)
 		{
@@ -371,9 +388,9 @@ void CAnimTrack::GetBonePosition(float Frame, float NumFrames, bool Loop, CVec3
 			posF = 0;
 		}
 
-		if (KeyQuatTime.Num())
+		if (NumQuatTimeKeys)
 		{
-			GetKeyParams(KeyQuatTime, Frame, NumFrames, Loop, rotX, rotY, rotF);
+			GetKeyParams(KeyQuatTime, NumQuatTimeKeys, Frame, NumFrames, Loop, rotX, rotY, rotF, Cursor ? &Cursor->RotKey : NULL);
 		}
 		else if (NumRotKeys > 1)
 		{
@@ -422,3 +439,117 @@ void CAnimTrack::CopyFrom(const CAnimTrack &Src)
 	CopyArray(KeyQuatTime, Src.KeyQuatTime);
 	CopyArray(KeyPosTime,  Src.KeyPosTime );
 }
+
+
+// Time arrays of neighbour tracks are often identical (the same keys are used for all bones,
+// or for rotation and translation of the same bone), so compare with a few recently stored arrays.
+#define NUM_RECENT_TIME_ARRAYS	4
+
+struct CTimeArrayCache
+{
+	const TArray<float>		*Arrays[NUM_RECENT_TIME_ARRAYS];
+	int						Offsets[NUM_RECENT_TIME_ARRAYS];
+	int						Next;
+	int						TotalKeys;
+
+	CTimeArrayCache()
+	{
+		memset(this, 0, sizeof(*this));
+	}
+
+	// Returns offset of the array in the time key section
+	int Find(const TArray<float> &Times)
+	{
+		int Count = Times.Num();
+		if (!Count) return 0;
+		for (int i = 0; i < NUM_RECENT_TIME_ARRAYS; i++)
+		{
+			const TArray<float> *A = Arrays[i];
+			if (A && A->Num() == Count && !memcmp(A->GetData(), Times.GetData(), Count * sizeof(float)))
+				return Offsets[i];
+		}
+		// new time array
+		int Offset = TotalKeys;
+		TotalKeys += Count;
+		Arrays[Next]  = &Times;
+		Offsets[Next] = Offset;
+		Next = (Next + 1) % NUM_RECENT_TIME_ARRAYS;
+		return Offset;
+	}
+};
+
+
+void CAnimSequence::PackTracks()
+{
+	guard(CAnimSequence::PackTracks);
+
+	assert(KeyData == NULL);
+
+	int NumTracks = Tracks.Num();
+	TrackKeys.Empty(NumTracks);
+	TrackKeys.AddUninitialized(NumTracks);
+
+	// compute layout of the key block
+	int TotalQuatKeys = 0, TotalPosKeys = 0;
+	CTimeArrayCache TimeCache;
+	int i;
+	for (i = 0; i < NumTracks; i++)
+	{
+		const CAnimTrack &Src = Tracks[i];
+		CAnimTrackKeys &T = TrackKeys[i];
+		T.QuatOffset      = TotalQuatKeys;
+		T.NumQuatKeys     = Src.KeyQuat.Num();
+		T.PosOffset       = TotalPosKeys;
+		T.NumPosKeys      = Src.KeyPos.Num();
+		T.TimeOffset      = TimeCache.Find(Src.KeyTime);
+		T.NumTimeKeys     = Src.KeyTime.Num();
+		T.QuatTimeOffset  = TimeCache.Find(Src.KeyQuatTime);
+		T.NumQuatTimeKeys = Src.KeyQuatTime.Num();
+		T.PosTimeOffset   = TimeCache.Find(Src.KeyPosTime);
+		T.NumPosTimeKeys  = Src.KeyPosTime.Num();
+		TotalQuatKeys += T.NumQuatKeys;
+		TotalPosKeys  += T.NumPosKeys;
+	}
+
+	// allocate the block; quaternions are placed first for alignment
+	int QuatSize = TotalQuatKeys * sizeof(CQuat);
+	int PosSize  = TotalPosKeys * sizeof(CVec3);
+	int TimeSize = TimeCache.TotalKeys * sizeof(float);
+	KeyData = appMalloc(max(QuatSize + PosSize + TimeSize, 1), 16);
+	KeyQuat = (CQuat*)KeyData;
+	KeyPos  = (CVec3*)OffsetPointer(KeyData, QuatSize);
+	KeyTime = (float*)OffsetPointer(KeyData, QuatSize + PosSize);
+
+	// copy keys; time arrays are copied as many times as they were referenced, but
+	// duplicates are written to the same location
+	for (i = 0; i < NumTracks; i++)
+	{
+		const CAnimTrack &Src = Tracks[i];
+		const CAnimTrackKeys &T = TrackKeys[i];
+		if (T.NumQuatKeys)     memcpy(KeyQuat + T.QuatOffset,     Src.KeyQuat.GetData(),     T.NumQuatKeys * sizeof(CQuat));
+		if (T.NumPosKeys)      memcpy(KeyPos  + T.PosOffset,      Src.KeyPos.GetData(),      T.NumPosKeys * sizeof(CVec3));
+		if (T.NumTimeKeys)     memcpy(KeyTime + T.TimeOffset,     Src.KeyTime.GetData(),     T.NumTimeKeys * sizeof(float));
+		if (T.NumQuatTimeKeys) memcpy(KeyTime + T.QuatTimeOffset, Src.KeyQuatTime.GetData(), T.NumQuatTimeKeys * sizeof(float));
+		if (T.NumPosTimeKeys)  memcpy(KeyTime + T.PosTimeOffset,  Src.KeyPosTime.GetData(),  T.NumPosTimeKeys * sizeof(float));
+	}
+
+	Tracks.Empty();
+
+	unguard;
+}
+
+
+void CAnimSequence::GetPose(float Frame, bool Loop, int Count, const int *TrackIndices, CVec3 *DstPos, CQuat *DstQuat,
+	CAnimTrackCursor *Cursors) const
+{
+	guard(CAnimSequence::GetPose);
+
+	for (int i = 0; i < Count; i++)
+	{
+		int Track = TrackIndices[i];
+		if (Track < 0) continue;
+		GetTrack(Track).GetBonePosition(Frame, NumFrames, Loop, DstPos[i], DstQuat[i], Cursors ? Cursors + Track : NULL);
+	}
+
+	unguard;
+}
@@ -185,12 +185,17 @@ private:
 	  - UAnimSequence is always has at least one key for excluded bone (there is no empty arrays)
 */
 
-/*!!
-	Warning: very unoptimal data format. Each CAnimSequence has NumBones CAnimTrack's, each CAnimTrack has up to 5 arrays.
-	Ideally should put all the data into CAnimSequence as a single data block (like was done for UAnimSequence).
+/*
+	Animation data layout:
+	- animation converters are filling CAnimSequence.Tracks, one CAnimTrack per bone, and then
+	  calling CAnimSequence::PackTracks()
+	- PackTracks() moves keys of all tracks into a single memory block, and releases Tracks; the
+	  block holds all rotation keys, then all position keys, then all time keys
+	- identical time arrays are stored only once
+	- packed tracks are accessed with CAnimSequence::GetTrack(), which returns CAnimTrackView
 */
 
-
+// Track used while converting animation to CAnimSequence
 struct CAnimTrack
 {
 	TArray<CQuat>			KeyQuat;
@@ -201,8 +206,6 @@ struct CAnimTrack
 	TArray<float>			KeyQuatTime;
 	TArray<float>			KeyPosTime;
 
-	// DstPos and DstQuat will not be changed when KeyPos and KeyQuat are empty
-	void GetBonePosition(float Frame, float NumFrames, bool Loop, CVec3 &DstPos, CQuat &DstQuat) const;
 	inline bool HasKeys() const
 	{
 		return (KeyQuat.Num() + KeyPos.Num()) > 0;
@@ -211,16 +214,113 @@ struct CAnimTrack
 };
 
 
+// Last used key indices of the track. When animation is played forward, next lookup starts
+// from these keys instead of searching the whole time array. Zero-initialized cursor is valid.
+struct CAnimTrackCursor
+{
+	int						PosKey;					// index in KeyTime or KeyPosTime
+	int						RotKey;					// index in KeyQuatTime
+};
+
+
+// Read-only view of a packed track. Has the same meaning of fields as CAnimTrack.
+struct CAnimTrackView
+{
+	const CQuat				*KeyQuat;
+	const CVec3				*KeyPos;
+	const float				*KeyTime;
+	const float				*KeyQuatTime;
+	const float				*KeyPosTime;
+	int						NumQuatKeys;
+	int						NumPosKeys;
+	int						NumTimeKeys;
+	int						NumQuatTimeKeys;
+	int						NumPosTimeKeys;
+
+	// DstPos and DstQuat will not be changed when KeyPos and KeyQuat are empty; Cursor is optional
+	void GetBonePosition(float Frame, float NumFrames, bool Loop, CVec3 &DstPos, CQuat &DstQuat, CAnimTrackCursor *Cursor = NULL) const;
+	inline bool HasKeys() const
+	{
+		return (NumQuatKeys + NumPosKeys) > 0;
+	}
+};
+
+
+// Location of track keys inside CAnimSequence's key block; offsets are measured in items
+// from the start of the corresponding key section
+struct CAnimTrackKeys
+{
+	int						QuatOffset;
+	int						NumQuatKeys;
+	int						PosOffset;
+	int						NumPosKeys;
+	int						TimeOffset;
+	int						NumTimeKeys;
+	int						QuatTimeOffset;
+	int						NumQuatTimeKeys;
+	int						PosTimeOffset;
+	int						NumPosTimeKeys;
+};
+
+
 class CAnimSequence
 {
 public:
 	FName					Name;					// sequence's name
 	int						NumFrames;
 	float					Rate;
-	TArray<CAnimTrack>		Tracks;					// for each CAnimSet.TrackBoneNames
+	TArray<CAnimTrack>		Tracks;					// for each CAnimSet.TrackBoneNames; empty after PackTracks()
 #if ANIM_DEBUG_INFO
 	FString					DebugInfo;
 #endif
+
+	CAnimSequence()
+	:	KeyData(NULL)
+	,	KeyQuat(NULL)
+	,	KeyPos(NULL)
+	,	KeyTime(NULL)
+	{}
+	~CAnimSequence()
+	{
+		if (KeyData) appFree(KeyData);
+	}
+
+	// Move data from Tracks to the key block
+	void PackTracks();
+
+	// Compute positions of 'Count' bones at once. TrackIndices[i] is a track used for i-th bone,
+	// bones with negative index are skipped. DstPos and DstQuat are not changed for bones without
+	// keys. Cursors is NULL, or points to NumTracks() items.
+	void GetPose(float Frame, bool Loop, int Count, const int *TrackIndices, CVec3 *DstPos, CQuat *DstQuat,
+		CAnimTrackCursor *Cursors = NULL) const;
+
+	inline int NumTracks() const
+	{
+		return TrackKeys.Num();
+	}
+	inline CAnimTrackView GetTrack(int Index) const
+	{
+		const CAnimTrackKeys &T = TrackKeys[Index];
+		CAnimTrackView View;
+		View.KeyQuat         = KeyQuat + T.QuatOffset;
+		View.KeyPos          = KeyPos  + T.PosOffset;
+		View.KeyTime         = KeyTime + T.TimeOffset;
+		View.KeyQuatTime     = KeyTime + T.QuatTimeOffset;
+		View.KeyPosTime      = KeyTime + T.PosTimeOffset;
+		View.NumQuatKeys     = T.NumQuatKeys;
+		View.NumPosKeys      = T.NumPosKeys;
+		View.NumTimeKeys     = T.NumTimeKeys;
+		View.NumQuatTimeKeys = T.NumQuatTimeKeys;
+		View.NumPosTimeKeys  = T.NumPosTimeKeys;
+		return View;
+	}
+
+protected:
+	TArray<CAnimTrackKeys>	TrackKeys;
+	void					*KeyData;				// single allocation for all keys
+	CQuat					*KeyQuat;				// pointers to key sections inside KeyData
+	CVec3					*KeyPos;
+	float					*KeyTime;
 };
 
 
@@ -64,6 +64,7 @@ void UMeshAnimation::ConvertAnims()
 					T.KeyTime[k] *= TimeScale;
 			}
 		}
+		S.PackTracks();
 	}
 
 	unguard;
@@ -424,7 +425,7 @@ void AnalogTrack::SerializeSWRC(FArchive &Ar)
 	int NumKeys, i;
 	NumKeys = TimeTrack.Num();
 	KeyTime.Empty(NumKeys);
-	KeyTime.AddUninitialized(NumKeys);
+	KeyTime.AddNoInit(NumKeys);
 	int Time = 0;
 	for (i = 0; i < NumKeys; i++)
 	{
@@ -435,7 +436,7 @@ void AnalogTrack::SerializeSWRC(FArchive &Ar)
 	// rotation track
 	NumKeys = RotTrack.Num();
 	KeyQuat.Empty(NumKeys);
-	KeyQuat.AddUninitialized(NumKeys);
+	KeyQuat.AddNoInit(NumKeys);
 	for (i = 0; i < NumKeys; i++)
 	{
 		FQuat Q;
@@ -451,7 +452,7 @@ void AnalogTrack::SerializeSWRC(FArchive &Ar)
 	// translation track
 	NumKeys = PosTrack.Num();
 	KeyPos.Empty(NumKeys);
-	KeyPos.AddUninitialized(NumKeys);
+	KeyPos.AddNoInit(NumKeys);
 	for (i = 0; i < NumKeys; i++)
 		KeyPos[i] = PosTrack[i].ToFVector(PosScale);
 
@@ -59,6 +59,379 @@
 					break;
 
 
+/*-----------------------------------------------------------------------------
+	Batched key decoding
+-----------------------------------------------------------------------------*/
+
+// Most common key formats are decoded for the whole track at once: keys are taken directly
+// from the compressed stream, 4 keys at time, unpacked and scaled with SSE2 and written into
+// the destination array. Other formats (including game-specific ones) are decoded by the
+// per-key code in ConvertAnims().
+
+#define USE_SSE2			1
+
+#if USE_SSE2
+
+#include <emmintrin.h>
+
+struct CKeyDecodeParams
+{
+	__m128		Mins[3];
+	__m128		Ranges[3];
+	__m128		Scale;					// additional scale for translation keys
+	bool		Swap;					// data has big-endian byte order
+};
+
+static FORCEINLINE __m128i SwapBytes16(__m128i v)
+{
+	return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+
+static FORCEINLINE __m128i SwapBytes32(__m128i v)
+{
+	v = SwapBytes16(v);
+	return _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(2,3,0,1)), _MM_SHUFFLE(2,3,0,1));
+}
+
+static FORCEINLINE __m128i LoadDwords(const byte *Src, bool Swap)
+{
+	__m128i v = _mm_loadu_si128((const __m128i*)Src);
+	return Swap ? SwapBytes32(v) : v;
+}
+
+// Convert 3 vectors holding 4 consecutive XYZ items into separate X, Y and Z vectors
+static FORCEINLINE void Deinterleave3(__m128 a, __m128 b, __m128 c, __m128 &x, __m128 &y, __m128 &z)
+{
+	// a = x0 y0 z0 x1, b = y1 z1 x2 y2, c = z2 x3 y3 z3
+	__m128 bc = _mm_shuffle_ps(b, c, _MM_SHUFFLE(1,0,3,2));		// x2 y2 z2 x3
+	x = _mm_shuffle_ps(a, bc, _MM_SHUFFLE(3,0,3,0));
+	y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0,0,1,1)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(2,2,3,3)), _MM_SHUFFLE(2,0,2,0));
+	z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1,1,2,2)), _mm_shuffle_ps(c, c, _MM_SHUFFLE(3,3,0,0)), _MM_SHUFFLE(2,0,2,0));
+}
+
+// Load 4 keys consisting of 3 16-bit values, and expand values to 32 bits
+static FORCEINLINE void LoadWords3(const byte *Src, bool Swap, __m128i &x, __m128i &y, __m128i &z)
+{
+	__m128i lo = _mm_loadu_si128((const __m128i*)Src);
+	__m128i hi = _mm_loadl_epi64((const __m128i*)(Src + 16));
+	if (Swap)
+	{
+		lo = SwapBytes16(lo);
+		hi = SwapBytes16(hi);
+	}
+	__m128i zero = _mm_setzero_si128();
+	__m128 a = _mm_castsi128_ps(_mm_unpacklo_epi16(lo, zero));
+	__m128 b = _mm_castsi128_ps(_mm_unpackhi_epi16(lo, zero));
+	__m128 c = _mm_castsi128_ps(_mm_unpacklo_epi16(hi, zero));
+	__m128 fx, fy, fz;
+	Deinterleave3(a, b, c, fx, fy, fz);
+	x = _mm_castps_si128(fx);
+	y = _mm_castps_si128(fy);
+	z = _mm_castps_si128(fz);
+}
+
+// Compute W for 4 normalized quaternions, see RESTORE_QUAT_W()
+static FORCEINLINE void StoreQuats(CQuat *Dst, __m128 x, __m128 y, __m128 z)
+{
+	__m128 wSq = _mm_sub_ps(_mm_set1_ps(1.0f), _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+	__m128 w = _mm_sqrt_ps(_mm_max_ps(wSq, _mm_setzero_ps()));
+	_MM_TRANSPOSE4_PS(x, y, z, w);
+	_mm_storeu_ps(&Dst[0].x, x);
+	_mm_storeu_ps(&Dst[1].x, y);
+	_mm_storeu_ps(&Dst[2].x, z);
+	_mm_storeu_ps(&Dst[3].x, w);
+}
+
+static FORCEINLINE void StoreVectors(CVec3 *Dst, __m128 x, __m128 y, __m128 z)
+{
+	__m128 w = _mm_setzero_ps();
+	_MM_TRANSPOSE4_PS(x, y, z, w);
+	// rows are overlapping, each one overwrites 4th float of the previous row
+	_mm_storeu_ps(Dst[0].v, x);
+	_mm_storeu_ps(Dst[1].v, y);
+	_mm_storeu_ps(Dst[2].v, z);
+	_mm_storel_pi((__m64*)Dst[3].v, w);
+	_mm_store_ss(Dst[3].v + 2, _mm_movehl_ps(w, w));
+}
+
+// Fixed-point value to float: (Value - Bias) / Divisor
+static FORCEINLINE __m128 FixedToFloat(__m128i Value, int Bias, float Divisor)
+{
+	return _mm_div_ps(_mm_cvtepi32_ps(_mm_sub_epi32(Value, _mm_set1_epi32(Bias))), _mm_set1_ps(Divisor));
+}
+
+// Fixed-point value with interval: (Value / Divisor - 1) * Range + Min
+static FORCEINLINE __m128 IntervalToFloat(__m128i Value, float Divisor, __m128 Min, __m128 Range)
+{
+	__m128 v = _mm_sub_ps(_mm_div_ps(_mm_cvtepi32_ps(Value), _mm_set1_ps(Divisor)), _mm_set1_ps(1.0f));
+	return _mm_add_ps(_mm_mul_ps(v, Range), Min);
+}
+
+
+// Decoders for 4 keys
+
+struct CDecodeQuatNone
+{
+	enum { KeySize = 16 };
+	static FORCEINLINE void Decode(const byte *Src, CQuat *Dst, const CKeyDecodeParams &P)
+	{
+		for (int i = 0; i < 4; i++)
+			_mm_storeu_si128((__m128i*)&Dst[i].x, LoadDwords(Src + i * 16, P.Swap));
+	}
+};
+
+struct CDecodeQuatFloat96NoW
+{
+	enum { KeySize = 12 };
+	static FORCEINLINE void Decode(const byte *Src, CQuat *Dst, const CKeyDecodeParams &P)
+	{
+		__m128 x, y, z;
+		Deinterleave3(_mm_castsi128_ps(LoadDwords(Src, P.Swap)), _mm_castsi128_ps(LoadDwords(Src + 16, P.Swap)),
+			_mm_castsi128_ps(LoadDwords(Src + 32, P.Swap)), x, y, z);
+		StoreQuats(Dst, x, y, z);
+	}
+};
+
+struct CDecodeQuatFixed48NoW
+{
+	enum { KeySize = 6 };
+	static FORCEINLINE void Decode(const byte *Src, CQuat *Dst, const CKeyDecodeParams &P)
+	{
+		__m128i x, y, z;
+		LoadWords3(Src, P.Swap, x, y, z);
+		StoreQuats(Dst, FixedToFloat(x, 32767, 32767.0f), FixedToFloat(y, 32767, 32767.0f), FixedToFloat(z, 32767, 32767.0f));
+	}
+};
+
+// layout: Z:10, Y:11, X:11
+struct CDecodeQuatFixed32NoW
+{
+	enum { KeySize = 4 };
+	static FORCEINLINE void Decode(const byte *Src, CQuat *Dst, const CKeyDecodeParams &P)
+	{
+		__m128i v = LoadDwords(Src, P.Swap);
+		__m128i x = _mm_srli_epi32(v, 21);
+		__m128i y = _mm_and_si128(_mm_srli_epi32(v, 10), _mm_set1_epi32(0x7FF));
+		__m128i z = _mm_and_si128(v, _mm_set1_epi32(0x3FF));
+		__m128 one = _mm_set1_ps(1.0f);
+		StoreQuats(Dst,
+			_mm_sub_ps(_mm_div_ps(_mm_cvtepi32_ps(x), _mm_set1_ps(1023.0f)), one),
+			_mm_sub_ps(_mm_div_ps(_mm_cvtepi32_ps(y), _mm_set1_ps(1023.0f)), one),
+			_mm_sub_ps(_mm_div_ps(_mm_cvtepi32_ps(z), _mm_set1_ps(511.0f)),  one));
+	}
+};
+
+struct CDecodeQuatIntervalFixed32NoW
+{
+	enum { KeySize = 4 };
+	static FORCEINLINE void Decode(const byte *Src, CQuat *Dst, const CKeyDecodeParams &P)
+	{
+		__m128i v = LoadDwords(Src, P.Swap);
+		__m128i x = _mm_srli_epi32(v, 21);
+		__m128i y = _mm_and_si128(_mm_srli_epi32(v, 10), _mm_set1_epi32(0x7FF));
+		__m128i z = _mm_and_si128(v, _mm_set1_epi32(0x3FF));
+		StoreQuats(Dst,
+			IntervalToFloat(x, 1023.0f, P.Mins[0], P.Ranges[0]),
+			IntervalToFloat(y, 1023.0f, P.Mins[1], P.Ranges[1]),
+			IntervalToFloat(z, 511.0f,  P.Mins[2], P.Ranges[2]));
+	}
+};
+
+// See FQuatFloat32NoW: values are floats with 3-bit exponent and 7 (6 for Z) bit mantissa
+struct CDecodeQuatFloat32NoW
+{
+	enum { KeySize = 4 };
+	static FORCEINLINE __m128 Unpack(__m128i v, int MantissaBits)
+	{
+		__m128i Exp  = _mm_add_epi32(_mm_and_si128(_mm_srli_epi32(v, MantissaBits), _mm_set1_epi32(7)), _mm_set1_epi32(123));
+		__m128i Mant = _mm_and_si128(v, _mm_set1_epi32((1 << MantissaBits) - 1));
+		__m128i Sign = _mm_and_si128(v, _mm_set1_epi32(1 << (MantissaBits + 3)));
+		__m128i r = _mm_or_si128(_mm_slli_epi32(Exp, 23), _mm_slli_epi32(Mant, 23 - MantissaBits));
+		r = _mm_or_si128(r, _mm_slli_epi32(Sign, 31 - MantissaBits - 3));
+		return _mm_castsi128_ps(r);
+	}
+	static FORCEINLINE void Decode(const byte *Src, CQuat *Dst, const CKeyDecodeParams &P)
+	{
+		__m128i v = LoadDwords(Src, P.Swap);
+		__m128i x = _mm_srli_epi32(v, 21);
+		__m128i y = _mm_and_si128(_mm_srli_epi32(v, 10), _mm_set1_epi32(0x7FF));
+		__m128i z = _mm_and_si128(v, _mm_set1_epi32(0x3FF));
+		StoreQuats(Dst, Unpack(x, 7), Unpack(y, 7), Unpack(z, 6));
+	}
+};
+
+struct CDecodeVectorFloat96
+{
+	enum { KeySize = 12 };
+	static FORCEINLINE void Decode(const byte *Src, CVec3 *Dst, const CKeyDecodeParams &P)
+	{
+		// same layout as CVec3
+		for (int i = 0; i < 3; i++)
+			_mm_storeu_si128((__m128i*)Dst + i, LoadDwords(Src + i * 16, P.Swap));
+	}
+};
+
+struct CDecodeVectorFixed48
+{
+	enum { KeySize = 6 };
+	static FORCEINLINE void Decode(const byte *Src, CVec3 *Dst, const CKeyDecodeParams &P)
+	{
+		__m128i x, y, z;
+		LoadWords3(Src, P.Swap, x, y, z);
+		__m128i Bias = _mm_set1_epi32(32767);
+		__m128 Scale = _mm_set1_ps(128.0f / 32767.0f);
+		StoreVectors(Dst,
+			_mm_mul_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_sub_epi32(x, Bias)), Scale), P.Scale),
+			_mm_mul_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_sub_epi32(y, Bias)), Scale), P.Scale),
+			_mm_mul_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_sub_epi32(z, Bias)), Scale), P.Scale));
+	}
+};
+
+// layout: X:10, Y:11, Z:11
+struct CDecodeVectorIntervalFixed32
+{
+	enum { KeySize = 4 };
+	static FORCEINLINE void Decode(const byte *Src, CVec3 *Dst, const CKeyDecodeParams &P)
+	{
+		__m128i v = LoadDwords(Src, P.Swap);
+		__m128i x = _mm_and_si128(v, _mm_set1_epi32(0x3FF));
+		__m128i y = _mm_and_si128(_mm_srli_epi32(v, 10), _mm_set1_epi32(0x7FF));
+		__m128i z = _mm_srli_epi32(v, 21);
+		StoreVectors(Dst,
+			IntervalToFloat(x, 511.0f,  P.Mins[0], P.Ranges[0]),
+			IntervalToFloat(y, 1023.0f, P.Mins[1], P.Ranges[1]),
+			IntervalToFloat(z, 1023.0f, P.Mins[2], P.Ranges[2]));
+	}
+};
+
+
+template<class Decoder, class KeyType>
+static void DecodeKeys(const byte *Src, int NumKeys, KeyType *Dst, const CKeyDecodeParams &P)
+{
+	int i;
+	for (i = 0; i + 4 <= NumKeys; i += 4, Src += Decoder::KeySize * 4, Dst += 4)
+		Decoder::Decode(Src, Dst, P);
+	// last keys are decoded from zero-padded buffer
+	int Remaining = NumKeys - i;
+	if (Remaining)
+	{
+		byte Tmp[Decoder::KeySize * 4];
+		KeyType Out[4];
+		memset(Tmp, 0, sizeof(Tmp));
+		memcpy(Tmp, Src, Remaining * Decoder::KeySize);
+		Decoder::Decode(Tmp, Out, P);
+		memcpy(Dst, Out, Remaining * sizeof(KeyType));
+	}
+}
+
+static void SetupDecodeParams(CKeyDecodeParams &P, const FArchive &Ar, const FVector &Mins, const FVector &Ranges, float Scale)
+{
+	P.Mins[0]   = _mm_set1_ps(Mins.X);
+	P.Mins[1]   = _mm_set1_ps(Mins.Y);
+	P.Mins[2]   = _mm_set1_ps(Mins.Z);
+	P.Ranges[0] = _mm_set1_ps(Ranges.X);
+	P.Ranges[1] = _mm_set1_ps(Ranges.Y);
+	P.Ranges[2] = _mm_set1_ps(Ranges.Z);
+	P.Scale     = _mm_set1_ps(Scale);
+	P.Swap      = Ar.ReverseBytes;
+}
+
+// Verify that 'Size' bytes could be read from the current position of archive which
+// holds 'Data', and return pointer to them. Reader position is moved after these bytes.
+static const byte *GetKeyData(FArchive &Reader, const TArray<byte> &Data, int Size)
+{
+	int Pos = Reader.Tell();
+	if (Pos + Size > Data.Num())
+		appError("Serializing behind end of buffer");
+	Reader.Seek(Pos + Size);
+	return Data.GetData() + Pos;
+}
+
+#endif // USE_SSE2
+
+
+// Decode all rotation keys of the track. Returns number of decoded keys: NumKeys, or 0 when
+// the format is not supported here, and keys should be decoded one by one.
+static int DecodeRotationKeys(FArchive &Reader, const TArray<byte> &Data, int Format, int NumKeys,
+	const FVector &Mins, const FVector &Ranges, TArray<CQuat> &Dst)
+{
+#if USE_SSE2
+	guard(DecodeRotationKeys);
+
+	void (*Func)(const byte*, int, CQuat*, const CKeyDecodeParams&);
+	int KeySize;
+#define DECODER(Enum, Type)						\
+	case Enum:									\
+		Func    = DecodeKeys<Type, CQuat>;		\
+		KeySize = Type::KeySize;				\
+		break;
+	switch (Format)
+	{
+	DECODER(ACF_None,               CDecodeQuatNone)
+	DECODER(ACF_Float96NoW,         CDecodeQuatFloat96NoW)
+	DECODER(ACF_Fixed48NoW,         CDecodeQuatFixed48NoW)
+	DECODER(ACF_Fixed32NoW,         CDecodeQuatFixed32NoW)
+	DECODER(ACF_IntervalFixed32NoW, CDecodeQuatIntervalFixed32NoW)
+	DECODER(ACF_Float32NoW,         CDecodeQuatFloat32NoW)
+	default:
+		return 0;
+	}
+#undef DECODER
+
+	CKeyDecodeParams P;
+	SetupDecodeParams(P, Reader, Mins, Ranges, 1.0f);
+	const byte *Src = GetKeyData(Reader, Data, NumKeys * KeySize);
+	int Index = Dst.AddNoInit(NumKeys);
+	Func(Src, NumKeys, Dst.GetData() + Index, P);
+	return NumKeys;
+
+	unguard;
+#else
+	return 0;
+#endif // USE_SSE2
+}
+
+
+// Decode all translation keys of the track, works like DecodeRotationKeys(). Scale is
+// applied to ACF_Fixed48NoW keys.
+static int DecodeTranslationKeys(FArchive &Reader, const TArray<byte> &Data, int Format, int NumKeys,
+	const FVector &Mins, const FVector &Ranges, float Scale, TArray<CVec3> &Dst)
+{
+#if USE_SSE2
+	guard(DecodeTranslationKeys);
+
+	void (*Func)(const byte*, int, CVec3*, const CKeyDecodeParams&);
+	int KeySize;
+#define DECODER(Enum, Type)						\
+	case Enum:									\
+		Func    = DecodeKeys<Type, CVec3>;		\
+		KeySize = Type::KeySize;				\
+		break;
+	switch (Format)
+	{
+	DECODER(ACF_None,               CDecodeVectorFloat96)
+	DECODER(ACF_Float96NoW,         CDecodeVectorFloat96)
+	DECODER(ACF_Fixed48NoW,         CDecodeVectorFixed48)
+	DECODER(ACF_IntervalFixed32NoW, CDecodeVectorIntervalFixed32)
+	default:
+		return 0;
+	}
+#undef DECODER
+
+	CKeyDecodeParams P;
+	SetupDecodeParams(P, Reader, Mins, Ranges, Scale);
+	const byte *Src = GetKeyData(Reader, Data, NumKeys * KeySize);
+	int Index = Dst.AddNoInit(NumKeys);
+	Func(Src, NumKeys, Dst.GetData() + Index, P);
+	return NumKeys;
+
+	unguard;
+#else
+	return 0;
+#endif // USE_SSE2
+}
+
+
 UAnimSet::~UAnimSet()
 {
 	delete ConvertedAnim;
@@ -640,6 +1013,7 @@ void UAnimSet::ConvertAnims()
 			Dst->NumFrames = Seq->NumFrames;
 			Dst->Rate      = Seq->NumFrames / Seq->SequenceLength * Seq->RateScale;
 			Seq->DecodeTrans3Anims(Dst, this);
+			Dst->PackTracks();
 			continue;
 		}
 #endif // TRANSFORMERS
@@ -659,6 +1033,7 @@ void UAnimSet::ConvertAnims()
 			Dst->NumFrames = Seq->NumFrames;
 			Dst->Rate      = Seq->NumFrames / Seq->SequenceLength * Seq->RateScale;
 			Seq->DecodeBatman2Anims(Dst, this);
+			Dst->PackTracks();
 			continue;
 		}
 #endif // BATMAN
@@ -765,7 +1140,11 @@ void UAnimSet::ConvertAnims()
 						if (ComponentMask & 2) Reader << Mins.Y << Ranges.Y;
 						if (ComponentMask & 4) Reader << Mins.Z << Ranges.Z;
 					}
-					for (k = 0; k < NumKeys; k++)
+					// batched decoder requires all vector components to be stored
+					k = 0;
+					if ((ComponentMask & 7) == 7 || KeyFormat == ACF_IntervalFixed32NoW)
+						k = DecodeTranslationKeys(Reader, Seq->CompressedByteStream, KeyFormat, NumKeys, Mins, Ranges, 1.0f / 128, A->KeyPos);
+					for ( ; k < NumKeys; k++)
 					{
 						switch (KeyFormat)
 						{
@@ -858,7 +1237,11 @@ void UAnimSet::ConvertAnims()
 						if (ComponentMask & 2) Reader << Mins.Y << Ranges.Y;
 						if (ComponentMask & 4) Reader << Mins.Z << Ranges.Z;
 					}
-					for (k = 0; k < NumKeys; k++)
+					// ACF_Fixed48NoW could have some quaternion components omitted
+					k = 0;
+					if (KeyFormat != ACF_Fixed48NoW || (ComponentMask & 7) == 7)
+						k = DecodeRotationKeys(Reader, Seq->CompressedByteStream, KeyFormat, NumKeys, Mins, Ranges, A->KeyQuat);
+					for ( ; k < NumKeys; k++)
 					{
 						switch (KeyFormat)
 						{
@@ -985,7 +1368,9 @@ void UAnimSet::ConvertAnims()
 				} // else - original code for uncompressed vector
 #endif // TRANSFORMERS
 
-				for (k = 0; k < TransKeys; k++)
+				// common formats are decoded at once, this loop is used for remaining ones
+				k = DecodeTranslationKeys(Reader, Seq->CompressedByteStream, TranslationCompressionFormat, TransKeys, Mins, Ranges, 1.0f, A->KeyPos);
+				for ( ; k < TransKeys; k++)
 				{
 					switch (TranslationCompressionFormat)
 					{
@@ -1087,7 +1472,8 @@ void UAnimSet::ConvertAnims()
 				Reader << TransQuatBase;
 #endif // TRANSFORMERS
 
-			for (k = 0; k < RotKeys; k++)
+			k = DecodeRotationKeys(Reader, Seq->CompressedByteStream, RotationCompressionFormat, RotKeys, Mins, Ranges, A->KeyQuat);
+			for ( ; k < RotKeys; k++)
 			{
 				switch (RotationCompressionFormat)
 				{
@@ -1203,6 +1589,8 @@ void UAnimSet::ConvertAnims()
 				TransOffset, TransEnd, RotOffset, Reader.Tell(), TransKeys, RotKeys);
 #endif // DEBUG_DECOMPRESS
 		}
+
+		Dst->PackTracks();
 	}
 
 	unguard;
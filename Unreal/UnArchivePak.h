@@ -63,6 +63,7 @@ struct FPakEntry
 	int			CompressionBlockSize;
 
 	int64		StructSize;					// computed value
+	FPakEntry*	HashNext;					// used for fast search by name
 
 	friend FArchive& operator<<(FArchive& Ar, FPakEntry& P)
 	{
@@ -98,22 +99,23 @@ struct FPakEntry
 	}
 };
 
+// Copy data from decompressed block of compressed pak file, starting at 'BlockOffset'.
+// Returns number of copied bytes, which is limited by block size. Blocks are stored in
+// LRU cache which is shared between all pak files.
+int appReadPakBlock(FArchive* Reader, CMutex& ReaderLock, const FPakEntry* Info, int BlockIndex, int BlockOffset, void* Data, int Size);
+// Remove all cached blocks of particular pak file
+void appFlushPakBlocks(const FArchive* Reader);
+
 class FPakFile : public FArchive
 {
 	DECLARE_ARCHIVE(FPakFile, FArchive);
 public:
-	FPakFile(const FPakEntry* info, FArchive* reader)
+	FPakFile(const FPakEntry* info, FArchive* reader, CMutex* readerLock)
 	:	Info(info)
 	,	Reader(reader)
-	,	UncompressedData(NULL)
+	,	ReaderLock(readerLock)
 	{}
 
-	virtual ~FPakFile()
-	{
-		if (UncompressedData)
-			appFree(UncompressedData);
-	}
-
 	virtual void Serialize(void *data, int size)
 	{
 		guard(FPakFile::Serialize);
@@ -124,33 +126,22 @@ public:
 		{
 			guard(SerializeCompressed);
 
-			if (UncompressedData == NULL)
-			{
-				// didn't start decompression yet
-				UncompressedData = (byte*)appMalloc((int)Info->UncompressedSize);
-				UncompressedPos = 0;
-			}
+			if (ArPos + size > Info->UncompressedSize)
+				appError("Serializing behind end of file (%X+%X > %X)", ArPos, size, (int)Info->UncompressedSize);
 
-			// fill uncompressed buffer
-			int DesiredDataEnd = ArPos + size;
-			while (DesiredDataEnd > UncompressedPos)
+			// decompress only blocks which contains requested data
+			int BlockIndex  = ArPos / Info->CompressionBlockSize;
+			int BlockOffset = ArPos - BlockIndex * Info->CompressionBlockSize;
+			while (size > 0)
 			{
-				int BlockIndex = UncompressedPos / Info->CompressionBlockSize;
-				const FPakCompressedBlock& Block = Info->CompressionBlocks[BlockIndex];
-				int CompressedBlockSize = (int)(Block.CompressedEnd - Block.CompressedStart);
-				int UncompressedBlockSize = min((int)Info->CompressionBlockSize, (int)Info->UncompressedSize - UncompressedPos);
-				byte* CompressedData = (byte*)appMalloc(CompressedBlockSize);
-				Reader->Seek64(Block.CompressedStart);
-				Reader->Serialize(CompressedData, CompressedBlockSize);
-				appDecompress(CompressedData, CompressedBlockSize, UncompressedData + UncompressedPos, UncompressedBlockSize, Info->CompressionMethod);
-				UncompressedPos += UncompressedBlockSize;
-				appFree(CompressedData);
+				int ToCopy = appReadPakBlock(Reader, *ReaderLock, Info, BlockIndex, BlockOffset, data, size);
+				data    = OffsetPointer(data, ToCopy);
+				size   -= ToCopy;
+				ArPos  += ToCopy;
+				BlockIndex++;
+				BlockOffset = 0;
 			}
 
-			// copy uncompressed data
-			memcpy(data, UncompressedData + ArPos, size);
-			ArPos += size;
-
 			unguard;
 		}
 		else
@@ -159,8 +150,7 @@ public:
 
 			// seek every time in a case if the same 'Reader' was used by different FPakFile
 			// (this is a lightweight operation for buffered FArchive)
-			Reader->Seek64(Info->Pos + Info->StructSize + ArPos);
-			Reader->Serialize(data, size);
+			appReadVfsData(Reader, *ReaderLock, Info->Pos + Info->StructSize + ArPos, data, size);
 			ArPos += size;
 
 			unguard;
@@ -184,8 +174,7 @@ public:
 protected:
 	const FPakEntry* Info;
 	FArchive*	Reader;
-	byte*		UncompressedData;
-	int			UncompressedPos;
+	CMutex*	ReaderLock;
 };
 
 
@@ -193,13 +182,16 @@ class FPakVFS : public FVirtualFileSystem
 {
 public:
 	FPakVFS()
-	:	LastInfo(NULL)
-	,	Reader(NULL)
+	:	Reader(NULL)
 	{}
 
 	virtual ~FPakVFS()
 	{
-		delete Reader;
+		if (Reader)
+		{
+			appFlushPakBlocks(Reader);
+			delete Reader;
+		}
 	}
 
 	virtual bool AttachReader(FArchive* reader)
@@ -240,6 +232,73 @@ public:
 			*Reader << E;
 		}
 
+		BuildHashTable();
+
+		return true;
+
+		unguard;
+	}
+
+	virtual bool SaveDirectory(FArchive& Ar)
+	{
+		guard(FPakVFS::SaveDirectory);
+
+		// cached entries are stored using the latest pak format; keep version of the original
+		// file to restore Reader in the same state as AttachReader() does
+		Ar.PakVer = PAK_COMPRESSION_ENCRYPTION;
+		int version = Reader->PakVer;
+		Ar << version;
+
+		int count = FileInfos.Num();
+		Ar << count;
+		for (int i = 0; i < count; i++)
+		{
+			FPakEntry& E = FileInfos[i];
+			FStaticString<512> Filename;
+			Filename = E.Name;
+			// StructSize depends on format of original pak file, and it is recomputed by serializer
+			int64 StructSize = E.StructSize;
+			Ar << Filename << E;
+			E.StructSize = StructSize;
+			Ar << StructSize;
+		}
+		return true;
+
+		unguard;
+	}
+
+	virtual bool LoadDirectory(FArchive* reader, FArchive& Ar)
+	{
+		guard(FPakVFS::LoadDirectory);
+
+		Ar.PakVer = PAK_COMPRESSION_ENCRYPTION;
+
+		int version, count;
+		Ar << version << count;
+		// each entry takes at least 65 bytes, don't trust 'count' from damaged cache
+		if (count < 0 || count > (Ar.GetFileSize() - Ar.Tell()) / 65)
+			return false;
+		FileInfos.AddZeroed(count);
+		for (int i = 0; i < count; i++)
+		{
+			FPakEntry& E = FileInfos[i];
+			FStaticString<512> Filename;
+			Ar << Filename;
+			E.Name = appStrdupPool(Filename);
+			Ar << E << E.StructSize;
+		}
+		if (!Ar.IsEof())
+		{
+			FileInfos.Empty();
+			return false;
+		}
+
+		// setup reader in the same way as AttachReader() does
+		Reader = reader;
+		Reader->PakVer = version;
+
+		BuildHashTable();
+
 		return true;
 
 		unguard;
@@ -259,36 +318,48 @@ public:
 
 	virtual const char* FileName(int i)
 	{
-		FPakEntry* info = &FileInfos[i];
-		LastInfo = info;
-		return info->Name;
+		return FileInfos[i].Name;
 	}
 
 	virtual FArchive* CreateReader(const char* name)
 	{
 		const FPakEntry* info = FindFile(name);
 		if (!info) return NULL;
-		return new FPakFile(info, Reader);
+		return new FPakFile(info, Reader, &ReaderLock);
 	}
 
 protected:
 	FArchive*			Reader;
+	CMutex				ReaderLock;			// 'Reader' is shared by all FPakFile's
 	TArray<FPakEntry>	FileInfos;
-	FPakEntry*			LastInfo;			// cached last accessed file info, simple optimization
+	TArray<FPakEntry*>	HashTable;
+
+	// build hash for fast file lookup; use hash size which is power of 2 and not less
+	// than number of files. Files are inserted in reverse order, so when pak has several
+	// entries with the same name, the first one is found, as with linear search.
+	void BuildHashTable()
+	{
+		int hashSize = 256;
+		while (hashSize < FileInfos.Num()) hashSize <<= 1;
+		HashTable.AddZeroed(hashSize);
+		for (int i = FileInfos.Num() - 1; i >= 0; i--)
+		{
+			FPakEntry* E = &FileInfos[i];
+			int hash = appStringHash(E->Name) & (hashSize - 1);
+			E->HashNext = HashTable[hash];
+			HashTable[hash] = E;
+		}
+	}
 
 	const FPakEntry* FindFile(const char* name)
 	{
-		if (LastInfo && !stricmp(LastInfo->Name, name))
-			return LastInfo;
+		if (!HashTable.Num()) return NULL;
 
-		for (int i = 0; i < FileInfos.Num(); i++)
+		int hash = appStringHash(name) & (HashTable.Num() - 1);
+		for (FPakEntry* info = HashTable[hash]; info; info = info->HashNext)
 		{
-			FPakEntry* info = &FileInfos[i];
 			if (!stricmp(info->Name, name))
-			{
-				LastInfo = info;
 				return info;
-			}
 		}
 		return NULL;
 	}
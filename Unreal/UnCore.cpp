@@ -1,5 +1,6 @@
 #include "Core.h"
 #include "UnCore.h"
+#include "Parallel.h"
 
 
 int  GForceGame           = GAME_UNKNOWN;
@@ -50,7 +51,7 @@ FArray::~FArray()
 	DataCount = 0;
 }
 
-void FArray::Empty(int count, int elementSize)
+void FArray::Empty(int count, int elementSize, bool zero)
 {
 	guard(FArray::Empty);
 
@@ -84,14 +85,76 @@ void FArray::Empty(int count, int elementSize)
 
 	if (count)
 	{
-		DataPtr = appMalloc(count * elementSize);
+		DataPtr = zero ? appMalloc(count * elementSize) : appMallocNoInit(count * elementSize);
 	}
 
 	unguardf("%d x %d", count, elementSize);
 }
 
 
-void FArray::Insert(int index, int count, int elementSize)
+void FArray::EmptyForLoading(int count, int elementSize, bool zero)
+{
+	guard(FArray::EmptyForLoading);
+
+	CMemoryChain *Arena = appGetThreadArena();
+	if (!Arena || !count || count == MaxCount || (IsStatic() && count <= MaxCount))
+	{
+		// existing memory could be reused, or no arena
+		Empty(count, elementSize, zero);
+		return;
+	}
+
+	if (DataPtr && !IsStatic())
+		appFree(DataPtr);
+	DataCount = 0;
+	MaxCount  = count;
+	DataPtr   = appArenaMalloc(Arena, count * elementSize, zero);
+
+	unguardf("%d x %d", count, elementSize);
+}
+
+
+void FArray::Reallocate(int count, int elementSize)
+{
+	guard(FArray::Reallocate);
+	assert(count >= DataCount);
+
+	void* oldData = DataPtr;
+	DataPtr = count ? appMallocNoInit(count * elementSize) : NULL;
+	if (DataCount)
+		memcpy(DataPtr, oldData, DataCount * elementSize);
+	// "static" array becomes non-static, static memory shouldn't be released
+	if (oldData && !IsStaticPointer(oldData))
+		appFree(oldData);
+	MaxCount = count;
+
+	unguardf("%d x %d", count, elementSize);
+}
+
+
+void FArray::Reserve(int count, int elementSize)
+{
+	guard(FArray::Reserve);
+	if (count > MaxCount)
+		Reallocate(count, elementSize);
+	unguard;
+}
+
+
+void FArray::Shrink(int elementSize)
+{
+	guard(FArray::Shrink);
+	// can't return to static storage: its size is unknown here
+	if (!IsStatic() && MaxCount > DataCount)
+		Reallocate(DataCount, elementSize);
+	unguard;
+}
+
+
+// Largest allocation size for array growth, appMalloc() will not allocate 256Mb or more.
+#define MAX_ARRAY_ALLOC_SIZE	((256<<20) - 1024)
+
+void FArray::Insert(int index, int count, int elementSize, bool zero)
 {
 	guard(FArray::Insert);
 	assert(index >= 0);
@@ -99,37 +162,31 @@ void FArray::Insert(int index, int count, int elementSize)
 	assert(count >= 0);
 	if (!count) return;
 	// check for available space
-	if (DataCount + count > MaxCount)
+	int newCount = DataCount + count;
+	if (newCount > MaxCount)
 	{
-		// not enough space, resize ...
-		int prevCount = MaxCount;
-		MaxCount = ((DataCount + count + 15) / 16) * 16 + 16;
-		if (!IsStatic())
-		{
-			DataPtr = appRealloc(DataPtr, MaxCount * elementSize);
-		}
-		else
-		{
-			// "static" array becomes non-static
-			void* oldData = DataPtr; // this is a static pointer
-			DataPtr = appMalloc(MaxCount * elementSize);
-			memcpy(DataPtr, oldData, prevCount * elementSize);
-		}
-		// zero added memory
-		memset(
-			(byte*)DataPtr + prevCount * elementSize,
-			0,
-			(MaxCount - prevCount) * elementSize
-		);
+		// not enough space, grow array geometrically, so sequence of Add() calls
+		// will cause O(log(N)) reallocations
+		int newMax = newCount + newCount / 2 + 16;
+		int maxItems = MAX_ARRAY_ALLOC_SIZE / elementSize;
+		if (newMax > maxItems)
+			newMax = max(newCount, maxItems);	// allocate exact size when limit is reached
+		Reallocate(newMax, elementSize);
 	}
 	// move data
-	memmove(
-		(byte*)DataPtr + (index + count)     * elementSize,
-		(byte*)DataPtr + index               * elementSize,
-						 (DataCount - index) * elementSize
-	);
+	if (index < DataCount)
+	{
+		memmove(
+			(byte*)DataPtr + (index + count)     * elementSize,
+			(byte*)DataPtr + index               * elementSize,
+							 (DataCount - index) * elementSize
+		);
+	}
+	// zero inserted items
+	if (zero)
+		memset((byte*)DataPtr + index * elementSize, 0, count * elementSize);
 	// last operation: advance counter
-	DataCount += count;
+	DataCount = newCount;
 	unguard;
 }
 
@@ -180,7 +237,7 @@ void FArray::RawCopy(const FArray &Src, int elementSize)
 {
 	guard(FArray::RawCopy);
 
-	Empty(Src.DataCount, elementSize);
+	Empty(Src.DataCount, elementSize, false);
 	if (!Src.DataCount) return;
 	DataCount = Src.DataCount;
 	memcpy(DataPtr, Src.DataPtr, Src.DataCount * elementSize);
@@ -209,7 +266,7 @@ FString::FString(const char* src)
 	else
 	{
 		int len = strlen(src) + 1;
-		Data.AddUninitialized(len);
+		Data.AddNoInit(len);
 		memcpy(Data.GetData(), src, len);
 	}
 }
@@ -228,7 +285,7 @@ FString& FString::operator=(const char* src)
 	else
 	{
 		int len = strlen(src) + 1;
-		Data.AddUninitialized(len);
+		Data.AddNoInit(len);
 		memcpy(Data.GetData(), src, len);
 	}
 	return *this;
@@ -241,13 +298,13 @@ FString& FString::operator+=(const char* text)
 	int oldLen = Data.Num();
 	if (oldLen)
 	{
-		Data.AddUninitialized(len);
+		Data.AddNoInit(len);
 		// oldLen-1 -- cut null char, len+1 -- append null char
 		memcpy(OffsetPointer(Data.GetData(), oldLen-1), text, len+1);
 	}
 	else
 	{
-		Data.AddUninitialized(len+1);	// reserve space for null char
+		Data.AddNoInit(len+1);	// reserve space for null char
 		memcpy(Data.GetData(), text, len+1);
 	}
 	return *this;
@@ -279,67 +336,147 @@ char* FString::Detach()
 	FName (string) pool
 -----------------------------------------------------------------------------*/
 
-#define STRING_HASH_SIZE		16384
+// Strings are stored in open-addressing hash tables indexed by 64-bit hash of lowercase string,
+// so all case variants of a string are located in the same probe sequence. Each entry holds a
+// pointer to the first added case variant, which is used as FName comparison key. Which variant
+// is the first one depends on loading order, so this pointer is never used as a displayed string.
+// The pool is split into shards by hash value, each shard has its own lock, so parallel loaders
+// are rarely waiting for each other.
+
+#define STRING_POOL_SHARDS		64			// should be power of 2
+#define STRING_SHARD_MIN_SIZE	1024		// initial size of shard's hash table, power of 2
+
+const char GNameNone[] = "None";
 
 struct CStringPoolEntry
 {
-	CStringPoolEntry*	HashNext;
+	const char*			NoCaseStr;			// string shared by all case variants
 	int					Length;
 	char				Str[1];
 };
 
-static CStringPoolEntry* StringHashTable[STRING_HASH_SIZE];
-static CMemoryChain* StringPool;
+struct CStringPoolSlot
+{
+	uint64				Hash;
+	CStringPoolEntry*	Entry;				// NULL for empty slot
+};
 
-const char* appStrdupPool(const char* str)
+struct CStringPoolShard
+{
+	CSpinLock			Lock;
+	CStringPoolSlot*	Slots;
+	int					Size;
+	int					Count;
+	CMemoryChain*		Mem;
+};
+
+static CStringPoolShard StringPool[STRING_POOL_SHARDS];
+
+// FNV-1a hash of lowercase string
+static FORCEINLINE uint64 GetStringHash(const char* str, int& len)
 {
-	int len = strlen(str);
-	int hash = 0;
-	for (int i = 0; i < len; i++)
+	uint64 hash = ((uint64)0xCBF29CE4 << 32) | 0x84222325;
+	const uint64 prime = ((uint64)0x100 << 32) | 0x1B3;
+	const char* s;
+	for (s = str; *s; s++)
 	{
-		char c = str[i];
-#if 0
-		hash = (hash + c) ^ 0xABCDEF;
-#else
-		hash = ROL16(hash, 5) - hash + ((c << 4) + c ^ 0x13F);	// some crazy hash function
-#endif
+		byte c = *s;
+		if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+		hash = (hash ^ c) * prime;
+	}
+	len = s - str;
+	return hash;
+}
+
+static void ResizeStringShard(CStringPoolShard& Shard, int NewSize)
+{
+	CStringPoolSlot* OldSlots = Shard.Slots;
+	int OldSize = Shard.Size;
+	Shard.Slots = (CStringPoolSlot*)appMalloc(NewSize * sizeof(CStringPoolSlot));	// zero-filled
+	Shard.Size  = NewSize;
+	int mask = NewSize - 1;
+	for (int i = 0; i < OldSize; i++)
+	{
+		const CStringPoolSlot& S = OldSlots[i];
+		if (!S.Entry) continue;
+		int j = (int)S.Hash & mask;
+		while (Shard.Slots[j].Entry)
+			j = (j + 1) & mask;
+		Shard.Slots[j] = S;
 	}
-	hash &= (STRING_HASH_SIZE - 1);
+	if (OldSlots) appFree(OldSlots);
+}
 
-	for (const CStringPoolEntry* s = StringHashTable[hash]; s; s = s->HashNext)
+static const CStringPoolEntry* StrdupPoolLocked(CStringPoolShard& Shard, const char* str, int len, uint64 hash)
+{
+	if (!Shard.Size)
 	{
-		if (s->Length == len && !strcmp(str, s->Str))		// found a string
-			return s->Str;
+		ResizeStringShard(Shard, STRING_SHARD_MIN_SIZE);
+		Shard.Mem = new CMemoryChain();
 	}
 
-	if (!StringPool) StringPool = new CMemoryChain();
+	// find a string
+	const char* NoCaseStr = NULL;
+	int mask = Shard.Size - 1;
+	int i;
+	for (i = (int)hash & mask; Shard.Slots[i].Entry; i = (i + 1) & mask)
+	{
+		const CStringPoolSlot& S = Shard.Slots[i];
+		if (S.Hash != hash || S.Entry->Length != len) continue;
+		const CStringPoolEntry* E = S.Entry;
+		if (!memcmp(E->Str, str, len))
+			return E;
+		if (!NoCaseStr && !stricmp(E->Str, str))
+			NoCaseStr = E->NoCaseStr;
+	}
 
-	// allocate new string from pool
-	CStringPoolEntry* n = (CStringPoolEntry*)StringPool->Alloc(sizeof(CStringPoolEntry) + len);	// note: null byte is taken into account in CStringPoolEntry
-	n->HashNext = StringHashTable[hash];
-	StringHashTable[hash] = n;
+	// allocate new string from pool, slot 'i' is empty
+	CStringPoolEntry* n = (CStringPoolEntry*)Shard.Mem->AllocNoInit(sizeof(CStringPoolEntry) + len);	// note: null byte is taken into account in CStringPoolEntry
 	n->Length = len;
 	memcpy(n->Str, str, len+1);
+	if (!NoCaseStr)
+		NoCaseStr = stricmp(str, GNameNone) ? n->Str : GNameNone;	// keep FName() default value equal to pooled "None"
+	n->NoCaseStr = NoCaseStr;
+	Shard.Slots[i].Hash  = hash;
+	Shard.Slots[i].Entry = n;
+	// keep hash table half-empty, so probe sequences are short
+	if (++Shard.Count * 2 > Shard.Size)
+		ResizeStringShard(Shard, Shard.Size * 2);
+
+	return n;
+}
 
-	return n->Str;
+static const CStringPoolEntry* StrdupPool(const char* str)
+{
+	int len;
+	uint64 hash = GetStringHash(str, len);
+	CStringPoolShard& Shard = StringPool[(int)(hash >> 32) & (STRING_POOL_SHARDS - 1)];
+	Shard.Lock.Lock();
+	const CStringPoolEntry* E = StrdupPoolLocked(Shard, str, len, hash);
+	Shard.Lock.Unlock();
+	return E;
+}
+
+const char* appStrdupPool(const char* str)
+{
+	return StrdupPool(str)->Str;
+}
+
+const char* appStrdupPool(const char* str, const char*& NoCaseStr)
+{
+	const CStringPoolEntry* E = StrdupPool(str);
+	NoCaseStr = E->NoCaseStr;
+	return E->Str;
 }
 
 #if 0
-void PrintStringHashDistribution()
+void PrintStringPoolStats()
 {
-	int hashCounts[1024];
-	memset(hashCounts, 0, sizeof(hashCounts));
-	for (int hash = 0; hash < STRING_HASH_SIZE; hash++)
+	appPrintf("String pool:\n");
+	for (int i = 0; i < STRING_POOL_SHARDS; i++)
 	{
-		int count = 0;
-		for (CStringPoolEntry* item = StringHashTable[hash]; item; item = item->HashNext)
-			count++;
-		assert(count < ARRAY_COUNT(hashCounts));
-		hashCounts[count]++;
+		const CStringPoolShard& Shard = StringPool[i];
+		appPrintf("%2d: %d strings, %d slots, %d bytes\n", i, Shard.Count, Shard.Size, Shard.Mem ? Shard.Mem->GetSize() : 0);
 	}
-	appPrintf("String hash distribution:\n");
-	for (int i = 0; i < ARRAY_COUNT(hashCounts); i++)
-		if (hashCounts[i] > 0)
-			appPrintf("%d -> %d\n", i, hashCounts[i]);
 }
 #endif
@@ -82,26 +82,34 @@ void appPrintProfiler();
 	Game directory support
 -----------------------------------------------------------------------------*/
 
+// Set the file which is used to keep game directory contents between runs, so only
+// changed directories will be rescanned. Should be called before appSetRootDirectory().
+void appSetGameFileCache(const char *filename);
+// Save the game file cache, when it is enabled. Called automatically from appSetRootDirectory().
+void appSaveGameFileCache();
 void appSetRootDirectory(const char *dir, bool recurse = true);
 void appSetRootDirectory2(const char *filename);
 const char *appGetRootDirectory();
 
+// Note: there could be millions of these structures, so keep it compact
 struct CGameFileInfo
 {
-	char		RelativeName[MAX_PACKAGE_PATH];		// relative to RootDirectory
+	const char *RelativeName;						// relative to RootDirectory; string is owned by file system
 	const char *ShortFilename;						// without path, points to filename part of RelativeName
 	const char *Extension;							// points to extension part (excluding '.') of RelativeName
 	CGameFileInfo* HashNext;						// used for fast search; computed from ShortFilename excluding extension
-	bool		IsPackage;
-	bool		PackageScanned;
-	int			SizeInKb;							// file size, in kilobytes
 	class FVirtualFileSystem* FileSystem;			// owning virtual file system (NULL for OS file system)
 	UnPackage*	Package;
+	int			SizeInKb;							// file size, in kilobytes
+	int			PackageVer;							// package version found by ScanPackages(); 0 = not scanned, -1 = not a package
+	int			PackageLicVer;
 	// content information, valid when PackageScanned is true
 	int			NumSkeletalMeshes;
 	int			NumStaticMeshes;
 	int			NumAnimations;
 	int			NumTextures;
+	bool		IsPackage;
+	bool		PackageScanned;
 };
 
 extern int GNumGameFiles;
@@ -143,7 +151,14 @@ extern const char *GStartupPackage;
 	FName class
 -----------------------------------------------------------------------------*/
 
+// Copy string to a pool which is never released; equal strings are sharing the same pointer.
 const char* appStrdupPool(const char* str);
+// The same, and also returns 'NoCaseStr' pointer, which is shared by all strings different only
+// in character case. Used for FName comparison.
+const char* appStrdupPool(const char* str, const char*& NoCaseStr);
+
+// Default FName value, also used as NoCaseStr of all pooled variants of "None"
+extern const char GNameNone[];
 
 class FName
 {
@@ -153,13 +168,15 @@ public:
 	int			ExtraIndex;
 #endif
 	const char	*Str;
+	const char	*NoCaseStr;			// the same pointer for all case variants of the name
 
 	FName()
 	:	Index(0)
-	,	Str("None")
 #if UNREAL3 || UNREAL4
 	,	ExtraIndex(0)
 #endif
+	,	Str(GNameNone)
+	,	NoCaseStr(GNameNone)
 	{}
 
 	inline FName& operator=(const FName &Other)
@@ -169,12 +186,13 @@ public:
 		ExtraIndex = Other.ExtraIndex;
 #endif // UNREAL3
 		Str = Other.Str;
+		NoCaseStr = Other.NoCaseStr;
 		return *this;
 	}
 
 	inline FName& operator=(const char* String)
 	{
-		Str = appStrdupPool(String);
+		Str = appStrdupPool(String, NoCaseStr);
 		Index = 0;
 #if UNREAL3 || UNREAL4
 		ExtraIndex = 0;
@@ -184,8 +202,8 @@ public:
 
 	inline bool operator==(const FName& Other) const
 	{
-		// we're using appStrdupPool for FName strings, so perhaps comparison of pointers is enough here
-		return (Str == Other.Str) || (stricmp(Str, Other.Str) == 0);
+		// FName strings are allocated with appStrdupPool(), so comparison of pointers is enough here
+		return (NoCaseStr == Other.NoCaseStr);
 	}
 
 	inline bool operator==(const char* String) const
@@ -697,6 +715,36 @@ public:
 };
 
 
+// File reader which maps the whole file into memory instead of using stdio
+// buffer. Open() fails when file couldn't be mapped (for example, when it is too
+// large for 32-bit address space, or when too much data is already mapped), in
+// this case FFileReader should be used.
+class FMappedFileReader : public FFileArchive
+{
+	DECLARE_ARCHIVE(FMappedFileReader, FFileArchive);
+public:
+	FMappedFileReader(const char *Filename, unsigned InOptions = 0);
+	virtual ~FMappedFileReader();
+
+	virtual void Serialize(void *data, int size);
+	virtual bool Open();
+	virtual void Close();
+	virtual bool IsOpen() const;
+	virtual int64 GetFileSize64() const;
+
+	// Pointer to the file contents, valid until the file is closed. Could be used
+	// to access file data without copying.
+	const byte* GetData() const
+	{
+		return MappedData;
+	}
+
+protected:
+	const byte	*MappedData;
+	bool		Mapped;			// could be 'true' with MappedData == NULL for empty file
+};
+
+
 class FFileWriter : public FFileArchive
 {
 	DECLARE_ARCHIVE(FFileWriter, FFileArchive);
@@ -1323,21 +1371,40 @@ protected:
 	// immediately after FArray structure
 	FORCEINLINE bool IsStatic() const
 	{
-		return DataPtr == (void*)(this + 1);
+		return IsStaticPointer(DataPtr);
+	}
+	FORCEINLINE bool IsStaticPointer(const void* Ptr) const
+	{
+		return Ptr == (void*)(this + 1);
 	}
 
 	// serializers
 	FArchive& Serialize(FArchive &Ar, void (*Serializer)(FArchive&, void*), int elementSize);
 
-	void Empty (int count, int elementSize);
+	// remove all items and preallocate memory for 'count' items; memory is zeroed
+	// unless 'zero' is false
+	void Empty (int count, int elementSize, bool zero = true);
+	// the same as Empty(), but memory is allocated from the thread's arena when it is set,
+	// used by serializers
+	void EmptyForLoading(int count, int elementSize, bool zero = true);
+	// make sure there's memory for at least 'count' items, array contents is not changed
+	void Reserve(int count, int elementSize);
+	// release memory which is not used by array items
+	void Shrink(int elementSize);
 	// insert 'count' items of size 'elementSize' at position 'index', memory will be zeroed
-	void Insert(int index, int count, int elementSize);
+	// unless 'zero' is false
+	void Insert(int index, int count, int elementSize, bool zero = true);
 	// remove items and then move next items to the position of removed items
 	void Remove(int index, int count, int elementSize);
 	// remove items and then fill the hole with items from array's end
 	void RemoveAtSwap(int index, int count, int elementSize);
 
 	void* GetItem(int index, int elementSize) const;
+
+private:
+	// reallocate memory for exactly 'count' items, existing items are relocated with
+	// memcpy(), new memory is not initialized
+	void Reallocate(int count, int elementSize);
 };
 
 #if DECLARE_VIEWER_PROPS
@@ -1354,6 +1421,8 @@ FArchive& SerializeBulkArray(FArchive &Ar, FArray &Array, FArchive& (*Serializer
 // NOTE: this container cannot hold objects, required constructor/destructor
 // (at least, Add/Insert/Remove functions are not supported, but can serialize
 // such data)
+// Items are relocated in memory with memcpy() when array grows, so items should not
+// hold pointers to themselves (i.e. TArray<TStaticArray<...>> is not allowed).
 template<typename T>
 class TArray : public FArray
 {
@@ -1416,7 +1485,15 @@ public:
 
 	FORCEINLINE void Init(const T& value, int count)
 	{
-		Empty(count);
+		if (TTypeInfo<T>::IsPod)
+		{
+			// all items will be overwritten, so don't waste time for zeroing memory
+			FArray::Empty(count, sizeof(T), false);
+		}
+		else
+		{
+			Empty(count);
+		}
 		DataCount = count;
 		for (int i = 0; i < count; i++)
 			*((T*)DataPtr + i) = value;
@@ -1424,7 +1501,11 @@ public:
 
 	FORCEINLINE int Add(const T& item)
 	{
-		int index = AddUninitialized();
+		int index = DataCount;
+		if (TTypeInfo<T>::IsPod && index < MaxCount)
+			DataCount++;				// fast path: item will be overwritten, so no need to zero it
+		else
+			index = AddNoInit();
 		Item(index) = item;
 		return index;
 	}
@@ -1441,15 +1522,28 @@ public:
 		if (!TTypeInfo<T>::IsPod) Construct(index, count);
 		return index;
 	}
-	// There's no way to implement AddUninitialized - FArray functions always zero memory for newly allocated items
+	// Constructors are not called, but memory is zeroed, so callers may fill items partially.
 	FORCEINLINE int AddUninitialized(int count = 1)
 	{
-		return AddZeroed(count);
+		int index = DataCount;
+		FArray::Insert(index, count, sizeof(T));
+		return index;
+	}
+	// This function doesn't exist in UE4. The same as AddUninitialized(), but memory is
+	// not zeroed for POD types, so caller should overwrite all added items completely.
+	// Items with constructor are zeroed, because an assignment operator could expect
+	// initialized data.
+	FORCEINLINE int AddNoInit(int count = 1)
+	{
+		int index = DataCount;
+		FArray::Insert(index, count, sizeof(T), !TTypeInfo<T>::IsPod);
+		return index;
 	}
 
 	FORCEINLINE void Insert(const T& item, int index)
 	{
-		InsertUninitialized(index, 1);
+		// item is overwritten completely, see AddNoInit()
+		FArray::Insert(index, 1, sizeof(T), !TTypeInfo<T>::IsPod);
 		Item(index) = item;
 	}
 	FORCEINLINE void InsertZeroed(int index, int count = 1)
@@ -1462,9 +1556,10 @@ public:
 		FArray::Insert(index, count, sizeof(T));
 		if (!TTypeInfo<T>::IsPod) Construct(index, count);
 	}
+	// see AddUninitialized() for details
 	FORCEINLINE void InsertUninitialized(int index, int count = 1)
 	{
-		InsertZeroed(index, count);
+		FArray::Insert(index, count, sizeof(T));
 	}
 
 	FORCEINLINE void RemoveAt(int index, int count = 1)
@@ -1517,6 +1612,18 @@ public:
 		FArray::Empty(count, sizeof(T));
 	}
 
+	// preallocate memory for 'count' items, array contents is not changed
+	FORCEINLINE void Reserve(int count)
+	{
+		FArray::Reserve(count, sizeof(T));
+	}
+
+	// release memory which is not used by array items
+	FORCEINLINE void Shrink()
+	{
+		FArray::Shrink(sizeof(T));
+	}
+
 	// set new DataCount without reallocation if possible
 	FORCEINLINE void Reset(int count = 0)
 	{
@@ -1663,7 +1770,7 @@ FORCEINLINE void* operator new(size_t size, TArray<T> &Array)
 {
 	guard(TArray::operator new);
 	assert(size == sizeof(T));
-	int index = Array.AddUninitialized(1);
+	int index = Array.AddZeroed(1);		// structures without constructor are expected to be zeroed
 	return Array.GetData() + index;
 	unguard;
 }
@@ -1718,7 +1825,7 @@ inline void CopyArray(TArray<T1> &Dst, const TArray<T2> &Src)
 	Dst.Empty(Count);
 	if (Count)
 	{
-		Dst.AddUninitialized(Count);
+		Dst.AddNoInit(Count);
 		T1 *pDst = (T1*)Dst.GetData();
 		T2 *pSrc = (T2*)Src.GetData();
 		do		// Count is > 0 here - checked above, so "do ... while" is more suitable (and more compact)
@@ -1729,6 +1836,55 @@ inline void CopyArray(TArray<T1> &Dst, const TArray<T2> &Src)
 }
 
 
+// Archive for writing data to a memory buffer (declared here because it uses TArray)
+class FMemWriter : public FArchive
+{
+	DECLARE_ARCHIVE(FMemWriter, FArchive);
+public:
+	FMemWriter()
+	{
+		IsLoading = false;
+	}
+
+	virtual void Seek(int Pos)
+	{
+		guard(FMemWriter::Seek);
+		assert(Pos >= 0 && Pos <= Data.Num());
+		ArPos = Pos;
+		unguard;
+	}
+
+	virtual bool IsEof() const
+	{
+		return ArPos >= Data.Num();
+	}
+
+	virtual void Serialize(void *data, int size)
+	{
+		guard(FMemWriter::Serialize);
+		int newSize = ArPos + size;
+		if (newSize > Data.Num())
+			Data.AddUninitialized(newSize - Data.Num());
+		memcpy(Data.GetData() + ArPos, data, size);
+		ArPos += size;
+		unguard;
+	}
+
+	virtual int GetFileSize() const
+	{
+		return Data.Num();
+	}
+
+	FORCEINLINE const byte* GetData() const
+	{
+		return Data.GetData();
+	}
+
+protected:
+	TArray<byte> Data;
+};
+
+
 /*-----------------------------------------------------------------------------
 	TMap template
 -----------------------------------------------------------------------------*/
@@ -1969,6 +2125,9 @@ struct FCompressedChunkHeader
 };
 
 void appReadCompressedChunk(FArchive &Ar, byte *Buffer, int Size, int CompressionFlags);
+// Decompress 'NumBlocks' blocks which are stored one after another in 'CompressedBuffer'.
+// Blocks are processed in parallel when multithreading is enabled.
+void appDecompressBlocks(byte *CompressedBuffer, byte *UncompressedBuffer, const FCompressedChunkBlock *Blocks, int NumBlocks, int CompressionFlags);
 
 
 /*-----------------------------------------------------------------------------
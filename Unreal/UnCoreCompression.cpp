@@ -1,5 +1,6 @@
 #include "Core.h"
 #include "UnCore.h"
+#include "Parallel.h"
 
 // includes for package decompression
 #include "lzo/lzo1x.h"
@@ -296,3 +297,51 @@ int appDecompress(byte *CompressedBuffer, int CompressedSize, byte *Uncompressed
 
 	unguardf("CompSize=%d UncompSize=%d Flags=0x%X", CompressedSize, UncompressedSize, Flags);
 }
+
+
+struct CDecompressBlocksContext
+{
+	byte						*CompressedBuffer;
+	byte						*UncompressedBuffer;
+	const FCompressedChunkBlock	*Blocks;
+	const int					*Offsets;		// pairs of compressed and uncompressed block offsets
+	int							Flags;
+};
+
+static void DecompressBlocksWorker(CDecompressBlocksContext *Context, int First, int Last)
+{
+	for (int i = First; i < Last; i++)
+	{
+		const FCompressedChunkBlock &Block = Context->Blocks[i];
+		appDecompress(Context->CompressedBuffer + Context->Offsets[i*2], Block.CompressedSize,
+			Context->UncompressedBuffer + Context->Offsets[i*2+1], Block.UncompressedSize, Context->Flags);
+	}
+}
+
+void appDecompressBlocks(byte *CompressedBuffer, byte *UncompressedBuffer, const FCompressedChunkBlock *Blocks, int NumBlocks, int CompressionFlags)
+{
+	guard(appDecompressBlocks);
+
+	// compute block positions
+	int *Offsets = (int*)appMalloc(NumBlocks * 2 * sizeof(int));
+	int CompressedPos = 0, UncompressedPos = 0;
+	for (int i = 0; i < NumBlocks; i++)
+	{
+		Offsets[i*2]   = CompressedPos;
+		Offsets[i*2+1] = UncompressedPos;
+		CompressedPos   += Blocks[i].CompressedSize;
+		UncompressedPos += Blocks[i].UncompressedSize;
+	}
+
+	CDecompressBlocksContext Context;
+	Context.CompressedBuffer   = CompressedBuffer;
+	Context.UncompressedBuffer = UncompressedBuffer;
+	Context.Blocks             = Blocks;
+	Context.Offsets            = Offsets;
+	Context.Flags              = CompressionFlags;
+	appParallelFor(NumBlocks, 1, DecompressBlocksWorker, &Context);
+
+	appFree(Offsets);
+
+	unguard;
+}
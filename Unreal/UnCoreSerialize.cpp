@@ -1,5 +1,6 @@
 #include "Core.h"
 #include "UnCore.h"
+#include "Parallel.h"				// appInterlockedAdd
 
 #if UNREAL4
 #include "UnPackage.h"			// for accessing FPackageFileSummary from FByteBulkData
@@ -7,6 +8,13 @@
 
 #if _WIN32
 #include <io.h>					// for _filelengthi64
+#define WIN32_LEAN_AND_MEAN			// exclude rarely-used services from windown headers
+#include <windows.h>				// for file mapping functions
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 #endif
 
 
@@ -117,7 +125,7 @@ FArchive& FArray::Serialize(FArchive &Ar, void (*Serializer)(FArchive&, void*),
 	if (Ar.IsLoading)
 	{
 		// loading array items - should prepare array
-		Empty(Count, elementSize);
+		EmptyForLoading(Count, elementSize);
 		DataCount = Count;
 	}
 	// perform serialization itself
@@ -190,8 +198,9 @@ FArchive& FArray::SerializeRaw(FArchive &Ar, void (*Serializer)(FArchive&, void*
 
 	if (Ar.IsLoading)
 	{
-		// loading array items - should prepare array
-		Empty(Count, elementSize);
+		// loading array items - should prepare array; memory will be completely
+		// overwritten, so don't zero it
+		EmptyForLoading(Count, elementSize, false);
 		DataCount = Count;
 	}
 	if (!Count) return Ar;
@@ -222,8 +231,9 @@ FArchive& FArray::SerializeSimple(FArchive &Ar, int NumFields, int FieldSize)
 	int elementSize = NumFields * FieldSize;
 	if (Ar.IsLoading)
 	{
-		// loading array items - should prepare array
-		Empty(Count, elementSize);
+		// loading array items - should prepare array; memory will be completely
+		// overwritten, so don't zero it
+		EmptyForLoading(Count, elementSize, false);
 		DataCount = Count;
 	}
 	if (!Count) return Ar;
@@ -396,7 +406,7 @@ FArchive& operator<<(FArchive &Ar, FString &S)
 	if (len > 0)
 	{
 		// ANSI string
-		S.Data.AddUninitialized(len);
+		S.Data.AddNoInit(len);
 		Ar.Serialize(S.Data.GetData(), len);
 	}
 	else
@@ -684,6 +694,162 @@ int64 FFileReader::GetFileSize64() const
 	return FileSize;
 }
 
+
+// Limit size of mapped files for 32-bit builds to not exhaust address space,
+// larger files are read with FFileReader.
+#define MAX_MAPPED_FILE_SIZE		(sizeof(void*) >= 8 ? (1LL << 40) : (64LL << 20))
+// Limit total size of all simultaneously mapped files: many packages could be opened at
+// the same time, files which don't fit are read with FFileReader too.
+#define MAX_MAPPED_TOTAL_SIZE		(sizeof(void*) >= 8 ? (1LL << 44) : (512LL << 20))
+
+static volatile size_t GMappedBytes = 0;
+
+// Reserve address space for mapping of 'Size' bytes, returns false when budget is exceeded
+static bool ReserveMappedBytes(int64 Size)
+{
+	if (appInterlockedAdd(&GMappedBytes, (size_t)Size) <= (size_t)MAX_MAPPED_TOTAL_SIZE)
+		return true;
+	appInterlockedAdd(&GMappedBytes, (size_t)-Size);
+	return false;
+}
+
+FMappedFileReader::FMappedFileReader(const char *Filename, unsigned InOptions)
+:	FFileArchive(Filename, InOptions)
+,	MappedData(NULL)
+,	Mapped(false)
+{
+	guard(FMappedFileReader::FMappedFileReader);
+	IsLoading = true;
+	Open();
+	unguardf("%s", Filename);
+}
+
+FMappedFileReader::~FMappedFileReader()
+{
+	Close();
+}
+
+void FMappedFileReader::Serialize(void *data, int size)
+{
+	guard(FMappedFileReader::Serialize);
+
+	if (ArStopper > 0 && ArPos64 + size > ArStopper)
+		appError("Serializing behind stopper (%llX+%X > %X)", ArPos64, size, ArStopper);
+	if (ArPos64 < 0 || ArPos64 + size > FileSize)
+		appError("Unable to serialize %d bytes at pos=0x%llX", size, ArPos64);
+	assert(Mapped);
+
+	memcpy(data, MappedData + ArPos64, size);
+	ArPos64 += size;
+
+	unguardf("File=%s", ShortName);
+}
+
+bool FMappedFileReader::Open()
+{
+	guard(FMappedFileReader::Open);
+	assert(!IsOpen());
+
+	ArPos64 = 0;
+	MappedData = NULL;
+
+#if _WIN32
+	HANDLE hFile = CreateFileA(FullName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+	{
+		if (!(Options & FRO_NoOpenError))
+			appError("Unable to open file %s", FullName);
+		return false;
+	}
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(hFile, &size) || size.QuadPart > MAX_MAPPED_FILE_SIZE)
+	{
+		CloseHandle(hFile);
+		return false;
+	}
+	FileSize = size.QuadPart;
+	if (FileSize > 0 && !ReserveMappedBytes(FileSize))
+	{
+		CloseHandle(hFile);
+		return false;
+	}
+	if (FileSize > 0)
+	{
+		// note: view keeps mapping object and file opened, so handles could be closed
+		HANDLE hMapping = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (hMapping)
+		{
+			MappedData = (byte*)MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+			CloseHandle(hMapping);
+		}
+	}
+	CloseHandle(hFile);
+#else
+	int fd = open(FullName, O_RDONLY);
+	if (fd < 0)
+	{
+		if (!(Options & FRO_NoOpenError))
+			appError("Unable to open file %s", FullName);
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size > MAX_MAPPED_FILE_SIZE)
+	{
+		close(fd);
+		return false;
+	}
+	FileSize = st.st_size;
+	if (FileSize > 0 && !ReserveMappedBytes(FileSize))
+	{
+		close(fd);
+		return false;
+	}
+	if (FileSize > 0)
+	{
+		void* data = mmap(NULL, FileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data != MAP_FAILED) MappedData = (byte*)data;
+	}
+	close(fd);
+#endif // _WIN32
+
+	if (FileSize > 0 && !MappedData)
+	{
+		// mapping failed
+		appInterlockedAdd(&GMappedBytes, (size_t)-FileSize);
+		return false;
+	}
+	Mapped = true;
+	return true;
+
+	unguardf("%s", FullName);
+}
+
+void FMappedFileReader::Close()
+{
+	if (MappedData)
+	{
+#if _WIN32
+		UnmapViewOfFile(MappedData);
+#else
+		munmap(const_cast<byte*>(MappedData), FileSize);
+#endif
+		MappedData = NULL;
+		appInterlockedAdd(&GMappedBytes, (size_t)-FileSize);
+	}
+	Mapped = false;
+}
+
+bool FMappedFileReader::IsOpen() const
+{
+	return Mapped;
+}
+
+int64 FMappedFileReader::GetFileSize64() const
+{
+	return FileSize;
+}
+
+
 static TArray<FFileWriter*> GFileWriters;
 
 FFileWriter::FFileWriter(const char *Filename, unsigned Options)
@@ -945,23 +1111,22 @@ void appReadCompressedChunk(FArchive &Ar, byte *Buffer, int Size, int Compressio
 	// read header
 	FCompressedChunkHeader ChunkHeader;
 	Ar << ChunkHeader;
-	// prepare buffer for reading compressed data
-	int BufferSize = ChunkHeader.BlockSize * 16;
-	byte *ReadBuffer = (byte*)appMalloc(BufferSize);	// BlockSize is size of uncompressed data
-	// read and decompress data
+	// compute size of compressed data
+	int CompressedSize = 0;
 	for (int BlockIndex = 0; BlockIndex < ChunkHeader.Blocks.Num(); BlockIndex++)
 	{
 		const FCompressedChunkBlock *Block = &ChunkHeader.Blocks[BlockIndex];
-		assert(Block->CompressedSize <= BufferSize);
 		assert(Block->UncompressedSize <= Size);
-		Ar.Serialize(ReadBuffer, Block->CompressedSize);
-		appDecompress(ReadBuffer, Block->CompressedSize, Buffer, Block->UncompressedSize, CompressionFlags);
-		Size   -= Block->UncompressedSize;
-		Buffer += Block->UncompressedSize;
+		CompressedSize += Block->CompressedSize;
+		Size           -= Block->UncompressedSize;
 	}
-	// finalize
 	assert(Size == 0);			// should be comletely read
-	delete ReadBuffer;
+	// read all blocks at once and decompress them
+	byte *ReadBuffer = (byte*)appMalloc(CompressedSize);
+	Ar.Serialize(ReadBuffer, CompressedSize);
+	appDecompressBlocks(ReadBuffer, Buffer, ChunkHeader.Blocks.GetData(), ChunkHeader.Blocks.Num(), CompressionFlags);
+	// finalize
+	appFree(ReadBuffer);
 	unguard;
 }
 
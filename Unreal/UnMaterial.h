@@ -117,6 +117,8 @@ enum ETexturePixelFormat
 struct CPixelFormatInfo
 {
 	unsigned	FourCC;				// 0 when not DDS-compatible
+	uint16		DXGIFormat;			// format for DDS DX10 header, 0 when not supported
+	unsigned	VkFormat;			// format for KTX2 file, 0 when not supported
 	byte		BlockSizeX;
 	byte		BlockSizeY;
 	byte		BytesPerBlock;
@@ -163,6 +165,9 @@ struct CTextureData
 	int						OriginalFormatEnum;		// ETextureFormat or EPixelFormat
 	const UObject			*Obj;					// for error reporting
 	const UPalette			*Palette;				// for TPF_P8
+	// mip selection, should be set before GetTextureData() call; skipped mips are not loaded at all
+	int						SkipMips;				// number of top mip levels to skip
+	int						MaxMipSize;				// skip mips larger than this value, 0 = no limit
 
 	CTextureData()
 	{
@@ -181,7 +186,23 @@ struct CTextureData
 	unsigned GetFourCC() const;
 	bool IsDXT() const;
 
-	byte *Decompress(int MipLevel = 0);				// may return NULL in a case of error
+	// Used by GetTextureData() implementations. The last mip level is never skipped, so
+	// there will be at least one mip when texture has any data.
+	bool ShouldSkipMip(int MipLevel, int USize, int VSize, bool IsLastMip) const
+	{
+		if (IsLastMip) return false;
+		if (MipLevel < SkipMips) return true;
+		return (MaxMipSize > 0 && max(USize, VSize) > MaxMipSize);
+	}
+
+	// Returns RGBA image, or BGRA image when 'BGRA' is true; may return NULL in a case of error
+	byte *Decompress(int MipLevel = 0, bool BGRA = false);
+	// Decode rows [FirstRow, FirstRow+NumRows) of the mip level into 'Dst', which should hold
+	// USize*NumRows pixels. FirstRow should be aligned to block height of the format. Returns
+	// false when data could not be decoded; 'Dst' is filled with white color in this case.
+	bool DecompressRows(int MipLevel, int FirstRow, int NumRows, byte *Dst, bool BGRA = false);
+	// Returns false when the format allows decoding of the whole mip level only
+	bool CanDecompressRows() const;
 
 #if SUPPORT_XBOX360
 	bool DecodeXBox360(int MipLevel);
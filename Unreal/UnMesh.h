@@ -76,6 +76,9 @@ struct FMeshUVHalf
 
 SIMPLE_TYPE(FMeshUVHalf, uint16)
 
+// Convert array of half-precision UVs to floats (batched FMeshUVHalf -> FMeshUVFloat)
+void UnpackHalfUVs(const FMeshUVHalf *Src, FMeshUVFloat *Dst, int Count);
+
 
 //
 //	Bones
@@ -11,6 +11,7 @@
 #include "SkeletalMesh.h"
 #include "StaticMesh.h"
 #include "TypeConvert.h"
+#include "Parallel.h"
 
 
 //#define DEBUG_SKELMESH		1
@@ -53,6 +54,58 @@ float half2float(uint16 h)
 }
 
 
+#define USE_SSE2			1		// use SSE2 for vertex format conversion
+
+#if USE_SSE2
+
+#include <emmintrin.h>
+
+// Convert 4 half values from the lower part of 'h' to floats, exactly as half2float() does:
+// exponent is rebiased by adding (127-15) to it, no special handling for zeros and denormals.
+static FORCEINLINE __m128 HalfToFloat4(__m128i h)
+{
+	h = _mm_unpacklo_epi16(h, _mm_setzero_si128());
+	__m128i sign = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x8000)), 16);
+	__m128i r = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x7FFF)), 13);
+	r = _mm_add_epi32(r, _mm_set1_epi32((127 - 15) << 23));
+	return _mm_castsi128_ps(_mm_or_si128(r, sign));
+}
+
+// Unpack FPackedNormal to float[4], same math as FPackedNormal -> FVector conversion
+static FORCEINLINE __m128 UnpackNormal4(uint32 Data)
+{
+	__m128i r = _mm_cvtsi32_si128(Data);
+	r = _mm_unpacklo_epi8(r, _mm_setzero_si128());
+	r = _mm_unpacklo_epi16(r, _mm_setzero_si128());
+	__m128 f = _mm_div_ps(_mm_cvtepi32_ps(r), _mm_set1_ps(127.5f));
+	return _mm_sub_ps(f, _mm_set1_ps(1.0f));
+}
+
+#endif // USE_SSE2
+
+
+void UnpackHalfUVs(const FMeshUVHalf *Src, FMeshUVFloat *Dst, int Count)
+{
+	int i = 0;
+#if USE_SSE2
+	// 2 UV pairs per iteration
+	for ( ; i + 2 <= Count; i += 2)
+	{
+		__m128i h = _mm_loadl_epi64((const __m128i*)(Src + i));
+		_mm_storeu_ps(&Dst[i].U, HalfToFloat4(h));
+	}
+	if (i < Count)
+	{
+		__m128i h = _mm_cvtsi32_si128(*(const int*)(Src + i));
+		_mm_storel_pi((__m64*)(Dst + i), HalfToFloat4(h));
+		i++;
+	}
+#endif // USE_SSE2
+	for ( ; i < Count; i++)
+		Dst[i] = Src[i];
+}
+
+
 //!! RENAME to CopyNormals/ConvertNormals/PutNormals/RepackNormals etc
 void UnpackNormals(const FPackedNormal SrcNormal[3], CMeshVertex &V)
 {
@@ -64,6 +117,17 @@ void UnpackNormals(const FPackedNormal SrcNormal[3], CMeshVertex &V)
 
 	if (SrcNormal[1].Data != 0)
 	{
+#if USE_SSE2
+		// the same computations as below, in the same order: cross(Normal, Tangent), then dot() with Binormal
+		__m128 Tangent  = UnpackNormal4(SrcNormal[0].Data);
+		__m128 Binormal = UnpackNormal4(SrcNormal[1].Data);
+		__m128 Normal   = UnpackNormal4(SrcNormal[2].Data);
+		__m128 a = _mm_mul_ps(_mm_shuffle_ps(Normal, Normal, _MM_SHUFFLE(3,0,2,1)), _mm_shuffle_ps(Tangent, Tangent, _MM_SHUFFLE(3,1,0,2)));
+		__m128 b = _mm_mul_ps(_mm_shuffle_ps(Normal, Normal, _MM_SHUFFLE(3,1,0,2)), _mm_shuffle_ps(Tangent, Tangent, _MM_SHUFFLE(3,0,2,1)));
+		__m128 p = _mm_mul_ps(Binormal, _mm_sub_ps(a, b));
+		__m128 Sign = _mm_add_ss(_mm_add_ss(p, _mm_shuffle_ps(p, p, _MM_SHUFFLE(1,1,1,1))), _mm_movehl_ps(p, p));
+		V.Normal.SetW(_mm_comigt_ss(Sign, _mm_setzero_ps()) ? 1.0f : -1.0f);
+#else
 		// pack binormal sign into Normal.W
 		FVector Tangent  = SrcNormal[0];
 		FVector Binormal = SrcNormal[1];
@@ -72,6 +136,7 @@ void UnpackNormals(const FPackedNormal SrcNormal[3], CMeshVertex &V)
 		cross(CVT(Normal), CVT(Tangent), ComputedBinormal);
 		float Sign = dot(CVT(Binormal), ComputedBinormal);
 		V.Normal.SetW(Sign > 0 ? 1.0f : -1.0f);
+#endif // USE_SSE2
 	}
 }
 
@@ -666,7 +731,7 @@ struct FGPUVert3Common
 	}
 };
 
-static int GNumGPUUVSets = 1;
+static THREAD_LOCAL int GNumGPUUVSets = 1;			// serialization state, per thread
 
 struct FGPUVert3Half : FGPUVert3Common
 {
@@ -1549,7 +1614,7 @@ struct FStaticLODModel3
 #endif
 		if (Ar.ArVer >= 710)
 		{
-			USkeletalMesh3 *LoadingMesh = (USkeletalMesh3*)UObject::GLoadingObj;
+			USkeletalMesh3 *LoadingMesh = (USkeletalMesh3*)UObject::GetLoadingObj();
 			assert(LoadingMesh);
 			if (LoadingMesh->bHasVertexColors)
 			{
@@ -1924,6 +1989,217 @@ after_skeleton:
 }
 
 
+// Vertex conversion is performed in parallel ranges. All ranges are independent, with exception
+// of chunk lookup, which is performed for the first vertex of the range.
+struct CSkelVertsConvertJob3
+{
+	const FStaticLODModel3 *SrcLod;
+	CSkelMeshLod		*Lod;
+	int					NumTexCoords;
+	bool				UseGpuSkinVerts;
+	volatile int		NumReweightedVerts;
+};
+
+static void ConvertSkelVerts3(CSkelVertsConvertJob3 *Job, int First, int Last)
+{
+	guard(ConvertSkelVerts3);
+
+	const FStaticLODModel3 &SrcLod = *Job->SrcLod;
+	CSkelMeshLod *Lod = Job->Lod;
+	int NumTexCoords = Job->NumTexCoords;
+	int NumUVs = max(NumTexCoords, 1);
+	bool UseGpuSkinVerts = Job->UseGpuSkinVerts;
+
+	// find chunk state for the first vertex: chunks are switched exactly like in the loop below
+	// when started from vertex 0, so vertices from overlapping chunks are assigned identically
+	int chunkIndex = 0;
+	const FSkelMeshChunk3 *C = NULL;
+	int lastChunkVertex = -1;
+	int NextVert = 0;
+	while (true)
+	{
+		int SwitchVert = max(NextVert, lastChunkVertex);
+		if (SwitchVert >= First) break;
+		C = &SrcLod.Chunks[chunkIndex++];
+		lastChunkVertex = C->FirstVertex + C->NumRigidVerts + C->NumSmoothVerts;
+		NextVert = SwitchVert + 1;
+	}
+
+	const FSkeletalMeshVertexBuffer3 &S = SrcLod.GPUSkin;
+	CSkelMeshVertex *D = Lod->Verts + First;
+	int NumReweightedVerts = 0;
+
+	for (int Vert = First; Vert < Last; Vert++, D++)
+	{
+		if (Vert >= lastChunkVertex)
+		{
+			// proceed to next chunk
+			C = &SrcLod.Chunks[chunkIndex++];
+			lastChunkVertex = C->FirstVertex + C->NumRigidVerts + C->NumSmoothVerts;
+		}
+
+		if (UseGpuSkinVerts)
+		{
+			// NOTE: Gears3 has some issues:
+			// - chunk may have FirstVertex set to incorrect value (for recent UE3 versions), which overlaps with the
+			//   previous chunk (FirstVertex=0 for a few chunks)
+			// - index count may be greater than sum of all face counts * 3 from all mesh sections -- this is verified in PSK exporter
+
+			// get vertex from GPU skin
+			const FGPUVert3Common *V;		// has normal and influences, but no UV[] and position
+
+			if (!S.bUseFullPrecisionUVs)
+			{
+				// position
+				const FMeshUVHalf *SUV;
+				if (!S.bUsePackedPosition)
+				{
+					const FGPUVert3Half &V0 = S.VertsHalf[Vert];
+					D->Position = CVT(V0.Pos);
+					V   = &V0;
+					SUV = V0.UV;
+				}
+				else
+				{
+					const FGPUVert3PackedHalf &V0 = S.VertsHalfPacked[Vert];
+					FVector VPos;
+					VPos = V0.Pos.ToVector(S.MeshOrigin, S.MeshExtension);
+					D->Position = CVT(VPos);
+					V   = &V0;
+					SUV = V0.UV;
+				}
+				// UV
+				FMeshUVFloat fUV[MAX_MESH_UV_SETS];
+				UnpackHalfUVs(SUV, fUV, NumUVs);		// convert half->float
+				D->UV = CVT(fUV[0]);
+				for (int TexCoordIndex = 1; TexCoordIndex < NumTexCoords; TexCoordIndex++)
+				{
+					Lod->ExtraUV[TexCoordIndex-1][Vert] = CVT(fUV[TexCoordIndex]);
+				}
+			}
+			else
+			{
+				// position
+				const FMeshUVFloat *SUV;
+				if (!S.bUsePackedPosition)
+				{
+					const FGPUVert3Float &V0 = S.VertsFloat[Vert];
+					V = &V0;
+					D->Position = CVT(V0.Pos);
+					SUV = V0.UV;
+				}
+				else
+				{
+					const FGPUVert3PackedFloat &V0 = S.VertsFloatPacked[Vert];
+					V = &V0;
+					FVector VPos;
+					VPos = V0.Pos.ToVector(S.MeshOrigin, S.MeshExtension);
+					D->Position = CVT(VPos);
+					SUV = V0.UV;
+				}
+				// UV
+				FMeshUVFloat fUV = SUV[0];
+				D->UV = CVT(fUV);
+				for (int TexCoordIndex = 1; TexCoordIndex < NumTexCoords; TexCoordIndex++)
+				{
+					Lod->ExtraUV[TexCoordIndex-1][Vert] = CVT(SUV[TexCoordIndex]);
+				}
+			}
+			// convert Normal[3]
+			UnpackNormals(V->Normal, *D);
+			// convert influences
+			int TotalWeight = 0;
+			int i2 = 0;
+			unsigned PackedWeights = 0;
+			for (int i = 0; i < NUM_INFLUENCES_UE3; i++)
+			{
+				int BoneIndex  = V->BoneIndex[i];
+				byte BoneWeight = V->BoneWeight[i];
+				if (BoneWeight == 0) continue;				// skip this influence (but do not stop the loop!)
+				PackedWeights |= BoneWeight << (i2 * 8);
+				D->Bone[i2]   = C->Bones[BoneIndex];
+				i2++;
+				TotalWeight += BoneWeight;
+			}
+			D->PackedWeights = PackedWeights;
+			if (TotalWeight != 255 && TotalWeight > 0)
+			{
+				NumReweightedVerts++;
+				float WeightScale = 255.0f / TotalWeight;
+				unsigned ScaledWeight = 0;
+				for (int i = 0; i < NUM_INFLUENCES_UE3; i++)
+				{
+					int shift = i * 8;
+					unsigned mask = 0xFF << shift;
+					unsigned w = (PackedWeights & mask) >> shift;
+					w = appRound((float)w * WeightScale);
+					assert(w > 0 && w < 256);
+					ScaledWeight |= w << shift;
+				}
+				D->PackedWeights = ScaledWeight;
+			}
+			if (i2 < NUM_INFLUENCES_UE3) D->Bone[i2] = INDEX_NONE; // mark end of list
+		}
+		else
+		{
+			// old UE3 version without a GPU skin
+			// get vertex from chunk
+			const FMeshUVFloat *SUV;
+			if (Vert < C->FirstVertex + C->NumRigidVerts)
+			{
+				// rigid vertex
+				const FRigidVertex3 &V0 = C->RigidVerts[Vert - C->FirstVertex];
+				// position and normal
+				D->Position = CVT(V0.Pos);
+				UnpackNormals(V0.Normal, *D);
+				// single influence
+				D->PackedWeights = 0xFF;
+				D->Bone[0]   = C->Bones[V0.BoneIndex];
+				SUV = V0.UV;
+			}
+			else
+			{
+				// smooth vertex
+				const FSmoothVertex3 &V0 = C->SmoothVerts[Vert - C->FirstVertex - C->NumRigidVerts];
+				// position and normal
+				D->Position = CVT(V0.Pos);
+				UnpackNormals(V0.Normal, *D);
+				// influences
+//				int TotalWeight = 0;
+				int i2 = 0;
+				unsigned PackedWeights = 0;
+				for (int i = 0; i < NUM_INFLUENCES_UE3; i++)
+				{
+					int BoneIndex  = V0.BoneIndex[i];
+					byte BoneWeight = V0.BoneWeight[i];
+					if (BoneWeight == 0) continue;
+					PackedWeights |= BoneWeight << (i2 * 8);
+					D->Bone[i2]   = C->Bones[BoneIndex];
+					i2++;
+//					TotalWeight += BoneWeight;
+				}
+				D->PackedWeights = PackedWeights;
+//				assert(TotalWeight == 255);
+				if (i2 < NUM_INFLUENCES_UE3) D->Bone[i2] = INDEX_NONE; // mark end of list
+				SUV = V0.UV;
+			}
+			// UV
+			FMeshUVFloat fUV = SUV[0];			// convert half->float
+			D->UV = CVT(fUV);
+			for (int TexCoordIndex = 1; TexCoordIndex < NumTexCoords; TexCoordIndex++)
+			{
+				Lod->ExtraUV[TexCoordIndex-1][Vert] = CVT(SUV[TexCoordIndex]);
+			}
+		}
+	}
+
+	if (NumReweightedVerts)
+		appInterlockedAdd(&Job->NumReweightedVerts, NumReweightedVerts);
+
+	unguard;
+}
+
+
 void USkeletalMesh3::ConvertMesh()
 {
 	guard(USkeletalMesh3::ConvertMesh);
@@ -1998,175 +2274,14 @@ void USkeletalMesh3::ConvertMesh()
 		// allocate the vertices
 		Lod->AllocateVerts(VertexCount);
 
-		int chunkIndex = 0;
-		const FSkelMeshChunk3 *C = NULL;
-		int lastChunkVertex = -1;
-		const FSkeletalMeshVertexBuffer3 &S = SrcLod.GPUSkin;
-		CSkelMeshVertex *D = Lod->Verts;
-		int NumReweightedVerts = 0;
-
-		for (int Vert = 0; Vert < VertexCount; Vert++, D++)
-		{
-			if (Vert >= lastChunkVertex)
-			{
-				// proceed to next chunk
-				C = &SrcLod.Chunks[chunkIndex++];
-				lastChunkVertex = C->FirstVertex + C->NumRigidVerts + C->NumSmoothVerts;
-			}
-
-			if (UseGpuSkinVerts)
-			{
-				// NOTE: Gears3 has some issues:
-				// - chunk may have FirstVertex set to incorrect value (for recent UE3 versions), which overlaps with the
-				//   previous chunk (FirstVertex=0 for a few chunks)
-				// - index count may be greater than sum of all face counts * 3 from all mesh sections -- this is verified in PSK exporter
-
-				// get vertex from GPU skin
-				const FGPUVert3Common *V;		// has normal and influences, but no UV[] and position
-
-				if (!S.bUseFullPrecisionUVs)
-				{
-					// position
-					const FMeshUVHalf *SUV;
-					if (!S.bUsePackedPosition)
-					{
-						const FGPUVert3Half &V0 = S.VertsHalf[Vert];
-						D->Position = CVT(V0.Pos);
-						V   = &V0;
-						SUV = V0.UV;
-					}
-					else
-					{
-						const FGPUVert3PackedHalf &V0 = S.VertsHalfPacked[Vert];
-						FVector VPos;
-						VPos = V0.Pos.ToVector(S.MeshOrigin, S.MeshExtension);
-						D->Position = CVT(VPos);
-						V   = &V0;
-						SUV = V0.UV;
-					}
-					// UV
-					FMeshUVFloat fUV = SUV[0];			// convert half->float
-					D->UV = CVT(fUV);
-					for (int TexCoordIndex = 1; TexCoordIndex < NumTexCoords; TexCoordIndex++)
-					{
-						Lod->ExtraUV[TexCoordIndex-1][Vert] = CVT(SUV[TexCoordIndex]);
-					}
-				}
-				else
-				{
-					// position
-					const FMeshUVFloat *SUV;
-					if (!S.bUsePackedPosition)
-					{
-						const FGPUVert3Float &V0 = S.VertsFloat[Vert];
-						V = &V0;
-						D->Position = CVT(V0.Pos);
-						SUV = V0.UV;
-					}
-					else
-					{
-						const FGPUVert3PackedFloat &V0 = S.VertsFloatPacked[Vert];
-						V = &V0;
-						FVector VPos;
-						VPos = V0.Pos.ToVector(S.MeshOrigin, S.MeshExtension);
-						D->Position = CVT(VPos);
-						SUV = V0.UV;
-					}
-					// UV
-					FMeshUVFloat fUV = SUV[0];
-					D->UV = CVT(fUV);
-					for (int TexCoordIndex = 1; TexCoordIndex < NumTexCoords; TexCoordIndex++)
-					{
-						Lod->ExtraUV[TexCoordIndex-1][Vert] = CVT(SUV[TexCoordIndex]);
-					}
-				}
-				// convert Normal[3]
-				UnpackNormals(V->Normal, *D);
-				// convert influences
-				int TotalWeight = 0;
-				int i2 = 0;
-				unsigned PackedWeights = 0;
-				for (int i = 0; i < NUM_INFLUENCES_UE3; i++)
-				{
-					int BoneIndex  = V->BoneIndex[i];
-					byte BoneWeight = V->BoneWeight[i];
-					if (BoneWeight == 0) continue;				// skip this influence (but do not stop the loop!)
-					PackedWeights |= BoneWeight << (i2 * 8);
-					D->Bone[i2]   = C->Bones[BoneIndex];
-					i2++;
-					TotalWeight += BoneWeight;
-				}
-				D->PackedWeights = PackedWeights;
-				if (TotalWeight != 255 && TotalWeight > 0)
-				{
-					NumReweightedVerts++;
-					float WeightScale = 255.0f / TotalWeight;
-					unsigned ScaledWeight = 0;
-					for (int i = 0; i < NUM_INFLUENCES_UE3; i++)
-					{
-						int shift = i * 8;
-						unsigned mask = 0xFF << shift;
-						unsigned w = (PackedWeights & mask) >> shift;
-						w = appRound((float)w * WeightScale);
-						assert(w > 0 && w < 256);
-						ScaledWeight |= w << shift;
-					}
-					D->PackedWeights = ScaledWeight;
-				}
-				if (i2 < NUM_INFLUENCES_UE3) D->Bone[i2] = INDEX_NONE; // mark end of list
-			}
-			else
-			{
-				// old UE3 version without a GPU skin
-				// get vertex from chunk
-				const FMeshUVFloat *SUV;
-				if (Vert < C->FirstVertex + C->NumRigidVerts)
-				{
-					// rigid vertex
-					const FRigidVertex3 &V0 = C->RigidVerts[Vert - C->FirstVertex];
-					// position and normal
-					D->Position = CVT(V0.Pos);
-					UnpackNormals(V0.Normal, *D);
-					// single influence
-					D->PackedWeights = 0xFF;
-					D->Bone[0]   = C->Bones[V0.BoneIndex];
-					SUV = V0.UV;
-				}
-				else
-				{
-					// smooth vertex
-					const FSmoothVertex3 &V0 = C->SmoothVerts[Vert - C->FirstVertex - C->NumRigidVerts];
-					// position and normal
-					D->Position = CVT(V0.Pos);
-					UnpackNormals(V0.Normal, *D);
-					// influences
-//					int TotalWeight = 0;
-					int i2 = 0;
-					unsigned PackedWeights = 0;
-					for (int i = 0; i < NUM_INFLUENCES_UE3; i++)
-					{
-						int BoneIndex  = V0.BoneIndex[i];
-						byte BoneWeight = V0.BoneWeight[i];
-						if (BoneWeight == 0) continue;
-						PackedWeights |= BoneWeight << (i2 * 8);
-						D->Bone[i2]   = C->Bones[BoneIndex];
-						i2++;
-//						TotalWeight += BoneWeight;
-					}
-					D->PackedWeights = PackedWeights;
-//					assert(TotalWeight == 255);
-					if (i2 < NUM_INFLUENCES_UE3) D->Bone[i2] = INDEX_NONE; // mark end of list
-					SUV = V0.UV;
-				}
-				// UV
-				FMeshUVFloat fUV = SUV[0];			// convert half->float
-				D->UV = CVT(fUV);
-				for (int TexCoordIndex = 1; TexCoordIndex < NumTexCoords; TexCoordIndex++)
-				{
-					Lod->ExtraUV[TexCoordIndex-1][Vert] = CVT(SUV[TexCoordIndex]);
-				}
-			}
-		}
+		CSkelVertsConvertJob3 Job;
+		Job.SrcLod             = &SrcLod;
+		Job.Lod                = Lod;
+		Job.NumTexCoords       = NumTexCoords;
+		Job.UseGpuSkinVerts    = UseGpuSkinVerts;
+		Job.NumReweightedVerts = 0;
+		appParallelFor(VertexCount, 4096, ConvertSkelVerts3, &Job);
+		int NumReweightedVerts = Job.NumReweightedVerts;
 
 		if (NumReweightedVerts > 0)
 			appPrintf("LOD %d: udjusted weights for %d vertices\n", lod, NumReweightedVerts);
@@ -2623,9 +2738,10 @@ struct FStaticMeshVertexStream3
 };
 
 
-static int  GNumStaticUVSets    = 1;
-static bool GUseStaticFloatUVs  = true;
-static bool GStripStaticNormals = false;
+// serialization state, per thread
+static THREAD_LOCAL int  GNumStaticUVSets    = 1;
+static THREAD_LOCAL bool GUseStaticFloatUVs  = true;
+static THREAD_LOCAL bool GStripStaticNormals = false;
 
 struct FStaticMeshUVItem3
 {
@@ -3713,6 +3829,38 @@ done:
 	unguard;
 }
 
+struct CStaticVertsConvertJob3
+{
+	const FStaticMeshLODModel3 *SrcLod;
+	CStaticMeshLod		*Lod;
+	int					NumTexCoords;
+};
+
+static void ConvertStaticVerts3(CStaticVertsConvertJob3 *Job, int First, int Last)
+{
+	const FStaticMeshLODModel3 &SrcLod = *Job->SrcLod;
+	CStaticMeshLod *Lod = Job->Lod;
+	int NumTexCoords = Job->NumTexCoords;
+
+	for (int i = First; i < Last; i++)
+	{
+		const FStaticMeshUVItem3 &SUV = SrcLod.UVStream.UV[i];
+		CStaticMeshVertex &V = Lod->Verts[i];
+
+		V.Position = CVT(SrcLod.VertexStream.Verts[i]);
+		UnpackNormals(SUV.Normal, V);
+		// copy UV
+		const FMeshUVFloat* fUV = &SUV.UV[0];
+		V.UV = *CVT(fUV);
+		for (int TexCoordIndex = 1; TexCoordIndex < NumTexCoords; TexCoordIndex++)
+		{
+			fUV++;
+			Lod->ExtraUV[TexCoordIndex-1][i] = *CVT(fUV);
+		}
+		//!! also has ColorStream
+	}
+}
+
 // convert UStaticMesh3 to CStaticMesh
 void UStaticMesh3::ConvertMesh()
 {
@@ -3771,23 +3919,11 @@ void UStaticMesh3::ConvertMesh()
 
 		// vertices
 		Lod->AllocateVerts(NumVerts);
-		for (int i = 0; i < NumVerts; i++)
-		{
-			const FStaticMeshUVItem3 &SUV = SrcLod.UVStream.UV[i];
-			CStaticMeshVertex &V = Lod->Verts[i];
-
-			V.Position = CVT(SrcLod.VertexStream.Verts[i]);
-			UnpackNormals(SUV.Normal, V);
-			// copy UV
-			const FMeshUVFloat* fUV = &SUV.UV[0];
-			V.UV = *CVT(fUV);
-			for (int TexCoordIndex = 1; TexCoordIndex < NumTexCoords; TexCoordIndex++)
-			{
-				fUV++;
-				Lod->ExtraUV[TexCoordIndex-1][i] = *CVT(fUV);
-			}
-			//!! also has ColorStream
-		}
+		CStaticVertsConvertJob3 Job;
+		Job.SrcLod       = &SrcLod;
+		Job.Lod          = Lod;
+		Job.NumTexCoords = NumTexCoords;
+		appParallelFor(NumVerts, 4096, ConvertStaticVerts3, &Job);
 
 		// indices
 		Lod->Indices.Initialize(&SrcLod.Indices.Indices);			// 16-bit only
@@ -11,6 +11,7 @@
 #include "SkeletalMesh.h"
 #include "StaticMesh.h"
 #include "TypeConvert.h"
+#include "Parallel.h"
 
 
 //#define DEBUG_SKELMESH		1
@@ -342,8 +343,9 @@ struct FSkelMeshChunk4
 	}
 };
 
-static int GNumSkelUVSets = 1;
-static int GNumSkelInfluences = 4;
+// serialization state, per thread
+static THREAD_LOCAL int GNumSkelUVSets = 1;
+static THREAD_LOCAL int GNumSkelInfluences = 4;
 
 struct FGPUVert4Common
 {
@@ -584,7 +586,7 @@ struct FStaticLODModel4
 			DBG_SKEL("TexCoords=%d\n", Lod.NumTexCoords);
 			Ar << Lod.VertexBufferGPUSkin;
 
-			USkeletalMesh4 *LoadingMesh = (USkeletalMesh4*)UObject::GLoadingObj;
+			USkeletalMesh4 *LoadingMesh = (USkeletalMesh4*)UObject::GetLoadingObj();
 			assert(LoadingMesh);
 			if (LoadingMesh->bHasVertexColors)
 			{
@@ -662,6 +664,108 @@ void USkeletalMesh4::Serialize(FArchive &Ar)
 }
 
 
+// Vertex conversion is performed in parallel ranges, see ConvertSkelVerts3() for details
+struct CSkelVertsConvertJob4
+{
+	const FStaticLODModel4 *SrcLod;
+	CSkelMeshLod		*Lod;
+	int					NumTexCoords;
+};
+
+static void ConvertSkelVerts4(CSkelVertsConvertJob4 *Job, int First, int Last)
+{
+	guard(ConvertSkelVerts4);
+
+	const FStaticLODModel4 &SrcLod = *Job->SrcLod;
+	CSkelMeshLod *Lod = Job->Lod;
+	int NumTexCoords = Job->NumTexCoords;
+	int NumUVs = max(NumTexCoords, 1);
+
+	// find chunk state for the first vertex, the same way as it would be done by the loop below
+	int chunkIndex = 0;
+	const FSkelMeshChunk4 *C = NULL;
+	int lastChunkVertex = -1;
+	int NextVert = 0;
+	while (true)
+	{
+		int SwitchVert = max(NextVert, lastChunkVertex);
+		if (SwitchVert >= First) break;
+		C = &SrcLod.Chunks[chunkIndex++];
+		lastChunkVertex = C->BaseVertexIndex + C->NumRigidVertices + C->NumSoftVertices;
+		NextVert = SwitchVert + 1;
+	}
+
+	const FSkeletalMeshVertexBuffer4 &S = SrcLod.VertexBufferGPUSkin;
+	CSkelMeshVertex *D = Lod->Verts + First;
+
+	for (int Vert = First; Vert < Last; Vert++, D++)
+	{
+		if (Vert >= lastChunkVertex)
+		{
+			// proceed to next chunk
+			C = &SrcLod.Chunks[chunkIndex++];
+			lastChunkVertex = C->BaseVertexIndex + C->NumRigidVertices + C->NumSoftVertices;
+		}
+
+		// get vertex from GPU skin
+		const FGPUVert4Common *V;		// has normal and influences, but no UV[] and position
+
+		if (!S.bUseFullPrecisionUVs)
+		{
+			const FMeshUVHalf *SUV;
+			const FGPUVert4Half &V0 = S.VertsHalf[Vert];
+			D->Position = CVT(V0.Pos);
+			V = &V0;
+			SUV = V0.UV;
+			// UV
+			FMeshUVFloat fUV[MAX_MESH_UV_SETS];
+			UnpackHalfUVs(SUV, fUV, NumUVs);		// convert half->float
+			D->UV = CVT(fUV[0]);
+			for (int TexCoordIndex = 1; TexCoordIndex < NumTexCoords; TexCoordIndex++)
+			{
+				Lod->ExtraUV[TexCoordIndex-1][Vert] = CVT(fUV[TexCoordIndex]);
+			}
+		}
+		else
+		{
+			const FMeshUVFloat *SUV;
+			const FGPUVert4Float &V0 = S.VertsFloat[Vert];
+			V = &V0;
+			D->Position = CVT(V0.Pos);
+			SUV = V0.UV;
+			// UV
+			FMeshUVFloat fUV = SUV[0];
+			D->UV = CVT(fUV);
+			for (int TexCoordIndex = 1; TexCoordIndex < NumTexCoords; TexCoordIndex++)
+			{
+				Lod->ExtraUV[TexCoordIndex-1][Vert] = CVT(SUV[TexCoordIndex]);
+			}
+		}
+		// convert Normal[3]
+		UnpackNormals(V->Normal, *D);
+		// convert influences
+//		int TotalWeight = 0;
+		int i2 = 0;
+		unsigned PackedWeights = 0;
+		for (int i = 0; i < NUM_INFLUENCES_UE4; i++)
+		{
+			int BoneIndex  = V->BoneIndex[i];
+			byte BoneWeight = V->BoneWeight[i];
+			if (BoneWeight == 0) continue;				// skip this influence (but do not stop the loop!)
+			PackedWeights |= BoneWeight << (i2 * 8);
+			D->Bone[i2]   = C->BoneMap[BoneIndex];
+			i2++;
+//			TotalWeight += BoneWeight;
+		}
+		D->PackedWeights = PackedWeights;
+//		assert(TotalWeight == 255);
+		if (i2 < NUM_INFLUENCES_UE4) D->Bone[i2] = INDEX_NONE; // mark end of list
+	}
+
+	unguard;
+}
+
+
 void USkeletalMesh4::ConvertMesh()
 {
 	guard(USkeletalMesh4::ConvertMesh);
@@ -708,74 +812,11 @@ void USkeletalMesh4::ConvertMesh()
 		// allocate the vertices
 		Lod->AllocateVerts(VertexCount);
 
-		int chunkIndex = 0;
-		const FSkelMeshChunk4 *C = NULL;
-		int lastChunkVertex = -1;
-		const FSkeletalMeshVertexBuffer4 &S = SrcLod.VertexBufferGPUSkin;
-		CSkelMeshVertex *D = Lod->Verts;
-
-		for (int Vert = 0; Vert < VertexCount; Vert++, D++)
-		{
-			if (Vert >= lastChunkVertex)
-			{
-				// proceed to next chunk
-				C = &SrcLod.Chunks[chunkIndex++];
-				lastChunkVertex = C->BaseVertexIndex + C->NumRigidVertices + C->NumSoftVertices;
-			}
-
-			// get vertex from GPU skin
-			const FGPUVert4Common *V;		// has normal and influences, but no UV[] and position
-
-			if (!S.bUseFullPrecisionUVs)
-			{
-				const FMeshUVHalf *SUV;
-				const FGPUVert4Half &V0 = S.VertsHalf[Vert];
-				D->Position = CVT(V0.Pos);
-				V = &V0;
-				SUV = V0.UV;
-				// UV
-				FMeshUVFloat fUV = SUV[0];				// convert half->float
-				D->UV = CVT(fUV);
-				for (int TexCoordIndex = 1; TexCoordIndex < NumTexCoords; TexCoordIndex++)
-				{
-					Lod->ExtraUV[TexCoordIndex-1][Vert] = CVT(SUV[TexCoordIndex]);
-				}
-			}
-			else
-			{
-				const FMeshUVFloat *SUV;
-				const FGPUVert4Float &V0 = S.VertsFloat[Vert];
-				V = &V0;
-				D->Position = CVT(V0.Pos);
-				SUV = V0.UV;
-				// UV
-				FMeshUVFloat fUV = SUV[0];
-				D->UV = CVT(fUV);
-				for (int TexCoordIndex = 1; TexCoordIndex < NumTexCoords; TexCoordIndex++)
-				{
-					Lod->ExtraUV[TexCoordIndex-1][Vert] = CVT(SUV[TexCoordIndex]);
-				}
-			}
-			// convert Normal[3]
-			UnpackNormals(V->Normal, *D);
-			// convert influences
-//			int TotalWeight = 0;
-			int i2 = 0;
-			unsigned PackedWeights = 0;
-			for (int i = 0; i < NUM_INFLUENCES_UE4; i++)
-			{
-				int BoneIndex  = V->BoneIndex[i];
-				byte BoneWeight = V->BoneWeight[i];
-				if (BoneWeight == 0) continue;				// skip this influence (but do not stop the loop!)
-				PackedWeights |= BoneWeight << (i2 * 8);
-				D->Bone[i2]   = C->BoneMap[BoneIndex];
-				i2++;
-//				TotalWeight += BoneWeight;
-			}
-			D->PackedWeights = PackedWeights;
-//			assert(TotalWeight == 255);
-			if (i2 < NUM_INFLUENCES_UE4) D->Bone[i2] = INDEX_NONE; // mark end of list
-		}
+		CSkelVertsConvertJob4 Job;
+		Job.SrcLod       = &SrcLod;
+		Job.Lod          = Lod;
+		Job.NumTexCoords = NumTexCoords;
+		appParallelFor(VertexCount, 4096, ConvertSkelVerts4, &Job);
 
 		unguard;	// ProcessVerts
 
@@ -924,8 +965,9 @@ struct FPositionVertexBuffer4
 };
 
 
-static int  GNumStaticUVSets   = 1;
-static bool GUseStaticFloatUVs = true;
+// serialization state, per thread
+static THREAD_LOCAL int  GNumStaticUVSets   = 1;
+static THREAD_LOCAL bool GUseStaticFloatUVs = true;
 
 struct FStaticMeshUVItem4
 {
@@ -1046,7 +1088,7 @@ struct FRawStaticIndexBuffer4
 				byte* src = &data[0];
 				if (Ar.ReverseBytes)
 					appReverseBytes(src, count, 4);
-				S.Indices32.AddUninitialized(count);
+				S.Indices32.AddNoInit(count);
 				for (int i = 0; i < count; i++, src += 4)
 					S.Indices32[i] = *(int*)src;
 			}
@@ -1056,7 +1098,7 @@ struct FRawStaticIndexBuffer4
 				byte* src = &data[0];
 				if (Ar.ReverseBytes)
 					appReverseBytes(src, count, 2);
-				S.Indices16.AddUninitialized(count);
+				S.Indices16.AddNoInit(count);
 				for (int i = 0; i < count; i++, src += 2)
 					S.Indices16[i] = *(uint16*)src;
 			}
@@ -1274,6 +1316,39 @@ void UStaticMesh4::Serialize(FArchive &Ar)
 }
 
 
+struct CStaticVertsConvertJob4
+{
+	const FStaticMeshLODModel4 *SrcLod;
+	CStaticMeshLod		*Lod;
+	int					NumTexCoords;
+};
+
+static void ConvertStaticVerts4(CStaticVertsConvertJob4 *Job, int First, int Last)
+{
+	const FStaticMeshLODModel4 &SrcLod = *Job->SrcLod;
+	CStaticMeshLod *Lod = Job->Lod;
+	int NumTexCoords = Job->NumTexCoords;
+
+	for (int i = First; i < Last; i++)
+	{
+		const FStaticMeshUVItem4 &SUV = SrcLod.VertexBuffer.UV[i];
+		CStaticMeshVertex &V = Lod->Verts[i];
+
+		V.Position = CVT(SrcLod.PositionVertexBuffer.Verts[i]);
+		UnpackNormals(SUV.Normal, V);
+		// copy UV
+		const FMeshUVFloat* fUV = &SUV.UV[0];
+		V.UV = *CVT(fUV);
+		for (int TexCoordIndex = 1; TexCoordIndex < NumTexCoords; TexCoordIndex++)
+		{
+			fUV++;
+			Lod->ExtraUV[TexCoordIndex-1][i] = *CVT(fUV);
+		}
+		//!! also has ColorStream
+	}
+}
+
+
 void UStaticMesh4::ConvertMesh()
 {
 	guard(UStaticMesh4::ConvertMesh);
@@ -1319,23 +1394,11 @@ void UStaticMesh4::ConvertMesh()
 
 		// vertices
 		Lod->AllocateVerts(NumVerts);
-		for (int i = 0; i < NumVerts; i++)
-		{
-			const FStaticMeshUVItem4 &SUV = SrcLod.VertexBuffer.UV[i];
-			CStaticMeshVertex &V = Lod->Verts[i];
-
-			V.Position = CVT(SrcLod.PositionVertexBuffer.Verts[i]);
-			UnpackNormals(SUV.Normal, V);
-			// copy UV
-			const FMeshUVFloat* fUV = &SUV.UV[0];
-			V.UV = *CVT(fUV);
-			for (int TexCoordIndex = 1; TexCoordIndex < NumTexCoords; TexCoordIndex++)
-			{
-				fUV++;
-				Lod->ExtraUV[TexCoordIndex-1][i] = *CVT(fUV);
-			}
-			//!! also has ColorStream
-		}
+		CStaticVertsConvertJob4 Job;
+		Job.SrcLod       = &SrcLod;
+		Job.Lod          = Lod;
+		Job.NumTexCoords = NumTexCoords;
+		appParallelFor(NumVerts, 4096, ConvertStaticVerts4, &Job);
 
 		// indices
 		Lod->Indices.Initialize(&SrcLod.IndexBuffer.Indices16, &SrcLod.IndexBuffer.Indices32);
@@ -1504,7 +1567,7 @@ void UStaticMesh4::ConvertSourceModels()
 
 		// indices
 		TArray<unsigned>& Indices32 = Lod->Indices.Indices32;
-		Indices32.AddUninitialized(NumVerts);
+		Indices32.AddNoInit(NumVerts);
 		for (int i = 0; i < NumVerts; i++)
 			Indices32[i] = i;
 
@@ -636,7 +636,7 @@ void USkeletalMesh::PostLoadBioshockMesh()
 		for (i = 0; i < Skel->m_numBones; i++)
 		{
 			FMeshBone &B = RefSkeleton[i];
-			B.Name.Str    = Skel->m_bones[i]->m_name;				//?? hack: FName assignment
+			B.Name        = Skel->m_bones[i]->m_name;
 			B.ParentIndex = max(Skel->m_parentIndices[i], 0);
 			const hkQsTransform &t = Skel->m_referencePose[i];
 			B.BonePos.Orientation = (FQuat&)   t.m_rotation;
@@ -656,7 +656,7 @@ void USkeletalMesh::PostLoadBioshockMesh()
 		for (i = 0; i < Skel->m_numBones; i++)
 		{
 			FMeshBone &B = RefSkeleton[i];
-			B.Name.Str    = Skel->m_bones[i]->m_name;				//?? hack: FName assignment
+			B.Name        = Skel->m_bones[i]->m_name;
 			B.ParentIndex = max(Skel->m_parentIndices[i], 0);
 			const hkQsTransform &t = Skel->m_referencePose[i];
 			B.BonePos.Orientation = (FQuat&)   t.m_rotation;
@@ -3,6 +3,8 @@
 #include "UnObject.h"
 #include "UnPackage.h"
 
+#include "Parallel.h"				// CMutex, CSpinLock
+
 
 //#define DEBUG_PROPS				1
 //#define PROFILE_LOADING			1
@@ -25,8 +27,17 @@ UObject::UObject()
 UObject::~UObject()
 {
 //	appPrintf("deleting %s (%p) - package %s, index %d\n", Name, this, Package ? Package->Name : "None", PackageIndex);
-	// remove self from GObjObjects
-	GObjObjects.RemoveSingle(this);
+	LockObjects();
+	// remove self from GObjObjects; search from the end, because objects are usually destroyed
+	// in reverse order
+	for (int i = GObjObjects.Num() - 1; i >= 0; i--)
+	{
+		if (GObjObjects[i] == this)
+		{
+			GObjObjects.RemoveAt(i);
+			break;
+		}
+	}
 	// remove self from package export table
 	// note: we using PackageIndex==INDEX_NONE when creating dummy object, not exported from
 	// any package, but which still belongs to this package (for example check Rune's
@@ -38,6 +49,7 @@ UObject::~UObject()
 		Exp.Object = NULL;
 		Package = NULL;
 	}
+	UnlockObjects();
 }
 
 
@@ -107,40 +119,244 @@ int UObject::GetLicenseeVer() const
 	UObject loading from package
 -----------------------------------------------------------------------------*/
 
-int              UObject::GObjBeginLoadCount = 0;
-TArray<UObject*> UObject::GObjLoaded;
 TArray<UObject*> UObject::GObjObjects;
-UObject         *UObject::GLoadingObj = NULL;
+
+static CLoadingContext GMainLoadingContext;
+static THREAD_LOCAL CLoadingContext* GLoadingContext;
+static CMutex ObjectsLock;
+
+static bool GDeferPostLoad = false;
+static TArray<UObject*> GDeferredPostLoad;		// protected with ObjectsLock
+
+
+CLoadingContext& UObject::GetLoadingContext()
+{
+	CLoadingContext* Context = GLoadingContext;
+	if (!Context)
+	{
+		// the first thread which is loading something uses static context, other threads
+		// are allocating own context which lives until the end of the program (worker
+		// threads are never destroyed)
+		static volatile int MainContextUsed = 0;
+		if (appInterlockedCompareExchange(&MainContextUsed, 1, 0) == 0)
+			Context = &GMainLoadingContext;
+		else
+			Context = new CLoadingContext;
+		GLoadingContext = Context;
+		// release locks held by this thread when loading fails inside appParallelFor()
+		GParallelErrorCleanup = ResetLoadingContext;
+	}
+	return *Context;
+}
+
+
+// Memory arena of the package which object is serialized is suspended while objects are locked:
+// shared tables, and packages loaded by imports, should not live in this arena.
+void UObject::LockObjects()
+{
+	CLoadingContext& Context = GetLoadingContext();
+	if (Context.LockCount++ == 0)
+	{
+		ObjectsLock.Lock();
+		Context.SavedArena = appSetThreadArena(NULL);
+	}
+}
+
+void UObject::UnlockObjects()
+{
+	CLoadingContext& Context = GetLoadingContext();
+	assert(Context.LockCount > 0);
+	if (--Context.LockCount == 0)
+	{
+		appSetThreadArena(Context.SavedArena);
+		Context.SavedArena = NULL;
+		ObjectsLock.Unlock();
+	}
+}
+
+
+void UObject::ResetLoadingContext()
+{
+	if (!GLoadingContext) return;		// this thread never loaded anything
+	CLoadingContext& Context = *GLoadingContext;
+	if (Context.LockedPackage)
+	{
+		Context.LockedPackage->ReaderLock.Unlock();
+		Context.LockedPackage = NULL;
+	}
+	if (Context.LockCount)
+	{
+		Context.LockCount = 0;
+		ObjectsLock.Unlock();
+	}
+	Context.SavedArena = NULL;
+	appSetThreadArena(NULL);
+	Context.BeginLoadCount = 0;
+	Context.ObjLoaded.Empty();
+	Context.LoadingObj = NULL;
+	Context.UsedPackages.Empty();
+	appSetNotifyHeader(NULL);
+}
 
 
 void UObject::BeginLoad()
 {
-	assert(GObjBeginLoadCount >= 0);
-	GObjBeginLoadCount++;
+	CLoadingContext& Context = GetLoadingContext();
+	assert(Context.BeginLoadCount >= 0);
+	Context.BeginLoadCount++;
+}
+
+
+// Load scheduler: objects are serialized grouped by package, in order of their location in
+// the package file (export's SerialOffset). Packages are processed in order of discovery of
+// their first object. Loading is performed by sweeps over all packages: objects discovered
+// while loading, which are located after the current read position, are merged into the
+// current sweep, other ones are deferred to the next sweep. So loading of the whole package
+// becomes a sequential pass over file.
+
+struct CLoadQueueItem
+{
+	int				PackageRank;			// index of the package in discovery order
+	int				SerialOffset;
+	UObject			*Obj;
+};
+
+static int CompareLoadQueueItems(const CLoadQueueItem &A, const CLoadQueueItem &B)
+{
+	if (A.PackageRank != B.PackageRank)
+		return A.PackageRank - B.PackageRank;
+	if (A.SerialOffset != B.SerialOffset)
+		return A.SerialOffset < B.SerialOffset ? -1 : 1;
+	return A.Obj->PackageIndex - B.Obj->PackageIndex;
 }
 
+class CLoadScheduler
+{
+public:
+	CLoadScheduler()
+	:	Current(0)
+	,	HasPosition(false)
+	{}
+
+	void Add(UObject *Obj)
+	{
+		CLoadQueueItem Item;
+		Item.PackageRank  = GetPackageRank(Obj->Package);
+		Item.SerialOffset = Obj->Package->GetExport(Obj->PackageIndex).SerialOffset;
+		Item.Obj          = Obj;
+		// objects located before the current position will wait for the next sweep
+		int Sweep = Current;
+		if (HasPosition && CompareLoadQueueItems(Item, Position) <= 0)
+			Sweep ^= 1;
+		HeapPush(Sweeps[Sweep], Item);
+	}
+
+	UObject *GetNext()
+	{
+		if (!Sweeps[Current].Num())
+		{
+			// start the next sweep
+			Current ^= 1;
+			if (!Sweeps[Current].Num()) return NULL;
+		}
+		Position    = HeapPop(Sweeps[Current]);
+		HasPosition = true;
+		return Position.Obj;
+	}
+
+protected:
+	TArray<CLoadQueueItem> Sweeps[2];		// binary heaps, smallest item first
+	int				Current;
+	CLoadQueueItem	Position;				// last returned item
+	bool			HasPosition;
+	TArray<UnPackage*> Packages;			// packages in order of discovery
+
+	int GetPackageRank(UnPackage *Package)
+	{
+		// objects are usually discovered in series from the same package, check the last one first
+		int Rank = Packages.Num() - 1;
+		if (Rank >= 0 && Packages[Rank] == Package)
+			return Rank;
+		Rank = Packages.FindItem(Package);
+		if (Rank < 0)
+			Rank = Packages.Add(Package);
+		return Rank;
+	}
+
+	static void HeapPush(TArray<CLoadQueueItem> &Heap, const CLoadQueueItem &Item)
+	{
+		int i = Heap.Add(Item);
+		while (i > 0)
+		{
+			int Parent = (i - 1) / 2;
+			if (CompareLoadQueueItems(Heap[Parent], Item) <= 0) break;
+			Heap[i] = Heap[Parent];
+			i = Parent;
+		}
+		Heap[i] = Item;
+	}
+
+	static CLoadQueueItem HeapPop(TArray<CLoadQueueItem> &Heap)
+	{
+		CLoadQueueItem Top = Heap[0];
+		CLoadQueueItem Last = Heap[Heap.Num() - 1];
+		Heap.RemoveAt(Heap.Num() - 1);
+		int Count = Heap.Num();
+		if (Count)
+		{
+			// sift 'Last' down from the root
+			int i = 0;
+			while (true)
+			{
+				int Child = i * 2 + 1;
+				if (Child >= Count) break;
+				if (Child + 1 < Count && CompareLoadQueueItems(Heap[Child + 1], Heap[Child]) < 0)
+					Child++;
+				if (CompareLoadQueueItems(Last, Heap[Child]) <= 0) break;
+				Heap[i] = Heap[Child];
+				i = Child;
+			}
+			Heap[i] = Last;
+		}
+		return Top;
+	}
+};
+
 
 void UObject::EndLoad()
 {
-	assert(GObjBeginLoadCount > 0);
-	if (GObjBeginLoadCount > 1)
+	CLoadingContext& Context = GetLoadingContext();
+	assert(Context.BeginLoadCount > 0);
+	if (Context.BeginLoadCount > 1)
 	{
-		GObjBeginLoadCount--;
+		Context.BeginLoadCount--;
 		return;
 	}
 
 	guard(UObject::EndLoad);
 
-	// process GObjLoaded array
-	// NOTE: while loading one array element, array may grow!
+	// process ObjLoaded array
+	// NOTE: while loading one object, new objects are added to ObjLoaded; pass them to the scheduler.
+	// PostLoad() is called in order of object discovery, regardless of order of serialization.
 	TArray<UObject*> LoadedObjects;
-	while (GObjLoaded.Num())
+	CLoadScheduler Scheduler;
+	while (true)
 	{
-		UObject *Obj = GObjLoaded[0];
-		GObjLoaded.RemoveAt(0);
-		//!! should sort by packages + package offset
+		for (int i = 0; i < Context.ObjLoaded.Num(); i++)
+		{
+			Scheduler.Add(Context.ObjLoaded[i]);
+			LoadedObjects.Add(Context.ObjLoaded[i]);
+		}
+		Context.ObjLoaded.Reset();
+		UObject *Obj = Scheduler.GetNext();
+		if (!Obj) break;
 		UnPackage *Package = Obj->Package;
 		guard(LoadObject);
+		// lock package reader, it could be used by other threads too
+		Package->ReaderLock.Lock();
+		Context.LockedPackage = Package;
+		if (Context.UsedPackages.FindItem(Package) < 0)
+			Context.UsedPackages.Add(Package);
 		Package->SetupReader(Obj->PackageIndex);
 		appPrintf("Loading %s %s from package %s\n", Obj->GetClassName(), Obj->Name, Package->Filename);
 		// setup NotifyInfo to describe object
@@ -148,9 +364,12 @@ void UObject::EndLoad()
 #if PROFILE_LOADING
 		appResetProfiler();
 #endif
-		GLoadingObj = Obj;
+		Context.LoadingObj = Obj;
+		// serialized arrays are allocated in package's arena
+		appSetThreadArena(Package->ObjectMem);
 		Obj->Serialize(*Package);
-		GLoadingObj = NULL;
+		appSetThreadArena(NULL);
+		Context.LoadingObj = NULL;
 #if PROFILE_LOADING
 		appPrintProfiler();
 #endif
@@ -159,7 +378,8 @@ void UObject::EndLoad()
 			appError("%s::Serialize(%s): %d unread bytes",
 				Obj->GetClassName(), Obj->Name,
 				Package->GetStopper() - Package->Tell());
-		LoadedObjects.Add(Obj);
+		Context.LockedPackage = NULL;
+		Package->ReaderLock.Unlock();
 
 #if UNREAL4
 	#define UNVERS_STR		(Package->Game >= GAME_UE4 && Package->Summary.IsUnversioned) ? " (unversioned)" : ""
@@ -172,18 +392,67 @@ void UObject::EndLoad()
 	}
 	// postload objects
 	int i;
-	guard(PostLoad);
-	for (i = 0; i < LoadedObjects.Num(); i++)
-		LoadedObjects[i]->PostLoad();
-	unguardf("%s", LoadedObjects[i]->Name);
+	if (GDeferPostLoad)
+	{
+		LockObjects();
+		for (i = 0; i < LoadedObjects.Num(); i++)
+			GDeferredPostLoad.Add(LoadedObjects[i]);
+		UnlockObjects();
+	}
+	else
+	{
+		guard(PostLoad);
+		for (i = 0; i < LoadedObjects.Num(); i++)
+			LoadedObjects[i]->PostLoad();
+		unguardf("%s", LoadedObjects[i]->Name);
+	}
 	// cleanup
-	GObjLoaded.Empty();
-	GObjBeginLoadCount--;		// decrement after loading
+	Context.ObjLoaded.Empty();
+	Context.BeginLoadCount--;	// decrement after loading
 	appSetNotifyHeader(NULL);
-	assert(GObjBeginLoadCount == 0);
+	assert(Context.BeginLoadCount == 0);
+
+	// close file handles opened by this thread
+	for (i = 0; i < Context.UsedPackages.Num(); i++)
+	{
+		UnPackage *Package = Context.UsedPackages[i];
+		Package->ReaderLock.Lock();
+		Package->CloseReader();
+		Package->ReaderLock.Unlock();
+	}
+	Context.UsedPackages.Empty();
+
+	unguard;
+}
 
-	// close all opened file handles
-	UnPackage::CloseAllReaders();
+
+void UObject::BeginDeferredPostLoad()
+{
+	assert(!GDeferPostLoad);
+	GDeferredPostLoad.Empty();
+	GDeferPostLoad = true;
+}
+
+void UObject::EndDeferredPostLoad(bool DoPostLoad)
+{
+	guard(UObject::EndDeferredPostLoad);
+
+	assert(GDeferPostLoad);
+	GDeferPostLoad = false;
+	if (DoPostLoad)
+	{
+		// call PostLoad() in the same environment as EndLoad() does
+		CLoadingContext& Context = GetLoadingContext();
+		Context.BeginLoadCount++;
+		int i;
+		guard(PostLoad);
+		for (i = 0; i < GDeferredPostLoad.Num(); i++)
+			GDeferredPostLoad[i]->PostLoad();
+		unguardf("%s", GDeferredPostLoad[i]->Name);
+		Context.ObjLoaded.Empty();
+		Context.BeginLoadCount--;
+	}
+	GDeferredPostLoad.Empty();
 
 	unguard;
 }
@@ -368,7 +637,7 @@ struct FPropertyTag
 				Ar << Object;
 				if (!Object)
 				{
-					Tag.Name.Str = "None";
+					Tag.Name = "None";
 					return Ar;
 				}
 				// now, should continue serialization, skipping Name serialization (not implemented right now, so - appError)
@@ -552,7 +821,7 @@ struct FPropertyTagBat2
 		{
 		simple_prop:
 			// property serialized by offset
-			Tag.PropertyName.Str = "None";
+			Tag.PropertyName = "None";
 			Tag.DataSize = Tag.ArrayIndex = 0;
 			return Ar;
 		}
@@ -684,7 +953,7 @@ static bool FindPropBat2(const CTypeInfo *StrucType, const FPropertyTagBat2 &Tag
 
 	// prepare Tag
 	Tag.Type       = TagBat.Type;
-	Tag.Name.Str   = "unk";
+	Tag.Name       = "unk";
 	Tag.DataSize   = 0;			// unset
 	Tag.ArrayIndex = 0;
 
@@ -719,7 +988,7 @@ static bool FindPropBat2(const CTypeInfo *StrucType, const FPropertyTagBat2 &Tag
 			if (p->Offset == TagBat.Offset)
 			{
 				// found it
-				Tag.Name.Str   = p->Name;
+				Tag.Name       = p->Name;
 				Tag.Type       = TagBat.Type;
 				Tag.DataSize   = 0;			// unset
 				Tag.ArrayIndex = 0;
@@ -871,7 +1140,7 @@ void CTypeInfo::SerializeProps(FArchive &Ar, void *ObjectData) const
 			}
 			else
 			{
-				static byte Dummy[16];
+				byte Dummy[16];					// local: properties could be serialized by different threads
 				byte *value = Dummy;
 				const int ArrayIndex = 0; // used in PROP macro
 				if (FindPropBat2(this, TagBat, Tag, Ar.Game))
@@ -1211,7 +1480,7 @@ void CTypeInfo::SerializeProps(FArchive &Ar, void *ObjectData) const
 			{
 #if MKVSDC
 				if (Ar.Game == GAME_MK && Ar.ArVer >= 677 && (*Tag.StrucName)[0] == 'F')
-					Tag.StrucName.Str++;		// Tag.StrucName points to 'FStrucName' instead of 'StrucName'
+					Tag.StrucName = *Tag.StrucName + 1;	// Tag.StrucName points to 'FStrucName' instead of 'StrucName'
 #endif // MKVSDC
 				if (stricmp(Prop->TypeName+1, *Tag.StrucName) != 0 && stricmp(*Tag.StrucName, "None") != 0) // Tag.StrucName could be unknown in Batman2
 				{
@@ -1301,7 +1570,7 @@ void CTypeInfo::SerializeProps(FArchive &Ar, void *ObjectData) const
 			Ar.Seek(PropTagPos);
 			DUMP_ARC_BYTES(Ar, StopPos - PropTagPos);
 #endif
-			appError("%s\'%s\'.%s: Property read error: %d unread bytes", Name, UObject::GLoadingObj->Name, *Tag.Name, StopPos - Pos);
+			appError("%s\'%s\'.%s: Property read error: %d unread bytes", Name, UObject::GetLoadingObj()->Name, *Tag.Name, StopPos - Pos);
 		}
 
 		unguardf("(%s.%s, TagPos=%X)", Name, *Tag.Name, PropTagPos);
@@ -1316,16 +1585,41 @@ void CTypeInfo::SerializeProps(FArchive &Ar, void *ObjectData) const
 -----------------------------------------------------------------------------*/
 
 #define MAX_CLASSES		256
+#define CLASS_HASH_SIZE	512				// should be power of 2
 
 static CClassInfo GClasses[MAX_CLASSES];
 static int        GClassCount = 0;
 
+// Hash tables for FindClassType(). Classes are looked up by name without 'U'/'A' prefix,
+// structures - by full name, so there are 2 separate tables. Values are GClasses[] index + 1,
+// chains are ordered by class index, so the first registered class wins as before.
+static int16      GClassHash[CLASS_HASH_SIZE];
+static int16      GStructHash[CLASS_HASH_SIZE];
+static int16      GClassHashNext[MAX_CLASSES];
+static int16      GStructHashNext[MAX_CLASSES];
+
+static void BuildClassHash()
+{
+	memset(GClassHash, 0, sizeof(GClassHash));
+	memset(GStructHash, 0, sizeof(GStructHash));
+	for (int i = GClassCount - 1; i >= 0; i--)
+	{
+		int hash = appStringHash(GClasses[i].Name + 1) & (CLASS_HASH_SIZE - 1);
+		GClassHashNext[i] = GClassHash[hash];
+		GClassHash[hash] = i + 1;
+		hash = appStringHash(GClasses[i].Name) & (CLASS_HASH_SIZE - 1);
+		GStructHashNext[i] = GStructHash[hash];
+		GStructHash[hash] = i + 1;
+	}
+}
+
 void RegisterClasses(const CClassInfo *Table, int Count)
 {
 	if (Count <= 0) return;
 	assert(GClassCount + Count < ARRAY_COUNT(GClasses));
 	memcpy(GClasses + GClassCount, Table, Count * sizeof(GClasses[0]));
 	GClassCount += Count;
+	BuildClassHash();
 #if DEBUG_TYPES
 	appPrintf("*** Register: %d classes ***\n", Count);
 	for (int i = GClassCount - Count; i < GClassCount; i++)
@@ -1349,12 +1643,13 @@ void UnregisterClass(const char *Name, bool WholeTree)
 			{
 				// last table entry
 				GClassCount--;
-				return;
+				break;
 			}
 			memcpy(GClasses+i, GClasses+i+1, (GClassCount-i-1) * sizeof(GClasses[0]));
 			GClassCount--;
 			i--;
 		}
+	BuildClassHash();
 }
 
 
@@ -1364,17 +1659,13 @@ const CTypeInfo *FindClassType(const char *Name, bool ClassType)
 #if DEBUG_TYPES
 	appPrintf("--- find %s %s ... ", ClassType ? "class" : "struct", Name);
 #endif
-	for (int i = 0; i < GClassCount; i++)
+	int hash = appStringHash(Name) & (CLASS_HASH_SIZE - 1);
+	// skip 1st char only for ClassType==true?
+	const int16 *HashNext = ClassType ? GClassHashNext : GStructHashNext;
+	for (int i = (ClassType ? GClassHash[hash] : GStructHash[hash]) - 1; i >= 0; i = HashNext[i] - 1)
 	{
-		// skip 1st char only for ClassType==true?
-		if (ClassType)
-		{
-			if (stricmp(GClasses[i].Name + 1, Name) != 0) continue;
-		}
-		else
-		{
-			if (stricmp(GClasses[i].Name, Name) != 0) continue;
-		}
+		const char *ClassName = ClassType ? GClasses[i].Name + 1 : GClasses[i].Name;
+		if (stricmp(ClassName, Name) != 0) continue;
 
 		if (!GClasses[i].TypeInfo) appError("No typeinfo for class");
 		const CTypeInfo *Type = GClasses[i].TypeInfo();
@@ -1392,21 +1683,23 @@ const CTypeInfo *FindClassType(const char *Name, bool ClassType)
 }
 
 
-UObject *CreateClass(const char *Name)
+UObject *CreateClass(const char *Name, CMemoryChain *Arena)
 {
 	guard(CreateClass);
 
 	const CTypeInfo *Type = FindClassType(Name);
 	if (!Type) return NULL;
 
-	UObject *Obj = (UObject*)appMalloc(Type->SizeOf);
+	UObject *Obj = (UObject*)appArenaMalloc(Arena, Type->SizeOf);
 	assert(Type->Constructor);
 	Type->Constructor(Obj);
 	// NOTE: do not add object to GObjObjects in UObject constructor
 	// to allow runtime creation of objects without linked package
 	// Really, should add to this list after loading from package
 	// (in CreateExport/Import or after serialization)
+	UObject::LockObjects();
 	UObject::GObjObjects.Add(Obj);
+	UObject::UnlockObjects();
 	return Obj;
 
 	unguardf("%s", Name);
@@ -1457,6 +1750,111 @@ const CPropInfo *CTypeInfo::FindProperty(const char *Name) const
 }
 
 
+// Property lookup cache. FName strings are allocated with appStrdupPool() and never
+// released, so FName::NoCaseStr pointer could be used as a key.
+// Every type has own open-addressing table, which holds results of all lookups,
+// including failed ones. Lookups are lock-free: entries are only added, and an entry
+// becomes visible when its Name is set, after Prop. A full table is replaced with a
+// larger copy, and the old one is never released, because other threads could still
+// read it. Only threads which are adding entries are serialized with PropCacheLock.
+
+#define PROP_CACHE_MIN_SIZE		16		// should be power of 2
+
+struct CPropCacheEntry
+{
+	const char * volatile		Name;	// NULL for empty slot
+	const CPropInfo * volatile	Prop;
+};
+
+struct CPropCache
+{
+	int				Size;
+	int				Count;				// modified with PropCacheLock held
+	CPropCacheEntry	Entries[1];			// 'Size' items
+};
+
+static CSpinLock PropCacheLock;
+
+static FORCEINLINE int GetPropCacheIndex(const CPropCache *Cache, const char *Name)
+{
+	unsigned hash = (unsigned)((size_t)Name >> 3) * 0x9E3779B1u;
+	return (hash ^ (hash >> 15)) & (Cache->Size - 1);
+}
+
+static FORCEINLINE bool FindPropCache(const CPropCache *Cache, const char *Name, const CPropInfo *&Prop)
+{
+	for (int i = GetPropCacheIndex(Cache, Name); ; i = (i + 1) & (Cache->Size - 1))
+	{
+		const char *EntryName = Cache->Entries[i].Name;
+		if (!EntryName) return false;
+		if (EntryName == Name)
+		{
+			Prop = Cache->Entries[i].Prop;
+			return true;
+		}
+	}
+}
+
+static void InsertPropCache(CPropCache *Cache, const char *Name, const CPropInfo *Prop)
+{
+	int i = GetPropCacheIndex(Cache, Name);
+	while (Cache->Entries[i].Name)
+		i = (i + 1) & (Cache->Size - 1);
+	Cache->Entries[i].Prop = Prop;
+	appMemoryBarrier();					// publish Prop before Name
+	Cache->Entries[i].Name = Name;
+	Cache->Count++;
+}
+
+static CPropCache *AllocPropCache(const CPropCache *OldCache, int NewSize)
+{
+	CPropCache *Cache = (CPropCache*)appMalloc(sizeof(CPropCache) + (NewSize - 1) * sizeof(CPropCacheEntry));	// zero-filled
+	Cache->Size = NewSize;
+	if (OldCache)
+	{
+		for (int i = 0; i < OldCache->Size; i++)
+			if (OldCache->Entries[i].Name)
+				InsertPropCache(Cache, OldCache->Entries[i].Name, OldCache->Entries[i].Prop);
+	}
+	return Cache;
+}
+
+const CPropInfo *CTypeInfo::FindProperty(const FName &Name) const
+{
+	guard(CTypeInfo::FindProperty);
+
+	const char *Str = Name.NoCaseStr;
+	const CPropInfo *Prop = NULL;
+
+	// lock-free lookup
+	const CPropCache *Cache = PropCache;
+	if (Cache && FindPropCache(Cache, Str, Prop))
+		return Prop;
+
+	// not cached yet: perform a full lookup and remember the result
+	Prop = FindProperty(Str);
+	PropCacheLock.Lock();
+	CPropCache *WriteCache = PropCache;
+	const CPropInfo *CachedProp;
+	// the same name could be added by another thread meanwhile
+	if (!WriteCache || !FindPropCache(WriteCache, Str, CachedProp))
+	{
+		if (!WriteCache || (WriteCache->Count + 1) * 2 > WriteCache->Size)	// keep load factor not above 0.5
+		{
+			WriteCache = AllocPropCache(WriteCache, WriteCache ? WriteCache->Size * 2 : PROP_CACHE_MIN_SIZE);
+			appMemoryBarrier();			// publish table contents before the pointer
+			PropCache = WriteCache;
+		}
+		InsertPropCache(WriteCache, Str, Prop);
+	}
+	PropCacheLock.Unlock();
+
+	return Prop;
+
+	unguard;
+}
+
+
 static void PrintIndent(int Value)
 {
 	for (int i = 0; i < Value; i++)
@@ -1707,6 +2105,8 @@ void CTypeInfo::RemapProp(const char *ClassName, const char *OldName, const char
 	p->ClassName = ClassName;
 	p->OldName   = OldName;
 	p->NewName   = NewName;
+	// Note: property cache is not flushed here, RemapProp() should be called before loading
+	// any objects.
 }
 
 
@@ -70,6 +70,8 @@ struct CPropInfo
 };
 
 
+struct CPropCache;
+
 struct CTypeInfo
 {
 	const char		*Name;
@@ -78,6 +80,7 @@ struct CTypeInfo
 	const CPropInfo *Props;
 	int				NumProps;
 	void (*Constructor)(void*);
+	mutable CPropCache * volatile PropCache;	// properties resolved by FindProperty(FName), read without lock
 	// methods
 	FORCEINLINE CTypeInfo(const char *AName, const CTypeInfo *AParent, int DataSize,
 					 const CPropInfo *AProps, int PropCount, void (*AConstructor)(void*))
@@ -87,6 +90,7 @@ struct CTypeInfo
 	,	Props(AProps)
 	,	NumProps(PropCount)
 	,	Constructor(AConstructor)
+	,	PropCache(NULL)
 	{}
 	inline bool IsClass() const
 	{
@@ -94,6 +98,8 @@ struct CTypeInfo
 	}
 	bool IsA(const char *TypeName) const;
 	const CPropInfo *FindProperty(const char *Name) const;
+	// faster version for property tags, uses pointer of pooled FName string as a key
+	const CPropInfo *FindProperty(const FName &Name) const;
 	void SerializeProps(FArchive &Ar, void *ObjectData) const;
 	void DumpProps(void *Data) const;
 	static void RemapProp(const char *Class, const char *OldName, const char *NewName);
@@ -198,7 +204,9 @@ FORCEINLINE const CTypeInfo *FindStructType(const char *Name)
 	return FindClassType(Name, false);
 }
 
-UObject *CreateClass(const char *Name);
+// Create object of the given class. When 'Arena' is specified, object's memory is allocated
+// from it.
+UObject *CreateClass(const char *Name, CMemoryChain *Arena = NULL);
 
 FORCEINLINE bool IsKnownClass(const char *Name)
 {
@@ -246,6 +254,29 @@ int NameToEnum(const char *EnumName, const char *Value);
 	UObject class
 -----------------------------------------------------------------------------*/
 
+// Object loading state. Each thread has its own context, so packages could be loaded
+// from different threads simultaneously. Shared tables (package list, package export
+// tables, GObjObjects) are protected with UObject::LockObjects().
+struct CLoadingContext
+{
+	int					BeginLoadCount;
+	TArray<UObject*>	ObjLoaded;			// objects created but not serialized yet
+	UObject				*LoadingObj;		// object which is serialized now
+	int					LockCount;			// recursion counter for UObject::LockObjects()
+	CMemoryChain		*SavedArena;		// thread's memory arena, suspended while objects are locked
+	UnPackage			*LockedPackage;		// package which reader is used by this thread now
+	TArray<UnPackage*>	UsedPackages;		// packages with readers opened by this thread
+
+	CLoadingContext()
+	:	BeginLoadCount(0)
+	,	LoadingObj(NULL)
+	,	LockCount(0)
+	,	SavedArena(NULL)
+	,	LockedPackage(NULL)
+	{}
+};
+
+
 class UObject
 {
 	DECLARE_BASE(UObject, CNullType)
@@ -295,13 +326,29 @@ public:
 
 //private: -- not private to allow object browser ...
 	// static data and methods
-	static int				GObjBeginLoadCount;
-	static TArray<UObject*>	GObjLoaded;
 	static TArray<UObject*> GObjObjects;
-	static UObject			*GLoadingObj;
+
+	// loading context of the current thread
+	static CLoadingContext& GetLoadingContext();
+	static FORCEINLINE UObject* GetLoadingObj()
+	{
+		return GetLoadingContext().LoadingObj;
+	}
 
 	static void BeginLoad();
 	static void EndLoad();
+	// Used when packages are loaded by several threads: an object could reference objects which
+	// are still being serialized by another thread, so PostLoad() calls are deferred until
+	// EndDeferredPostLoad(), which should be called when all threads finished loading.
+	static void BeginDeferredPostLoad();
+	static void EndDeferredPostLoad(bool DoPostLoad = true);
+	// Release everything held by loading context of the current thread, used for recovery after
+	// a loading error
+	static void ResetLoadingContext();
+
+	// Lock access to GObjObjects and to export tables and list of packages; could be called recursively
+	static void LockObjects();
+	static void UnlockObjects();
 
 	// accessing object's package properties (here just to exclude UnPackage.h whenever possible)
 	const FArchive* GetPackageArchive() const;
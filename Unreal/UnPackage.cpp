@@ -3,6 +3,7 @@
 #include "UnCore.h"
 #include "UnObject.h"
 #include "UnPackage.h"
+#include "Parallel.h"
 
 
 byte GForceCompMethod = 0;		// COMPRESS_...
@@ -1415,6 +1416,10 @@ public:
 
 #if UNREAL3
 
+// Number of compressed blocks decompressed at once by each thread, used when
+// multithreading is enabled.
+#define DECOMPRESS_BLOCKS_PER_THREAD	4
+
 class FUE3ArchiveReader : public FArchive
 {
 	DECLARE_ARCHIVE(FUE3ArchiveReader, FArchive);
@@ -1566,42 +1571,53 @@ public:
 		int ChunkPosition = Chunk->UncompressedOffset;
 		int ChunkData     = ChunkDataPos;
 		assert(ChunkPosition <= Pos);
-		const FCompressedChunkBlock *Block = NULL;
-		for (int BlockIndex = 0; BlockIndex < ChunkHeader.Blocks.Num(); BlockIndex++)
+		assert(ChunkHeader.Blocks.Num());
+		int BlockIndex;
+		for (BlockIndex = 0; BlockIndex < ChunkHeader.Blocks.Num() - 1; BlockIndex++)
 		{
-			Block = &ChunkHeader.Blocks[BlockIndex];
-			if (ChunkPosition + Block->UncompressedSize > Pos)
+			const FCompressedChunkBlock &Block = ChunkHeader.Blocks[BlockIndex];
+			if (ChunkPosition + Block.UncompressedSize > Pos)
 				break;
-			ChunkPosition += Block->UncompressedSize;
-			ChunkData     += Block->CompressedSize;
+			ChunkPosition += Block.UncompressedSize;
+			ChunkData     += Block.CompressedSize;
+		}
+		// when multithreading is enabled, decompress several subsequent blocks at once
+		int NumBlocks = 1;
+		if (GNumThreads > 1 && ChunkHeader.BlockSize != -1)
+			NumBlocks = min(GNumThreads * DECOMPRESS_BLOCKS_PER_THREAD, ChunkHeader.Blocks.Num() - BlockIndex);
+		const FCompressedChunkBlock *Blocks = &ChunkHeader.Blocks[BlockIndex];
+		int CompressedSize = 0, UncompressedSize = 0;
+		for (int i = 0; i < NumBlocks; i++)
+		{
+			CompressedSize   += Blocks[i].CompressedSize;
+			UncompressedSize += Blocks[i].UncompressedSize;
 		}
-		assert(Block);
 		// read compressed data
 		//?? optimize? can share compressed buffer and decompressed buffer between packages
-		byte *CompressedBlock = new byte[Block->CompressedSize];
+		byte *CompressedBlock = new byte[CompressedSize];
 		Reader->Seek(ChunkData);
-		Reader->Serialize(CompressedBlock, Block->CompressedSize);
+		Reader->Serialize(CompressedBlock, CompressedSize);
 		// prepare buffer for decompression
-		if (Block->UncompressedSize > BufferSize)
+		if (UncompressedSize > BufferSize)
 		{
 			if (Buffer) delete[] Buffer;
-			Buffer = new byte[Block->UncompressedSize];
-			BufferSize = Block->UncompressedSize;
+			Buffer = new byte[UncompressedSize];
+			BufferSize = UncompressedSize;
 		}
 		// decompress data
 		guard(DecompressBlock);
 		if (ChunkHeader.BlockSize != -1)	// my own mark
-			appDecompress(CompressedBlock, Block->CompressedSize, Buffer, Block->UncompressedSize, CompressionFlags);
+			appDecompressBlocks(CompressedBlock, Buffer, Blocks, NumBlocks, CompressionFlags);
 		else
 		{
 			// no compression
-			assert(Block->CompressedSize == Block->UncompressedSize);
-			memcpy(Buffer, CompressedBlock, Block->CompressedSize);
+			assert(CompressedSize == UncompressedSize);
+			memcpy(Buffer, CompressedBlock, CompressedSize);
 		}
-		unguardf("block=%X+%X", ChunkData, Block->CompressedSize);
+		unguardf("block=%X+%X", ChunkData, CompressedSize);
 		// setup BufferStart/BufferEnd
 		BufferStart = ChunkPosition;
-		BufferEnd   = ChunkPosition + Block->UncompressedSize;
+		BufferEnd   = ChunkPosition + UncompressedSize;
 		// cleanup
 		delete[] CompressedBlock;
 		unguard;
@@ -1777,6 +1793,8 @@ FArchive* UnPackage::CreateLoader(const char* filename, FArchive* baseLoader)
 
 UnPackage::UnPackage(const char *filename, FArchive *baseLoader, bool silent)
 :	Loader(NULL)
+,	ObjectMem(NULL)
+,	UseStamp(0)
 {
 	guard(UnPackage::UnPackage);
 
@@ -1938,6 +1956,7 @@ void UnPackage::LoadNameTable()
 
 	Seek(Summary.NameOffset);
 	NameTable = new const char* [Summary.NameCount];
+	NameTableNoCase = new const char* [Summary.NameCount];
 	for (int i = 0; i < Summary.NameCount; i++)
 	{
 		guard(Name);
@@ -1953,7 +1972,7 @@ void UnPackage::LoadNameTable()
 				if (!c) break;
 			}
 			assert(len < ARRAY_COUNT(buf));
-			NameTable[i] = appStrdupPool(buf);
+			NameTable[i] = appStrdupPool(buf, NameTableNoCase[i]);
 			// skip object flags
 			int tmp;
 			*this << tmp;
@@ -1968,7 +1987,7 @@ void UnPackage::LoadNameTable()
 			*this << len;
 			assert(len < ARRAY_COUNT(buf));
 			Serialize(buf, len+1);
-			NameTable[i] = appStrdupPool(buf);
+			NameTable[i] = appStrdupPool(buf, NameTableNoCase[i]);
 			// skip object flags
 			int tmp;
 			*this << tmp;
@@ -1990,7 +2009,7 @@ void UnPackage::LoadNameTable()
 				*this << len;
 				assert(len < ARRAY_COUNT(buf));
 				Serialize(buf, len+1);
-				NameTable[i] = appStrdupPool(buf);
+				NameTable[i] = appStrdupPool(buf, NameTableNoCase[i]);
 				*this << flags;
 				goto done;
 			}
@@ -2004,7 +2023,7 @@ void UnPackage::LoadNameTable()
 				assert(len < ARRAY_COUNT(buf));
 				Serialize(buf, len);
 				buf[len] = 0;
-				NameTable[i] = appStrdupPool(buf);
+				NameTable[i] = appStrdupPool(buf, NameTableNoCase[i]);
 				goto done;
 			}
 #endif // LEAD
@@ -2030,7 +2049,7 @@ void UnPackage::LoadNameTable()
 					*d = c2 & 0xFF;
 					shift = (c - 5) & 15;
 				}
-				NameTable[i] = appStrdupPool(buf);
+				NameTable[i] = appStrdupPool(buf, NameTableNoCase[i]);
 				int unk;
 				*this << AR_INDEX(unk);
 				unguard;
@@ -2047,7 +2066,7 @@ void UnPackage::LoadNameTable()
 				assert(len < ARRAY_COUNT(buf));
 				Serialize(buf, len);
 				buf[len] = 0;
-				NameTable[i] = appStrdupPool(buf);
+				NameTable[i] = appStrdupPool(buf, NameTableNoCase[i]);
 				goto qword_flags;
 			}
 #endif // DCU_ONLINE
@@ -2060,7 +2079,7 @@ void UnPackage::LoadNameTable()
 				assert(len < ARRAY_COUNT(buf));
 				Serialize(buf, len);
 				buf[len] = 0;
-				NameTable[i] = appStrdupPool(buf);
+				NameTable[i] = appStrdupPool(buf, NameTableNoCase[i]);
 				goto done;
 			}
 #endif // R6VEGAS
@@ -2073,7 +2092,7 @@ void UnPackage::LoadNameTable()
 				assert(len < ARRAY_COUNT(buf));
 				Serialize(buf, len);
 				buf[len] = 0;
-				NameTable[i] = appStrdupPool(buf);
+				NameTable[i] = appStrdupPool(buf, NameTableNoCase[i]);
 				goto qword_flags;
 			}
 #endif // TRANSFORMERS
@@ -2096,7 +2115,7 @@ void UnPackage::LoadNameTable()
 			NameTable[i] = new char[name.Num()];
 			strcpy(NameTable[i], *name);
 	#else
-			NameTable[i] = appStrdupPool(*name);
+			NameTable[i] = appStrdupPool(*name, NameTableNoCase[i]);
 	#endif
 
 	#if UNREAL4
@@ -2222,6 +2241,31 @@ void UnPackage::LoadExportTable()
 		PatchDunDefExports(ExportTable, Summary);
 #endif
 
+	CreateExportHash();
+
+	unguard;
+}
+
+
+void UnPackage::CreateExportHash()
+{
+	guard(UnPackage::CreateExportHash);
+
+	// use hash size which is power of 2 and not less than number of exports
+	int hashSize = 256;
+	while (hashSize < Summary.ExportCount) hashSize <<= 1;
+
+	ExportHash.Init(-1, hashSize);
+	ExportHashNext.Init(-1, Summary.ExportCount);
+
+	// add exports in reverse order, so each hash chain will be sorted by export index
+	for (int i = Summary.ExportCount - 1; i >= 0; i--)
+	{
+		int hash = appStringHash(ExportTable[i].ObjectName) & (hashSize - 1);
+		ExportHashNext[i] = ExportHash[hash];
+		ExportHash[hash] = i;
+	}
+
 	unguard;
 }
 
@@ -2231,16 +2275,20 @@ UnPackage::~UnPackage()
 	guard(UnPackage::~UnPackage);
 	// free resources
 	if (Loader) delete Loader;
+	if (ObjectMem) delete ObjectMem;
 	delete NameTable;
+	delete NameTableNoCase;
 	delete ImportTable;
 	delete ExportTable;
 #if UNREAL3
 	if (DependsTable) delete DependsTable;
 #endif
 	// remove self from package table
+	UObject::LockObjects();
 	int i = PackageMap.FindItem(this);
 	assert(i != INDEX_NONE);
 	PackageMap.RemoveAt(i);
+	UObject::UnlockObjects();
 	unguard;
 }
 
@@ -2292,11 +2340,62 @@ void UnPackage::CloseReader()
 
 void UnPackage::CloseAllReaders()
 {
+	// note: package reader should never be locked while holding UObject::LockObjects(), because
+	// loading code is doing that in opposite order
+	UObject::LockObjects();
+	TArray<UnPackage*> Packages;
+	CopyArray(Packages, PackageMap);
+	UObject::UnlockObjects();
+
+	for (int i = 0; i < Packages.Num(); i++)
+	{
+		UnPackage* p = Packages[i];
+		p->ReaderLock.Lock();
+		p->CloseReader();
+		p->ReaderLock.Unlock();
+	}
+}
+
+void UnPackage::ReleaseObjectMem()
+{
+	guard(UnPackage::ReleaseObjectMem);
+	UObject::LockObjects();
+	// arena is deleted completely, so unloaded packages are not holding any memory
+	if (ObjectMem) delete ObjectMem;
+	ObjectMem = NULL;
+	LinkedPackages.Empty();
+	UObject::UnlockObjects();
+	unguard;
+}
+
+void UnPackage::ReleaseAllObjectMem()
+{
+	guard(UnPackage::ReleaseAllObjectMem);
+	UObject::LockObjects();
+	for (int i = 0; i < PackageMap.Num(); i++)
+		PackageMap[i]->ReleaseObjectMem();
+	UObject::UnlockObjects();
+	unguard;
+}
+
+size_t UnPackage::GetAllObjectMemSize(UnPackage*& LeastRecentlyUsed)
+{
+	guard(UnPackage::GetAllObjectMemSize);
+	size_t Size = 0;
+	LeastRecentlyUsed = NULL;
+	UObject::LockObjects();
 	for (int i = 0; i < PackageMap.Num(); i++)
 	{
 		UnPackage* p = PackageMap[i];
-		p->CloseReader();
+		if (!p->ObjectMem) continue;
+		Size += p->ObjectMem->GetSize();
+		if (!LeastRecentlyUsed || p->UseStamp < LeastRecentlyUsed->UseStamp)
+			LeastRecentlyUsed = p;
 	}
+	UObject::UnlockObjects();
+	return Size;
+
+	unguard;
 }
 
 
@@ -2317,10 +2416,11 @@ FArchive& UnPackage::operator<<(FName &N)
 		if (N.ExtraIndex == 0)
 		{
 			N.Str = GetName(N.Index);
+			N.NoCaseStr = NameTableNoCase[N.Index];
 		}
 		else
 		{
-			N.Str = appStrdupPool(va("%s%d", GetName(N.Index), N.ExtraIndex-1));	// without "_" char
+			N.Str = appStrdupPool(va("%s%d", GetName(N.Index), N.ExtraIndex-1), N.NoCaseStr);	// without "_" char
 		}
 		return *this;
 	}
@@ -2370,14 +2470,16 @@ FArchive& UnPackage::operator<<(FName &N)
 	if (N.ExtraIndex == 0)
 	{
 		N.Str = GetName(N.Index);
+		N.NoCaseStr = NameTableNoCase[N.Index];
 	}
 	else
 	{
-		N.Str = appStrdupPool(va("%s_%d", GetName(N.Index), N.ExtraIndex-1));
+		N.Str = appStrdupPool(va("%s_%d", GetName(N.Index), N.ExtraIndex-1), N.NoCaseStr);
 	}
 #else
 	// no modern engines compiled
 	N.Str = GetName(N.Index);
+	N.NoCaseStr = NameTableNoCase[N.Index];
 #endif // UNREAL3 || UNREAL4
 
 	return *this;
@@ -2430,8 +2532,12 @@ FArchive& UnPackage::operator<<(UObject *&Obj)
 
 int UnPackage::FindExport(const char *name, const char *className, int firstIndex) const
 {
-	for (int i = firstIndex; i < Summary.ExportCount; i++)
+	if (!ExportHash.Num()) return INDEX_NONE;		// package has no exports
+
+	int hash = appStringHash(name) & (ExportHash.Num() - 1);
+	for (int i = ExportHash[hash]; i >= 0; i = ExportHashNext[i])
 	{
+		if (i < firstIndex) continue;
 		const FObjectExport &Exp = ExportTable[i];
 		// compare object name
 		if (stricmp(Exp.ObjectName, name) != 0)
@@ -2531,17 +2637,35 @@ int UnPackage::FindExportForImport(const char *ObjectName, const char *ClassName
 }
 
 
+// Size of the first block of package's object arena, next blocks will be not smaller
+#define OBJECT_MEM_CHUNK		(256*1024)
+
 UObject* UnPackage::CreateExport(int index)
+{
+	UObject::BeginLoad();
+	UObject::LockObjects();
+	UObject *Obj = CreateExportLocked(index);
+	UObject::UnlockObjects();
+	UObject::EndLoad();		// will serialize the object when not called from another BeginLoad/EndLoad block
+	return Obj;
+}
+
+UObject* UnPackage::CreateExportLocked(int index)
 {
 	guard(UnPackage::CreateExport);
 
+	static int LastUseStamp = 0;
+	UseStamp = ++LastUseStamp;
+
 	// create empty object
 	FObjectExport &Exp = GetExport(index);
 	if (Exp.Object)
 		return Exp.Object;
 
 	const char *ClassName = GetObjectName(Exp.ClassIndex);
-	UObject *Obj = Exp.Object = CreateClass(ClassName);
+	if (!ObjectMem)
+		ObjectMem = new (OBJECT_MEM_CHUNK) CMemoryChain;
+	UObject *Obj = Exp.Object = CreateClass(ClassName, ObjectMem);
 	if (!Obj)
 	{
 		appPrintf("WARNING: Unknown class \"%s\" for object \"%s\"\n", ClassName, *Exp.ObjectName);
@@ -2569,7 +2693,6 @@ UObject* UnPackage::CreateExport(int index)
 		}
 	}
 #endif // UNREAL3
-	UObject::BeginLoad();
 
 	// find outer object
 	UObject *Outer = NULL;
@@ -2590,11 +2713,10 @@ UObject* UnPackage::CreateExport(int index)
 	Obj->PackageIndex = index;
 	Obj->Outer        = Outer;
 	Obj->Name         = Exp.ObjectName;
-	// add object to GObjLoaded for later serialization
+	// add object to the loading queue for later serialization
 	if (strnicmp(Exp.ObjectName, "Default__", 9) != 0)	// default properties are not supported -- this is a clean UObject format
-		UObject::GObjLoaded.Add(Obj);
+		UObject::GetLoadingContext().ObjLoaded.Add(Obj);
 
-	UObject::EndLoad();
 	return Obj;
 
 	unguardf("%s:%d", Filename, index);
@@ -2602,6 +2724,16 @@ UObject* UnPackage::CreateExport(int index)
 
 
 UObject* UnPackage::CreateImport(int index)
+{
+	UObject::BeginLoad();
+	UObject::LockObjects();
+	UObject *Obj = CreateImportLocked(index);
+	UObject::UnlockObjects();
+	UObject::EndLoad();
+	return Obj;
+}
+
+UObject* UnPackage::CreateImportLocked(int index)
 {
 	guard(UnPackage::CreateImport);
 
@@ -2666,6 +2798,10 @@ UObject* UnPackage::CreateImport(int index)
 		return NULL;
 	}
 
+	// remember dependency, so objects of this package will be released together with the imported ones
+	if (Package != this && LinkedPackages.FindItem(Package) < 0)
+		LinkedPackages.Add(Package);
+
 	// create object
 	return Package->CreateExport(ObjIndex);
 
@@ -2792,6 +2928,14 @@ TArray<UnPackage*>	UnPackage::PackageMap;
 TArray<char*>		MissingPackages;
 
 UnPackage *UnPackage::LoadPackage(const char *Name, bool silent)
+{
+	UObject::LockObjects();
+	UnPackage *Package = LoadPackageLocked(Name, silent);
+	UObject::UnlockObjects();
+	return Package;
+}
+
+UnPackage *UnPackage::LoadPackageLocked(const char *Name, bool silent)
 {
 	guard(UnPackage::LoadPackage);
 
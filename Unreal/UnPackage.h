@@ -1,6 +1,8 @@
 #ifndef __UNPACKAGE_H__
 #define __UNPACKAGE_H__
 
+#include "Parallel.h"				// CMutex
+
 
 #if 1
 #	define PKG_LOG(...)		appPrintf(__VA_ARGS__)
@@ -203,11 +205,22 @@ public:
 	FPackageFileSummary		Summary;
 	// tables
 	const char				**NameTable;
+	const char				**NameTableNoCase;	// FName::NoCaseStr for every name
 	FObjectImport			*ImportTable;
 	FObjectExport			*ExportTable;
 #if UNREAL3
 	FObjectDepends			*DependsTable;
 #endif
+	// Package reader is shared by all threads, so it is locked for serialization of each object
+	CMutex					ReaderLock;
+	// Memory arena for objects created from this package and their serialized arrays, could be
+	// released only when all these objects are destroyed
+	CMemoryChain			*ObjectMem;
+	// Packages which objects were imported by this package, so objects of this package could
+	// reference them
+	TArray<UnPackage*>		LinkedPackages;
+	// Sequence number of the last object creation, used to find least recently used packages
+	int						UseStamp;
 
 protected:
 	UnPackage(const char *filename, FArchive *baseLoader = NULL, bool silent = false);
@@ -229,6 +242,13 @@ public:
 
 	static void CloseAllReaders();
 
+	// Release object arena, should be called only when all objects of the package are destroyed
+	void ReleaseObjectMem();
+	static void ReleaseAllObjectMem();
+	// Total size of object arenas of all packages, and the least recently used package which
+	// has an arena (NULL when no objects are loaded)
+	static size_t GetAllObjectMemSize(UnPackage*& LeastRecentlyUsed);
+
 	const char* GetName(int index)
 	{
 		if (index < 0 || index >= Summary.NameCount)
@@ -353,6 +373,16 @@ private:
 	void LoadNameTable();
 	void LoadImportTable();
 	void LoadExportTable();
+	void CreateExportHash();
+
+	// implementation of public functions with the same names, called with UObject::LockObjects()
+	static UnPackage *LoadPackageLocked(const char *Name, bool silent);
+	UObject* CreateExportLocked(int index);
+	UObject* CreateImportLocked(int index);
+
+	// hash of export object names, used by FindExport()
+	TArray<int>				ExportHash;
+	TArray<int>				ExportHashNext;
 
 	static TArray<UnPackage*> PackageMap;
 };
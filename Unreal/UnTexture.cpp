@@ -1,17 +1,23 @@
-#include "UnTextureNVTT.h"
-
 #include "Core.h"
 #include "UnCore.h"
 #include "UnObject.h"
 #include "UnMaterial.h"
 #include "UnMaterial2.h"		// for UPalette
 
+#include "Parallel.h"
+
 #if SUPPORT_IPHONE
 #	include <PVRTDecompress.h>
 #endif
 
 #include <detex.h>
 
+#define USE_SSE2			1		// use SSE2 for pixel format conversion
+
+#if USE_SSE2
+#	include <emmintrin.h>
+#endif
+
 #if 0
 #	define PROFILE_DDS(cmd)		cmd
 #else
@@ -24,48 +30,441 @@
 	Texture decompression
 -----------------------------------------------------------------------------*/
 
-// replaces random 'alpha=0' color with black
-static void PostProcessAlpha(byte *pic, int width, int height)
+/*-----------------------------------------------------------------------------
+	Pixel format conversion
+-----------------------------------------------------------------------------*/
+
+// Functions below are converting 'Count' pixels from 'Src' to 32-bit pixels in 'Dst'.
+// Output has RGBA byte order, or BGRA when 'BGRA' is true, so the caller receives data
+// in its final channel order without an additional pass. Note: code assumes little-endian
+// platform - 32-bit RGBA pixel has red channel in the lowest byte.
+
+#define PIXEL32(r,g,b,a)		( (r) | ((g) << 8) | ((b) << 16) | ((unsigned)(a) << 24) )
+
+// RGBA <-> BGRA; Src and Dst could point to the same buffer
+static void ConvertSwapRB(const byte *Src, byte *Dst, int Count)
+{
+	const unsigned *s = (const unsigned*)Src;
+	unsigned *d = (unsigned*)Dst;
+	int i = 0;
+#if USE_SSE2
+	const __m128i maskAG = _mm_set1_epi32(0xFF00FF00);
+	for ( ; i + 4 <= Count; i += 4)
+	{
+		__m128i p  = _mm_loadu_si128((const __m128i*)(s + i));
+		__m128i ag = _mm_and_si128(p, maskAG);
+		__m128i rb = _mm_andnot_si128(maskAG, p);		// 0x00BB00RR
+		rb = _mm_or_si128(_mm_srli_epi32(rb, 16), _mm_slli_epi32(rb, 16));
+		_mm_storeu_si128((__m128i*)(d + i), _mm_or_si128(ag, rb));
+	}
+#endif // USE_SSE2
+	for ( ; i < Count; i++)
+	{
+		unsigned p = s[i];
+		d[i] = (p & 0xFF00FF00) | ((p >> 16) & 0xFF) | ((p & 0xFF) << 16);
+	}
+}
+
+// 32-bit source with RGBA or BGRA layout
+static void ConvertRGBA8(const byte *Src, byte *Dst, int Count, bool SwapRB)
+{
+	if (SwapRB)
+		ConvertSwapRB(Src, Dst, Count);
+	else
+		memcpy(Dst, Src, Count * 4);
+}
+
+// BGR source
+static void ConvertRGB8(const byte *Src, byte *Dst, int Count, bool BGRA)
+{
+	unsigned *d = (unsigned*)Dst;
+	if (BGRA)
+	{
+		for (int i = 0; i < Count; i++, Src += 3)
+			d[i] = PIXEL32(Src[0], Src[1], Src[2], 255);
+	}
+	else
+	{
+		for (int i = 0; i < Count; i++, Src += 3)
+			d[i] = PIXEL32(Src[2], Src[1], Src[0], 255);
+	}
+}
+
+// Greyscale; the result doesn't depend on channel order
+static void ConvertG8(const byte *Src, byte *Dst, int Count)
+{
+	unsigned *d = (unsigned*)Dst;
+	int i = 0;
+#if USE_SSE2
+	const __m128i alpha = _mm_set1_epi8((char)0xFF);
+	for ( ; i + 16 <= Count; i += 16)
+	{
+		__m128i g   = _mm_loadu_si128((const __m128i*)(Src + i));
+		__m128i gg0 = _mm_unpacklo_epi8(g, g);			// pixels 0..7: G,G
+		__m128i ga0 = _mm_unpacklo_epi8(g, alpha);		// pixels 0..7: G,A
+		__m128i gg1 = _mm_unpackhi_epi8(g, g);			// pixels 8..15
+		__m128i ga1 = _mm_unpackhi_epi8(g, alpha);
+		_mm_storeu_si128((__m128i*)(d + i     ), _mm_unpacklo_epi16(gg0, ga0));
+		_mm_storeu_si128((__m128i*)(d + i + 4 ), _mm_unpackhi_epi16(gg0, ga0));
+		_mm_storeu_si128((__m128i*)(d + i + 8 ), _mm_unpacklo_epi16(gg1, ga1));
+		_mm_storeu_si128((__m128i*)(d + i + 12), _mm_unpackhi_epi16(gg1, ga1));
+	}
+#endif // USE_SSE2
+	for ( ; i < Count; i++)
+	{
+		unsigned b = Src[i];
+		d[i] = PIXEL32(b, b, b, 255);
+	}
+}
+
+// 16-bit pixel: 1st byte is B (high nibble) and A, 2nd byte is R and G
+static void ConvertRGBA4(const byte *Src, byte *Dst, int Count, bool BGRA)
+{
+	unsigned *d = (unsigned*)Dst;
+	int i = 0;
+#if USE_SSE2
+	const __m128i maskHi = _mm_set1_epi8((char)0xF0);
+	const __m128i maskLo = _mm_set1_epi8(0x0F);
+	const __m128i maskRB = _mm_set1_epi32(0x00FF00FF);
+	for ( ; i + 8 <= Count; i += 8)
+	{
+		__m128i p  = _mm_loadu_si128((const __m128i*)(Src + i * 2));
+		__m128i hi = _mm_and_si128(p, maskHi);
+		__m128i lo = _mm_slli_epi16(_mm_and_si128(p, maskLo), 4);	// no carry to the next byte
+		// bytes of 32-bit pixels are B,A,R,G now
+		__m128i p0 = _mm_unpacklo_epi8(hi, lo);
+		__m128i p1 = _mm_unpackhi_epi8(hi, lo);
+		if (!BGRA)
+		{
+			// exchange 16-bit halves: R,G,B,A
+			p0 = _mm_or_si128(_mm_srli_epi32(p0, 16), _mm_slli_epi32(p0, 16));
+			p1 = _mm_or_si128(_mm_srli_epi32(p1, 16), _mm_slli_epi32(p1, 16));
+		}
+		else
+		{
+			// exchange A and G: B,G,R,A
+			__m128i ag0 = _mm_andnot_si128(maskRB, p0);
+			__m128i ag1 = _mm_andnot_si128(maskRB, p1);
+			p0 = _mm_or_si128(_mm_and_si128(p0, maskRB), _mm_or_si128(_mm_srli_epi32(ag0, 16), _mm_slli_epi32(ag0, 16)));
+			p1 = _mm_or_si128(_mm_and_si128(p1, maskRB), _mm_or_si128(_mm_srli_epi32(ag1, 16), _mm_slli_epi32(ag1, 16)));
+		}
+		_mm_storeu_si128((__m128i*)(d + i    ), p0);
+		_mm_storeu_si128((__m128i*)(d + i + 4), p1);
+	}
+#endif // USE_SSE2
+	for ( ; i < Count; i++)
+	{
+		unsigned b1 = Src[i * 2];
+		unsigned b2 = Src[i * 2 + 1];
+		unsigned r = b2 & 0xF0;
+		unsigned g = (b2 & 0xF) << 4;
+		unsigned b = b1 & 0xF0;
+		unsigned a = (b1 & 0xF) << 4;
+		d[i] = BGRA ? PIXEL32(b, g, r, a) : PIXEL32(r, g, b, a);
+	}
+}
+
+// Paletted image: build a table of 32-bit pixels in the output channel order, so
+// every pixel is converted with a single lookup
+static void ConvertP8(const byte *Src, byte *Dst, int Count, const TArray<FColor> &Colors, bool BGRA)
+{
+	unsigned Table[256];
+	memset(Table, 0, sizeof(Table));
+	int NumColors = min(Colors.Num(), 256);
+	for (int i = 0; i < NumColors; i++)
+	{
+		const FColor &c = Colors[i];
+		Table[i] = BGRA ? PIXEL32(c.B, c.G, c.R, c.A) : PIXEL32(c.R, c.G, c.B, c.A);
+	}
+	unsigned *d = (unsigned*)Dst;
+	for (int i = 0; i < Count; i++)
+		d[i] = Table[Src[i]];
+}
+
+// Normal map with 2 channels, restore Z (blue) channel
+static void ConvertV8U8(const byte *Src, byte *Dst, int Count, bool Signed, bool BGRA)
+{
+	byte offset = Signed ? 128 : 0;
+	int R = BGRA ? 2 : 0;
+	for (int i = 0; i < Count; i++, Dst += 4)
+	{
+		byte u = *Src++ + offset;		// byte + byte -> byte, overflow is normal here
+		byte v = *Src++ + offset;
+		Dst[R] = u;
+		Dst[1] = v;
+		float uf = (u - offset) / 255.0f * 2 - 1;
+		float vf = (v - offset) / 255.0f * 2 - 1;
+		float t  = 1.0f - uf * uf - vf * vf;
+		if (t >= 0)
+			Dst[2-R] = 255 - 255 * appFloor(sqrt(t));
+		else
+			Dst[2-R] = 255;
+		Dst[3] = 255;
+	}
+}
+
+
+/*-----------------------------------------------------------------------------
+	Block compressed formats
+-----------------------------------------------------------------------------*/
+
+// Decoder for DXT1/3/5 (BC1-3), DXT5N and BC5, and a wrapper for BC7 decoder from
+// detex library. Results are bit-exact with nvtt decoder which was used before.
+// Every block is decoded into 4x4 pixel array and then copied to the image. Rows of
+// blocks are independent, so they're decoded in parallel.
+
+// Lookup table for restoring Z component of normal map, indexed with (X << 8) | Y
+static byte NormalZTable[256*256];
+static bool NormalZTableReady = false;
+
+static void BuildNormalZTable()
 {
-	guard(PostProcessAlpha);
+	if (NormalZTableReady) return;
+	for (int x = 0; x < 256; x++)
+	{
+		for (int y = 0; y < 256; y++)
+		{
+			// the same math as in nvtt's buildNormal()
+			float nx = 2 * (x / 255.0f) - 1;
+			float ny = 2 * (y / 255.0f) - 1;
+			float nz = 0.0f;
+			if (1 - nx*nx - ny*ny > 0) nz = sqrtf(1 - nx*nx - ny*ny);
+			NormalZTable[(x << 8) | y] = bound(int(255.0f * (nz + 1) / 2.0f), 0, 255);
+		}
+	}
+	NormalZTableReady = true;
+}
 
-	for (int pixelCount = width * height; pixelCount > 0; pixelCount--, pic += 4)
+// Color block, shared by BC1-BC3. BC1 transparent pixels are black, so there's no need for
+// postprocessing of such pixels.
+static void DecodeColorBlock(const byte *Block, unsigned *Pixels, bool BGRA)
+{
+	unsigned c0 = Block[0] | (Block[1] << 8);
+	unsigned c1 = Block[2] | (Block[3] << 8);
+	// expand 5:6:5 colors to 8:8:8
+	int r0 = (c0 >> 11) & 0x1F, g0 = (c0 >> 5) & 0x3F, b0 = c0 & 0x1F;
+	int r1 = (c1 >> 11) & 0x1F, g1 = (c1 >> 5) & 0x3F, b1 = c1 & 0x1F;
+	r0 = (r0 << 3) | (r0 >> 2); g0 = (g0 << 2) | (g0 >> 4); b0 = (b0 << 3) | (b0 >> 2);
+	r1 = (r1 << 3) | (r1 >> 2); g1 = (g1 << 2) | (g1 >> 4); b1 = (b1 << 3) | (b1 >> 2);
+	if (BGRA)
 	{
-		if (pic[3] != 0)	// not completely transparent
-			continue;
-		pic[0] = pic[1] = pic[2] = 0;
+		Exchange(r0, b0);
+		Exchange(r1, b1);
 	}
 
+	unsigned Palette[4];
+#if USE_SSE2
+	// 16-bit lanes: endpoint 0 in the low half, endpoint 1 in the high half
+	__m128i e  = _mm_setr_epi16(r0, g0, b0, 255, r1, g1, b1, 255);
+	__m128i e2 = _mm_shuffle_epi32(e, _MM_SHUFFLE(1, 0, 3, 2));	// swapped endpoints
+	__m128i mid;
+	if (c0 > c1)
+	{
+		// (2 * c0 + c1) / 3 and (c0 + 2 * c1) / 3; x / 3 == (x * 0xAAAB) >> 17 for 16-bit x
+		mid = _mm_add_epi16(_mm_add_epi16(e, e), e2);
+		mid = _mm_srli_epi16(_mm_mulhi_epu16(mid, _mm_set1_epi16((short)0xAAAB)), 1);
+	}
+	else
+	{
+		// (c0 + c1) / 2 and transparent black
+		mid = _mm_srli_epi16(_mm_add_epi16(e, e2), 1);
+		mid = _mm_move_epi64(mid);
+	}
+	_mm_storeu_si128((__m128i*)Palette, _mm_packus_epi16(e, mid));
+#else
+	Palette[0] = PIXEL32(r0, g0, b0, 255);
+	Palette[1] = PIXEL32(r1, g1, b1, 255);
+	if (c0 > c1)
+	{
+		Palette[2] = PIXEL32((2 * r0 + r1) / 3, (2 * g0 + g1) / 3, (2 * b0 + b1) / 3, 255);
+		Palette[3] = PIXEL32((r0 + 2 * r1) / 3, (g0 + 2 * g1) / 3, (b0 + 2 * b1) / 3, 255);
+	}
+	else
+	{
+		Palette[2] = PIXEL32((r0 + r1) / 2, (g0 + g1) / 2, (b0 + b1) / 2, 255);
+		Palette[3] = 0;
+	}
+#endif // USE_SSE2
+
+	unsigned indices = Block[4] | (Block[5] << 8) | (Block[6] << 16) | (Block[7] << 24);
+	for (int i = 0; i < 16; i++, indices >>= 2)
+		Pixels[i] = Palette[indices & 3];
+}
+
+// Interpolated 8-bit channel, used by BC3-BC5
+static void DecodeAlphaBlock(const byte *Block, byte *Values)
+{
+	unsigned a0 = Block[0];
+	unsigned a1 = Block[1];
+	byte Palette[8];
+	Palette[0] = a0;
+	Palette[1] = a1;
+	if (a0 > a1)
+	{
+		for (int i = 1; i < 7; i++)
+			Palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+	}
+	else
+	{
+		for (int i = 1; i < 5; i++)
+			Palette[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+		Palette[6] = 0;
+		Palette[7] = 255;
+	}
+	// 16 3-bit indices
+	unsigned indices = Block[2] | (Block[3] << 8) | (Block[4] << 16);
+	for (int i = 0; i < 8; i++, indices >>= 3)
+		Values[i] = Palette[indices & 7];
+	indices = Block[5] | (Block[6] << 8) | (Block[7] << 16);
+	for (int i = 8; i < 16; i++, indices >>= 3)
+		Values[i] = Palette[indices & 7];
+}
+
+struct CBlockDecodeJob
+{
+	const byte*		Data;
+	byte*			Dst;
+	int				USize;
+	int				VSize;
+	int				BlocksX;
+	int				BytesPerBlock;
+	ETexturePixelFormat Format;
+	bool			BGRA;
+	volatile int	ErrorCount;					// for BC7
+};
+
+static void DecodeBlockRows(CBlockDecodeJob *Job, int First, int Last)
+{
+	unsigned Pixels[16];
+	byte Values[16];
+	byte Values2[16];
+
+	int R = Job->BGRA ? 16 : 0;					// bit position of red and blue channels
+	int B = 16 - R;
+	const byte *Src = Job->Data + First * Job->BlocksX * Job->BytesPerBlock;
+
+	for (int by = First; by < Last; by++)
+	{
+		int numRows = min(4, Job->VSize - by * 4);
+		for (int bx = 0; bx < Job->BlocksX; bx++, Src += Job->BytesPerBlock)
+		{
+			int i;
+			switch (Job->Format)
+			{
+			case TPF_DXT1:
+				DecodeColorBlock(Src, Pixels, Job->BGRA);
+				break;
+			case TPF_DXT3:
+				DecodeColorBlock(Src + 8, Pixels, Job->BGRA);
+				for (i = 0; i < 16; i++)
+				{
+					unsigned a = (Src[i >> 1] >> ((i & 1) * 4)) & 0xF;
+					Pixels[i] = (Pixels[i] & 0x00FFFFFF) | (((a << 4) | a) << 24);
+				}
+				break;
+			case TPF_DXT5:
+				DecodeColorBlock(Src + 8, Pixels, Job->BGRA);
+				DecodeAlphaBlock(Src, Values);
+				for (i = 0; i < 16; i++)
+					Pixels[i] = (Pixels[i] & 0x00FFFFFF) | (Values[i] << 24);
+				break;
+			case TPF_DXT5N:
+				// normal map: X in alpha, Y in green channel
+				DecodeColorBlock(Src + 8, Pixels, false);
+				DecodeAlphaBlock(Src, Values);
+				for (i = 0; i < 16; i++)
+				{
+					unsigned x = Values[i];
+					unsigned y = (Pixels[i] >> 8) & 0xFF;
+					Pixels[i] = (x << R) | (y << 8) | (NormalZTable[(x << 8) | y] << B) | 0xFF000000;
+				}
+				break;
+			case TPF_BC5:
+				DecodeAlphaBlock(Src, Values);
+				DecodeAlphaBlock(Src + 8, Values2);
+				for (i = 0; i < 16; i++)
+				{
+					unsigned x = Values[i];
+					unsigned y = Values2[i];
+					Pixels[i] = (x << R) | (y << 8) | (NormalZTable[(x << 8) | y] << B) | 0xFF000000;
+				}
+				break;
+			case TPF_BC7:
+				if (!detexDecompressBlockBPTC(Src, DETEX_MODE_MASK_ALL, 0, (byte*)Pixels))
+				{
+					memset(Pixels, 0, sizeof(Pixels));
+					appInterlockedAdd(&Job->ErrorCount, 1);
+				}
+				if (Job->BGRA) ConvertSwapRB((byte*)Pixels, (byte*)Pixels, 16);
+				break;
+			default:
+				appError("DecodeBlockRows: unsupported format %d", Job->Format);
+			}
+
+			// copy block to the image
+			unsigned *Dst = (unsigned*)Job->Dst + by * 4 * Job->USize + bx * 4;
+			int numColumns = min(4, Job->USize - bx * 4);
+			for (i = 0; i < numRows; i++, Dst += Job->USize)
+				memcpy(Dst, Pixels + i * 4, numColumns * sizeof(unsigned));
+		}
+	}
+}
+
+static void DecodeBlockTexture(const byte *Data, byte *Dst, int USize, int VSize, ETexturePixelFormat Format, bool BGRA)
+{
+	guard(DecodeBlockTexture);
+
+	if (Format == TPF_DXT5N || Format == TPF_BC5)
+		BuildNormalZTable();
+
+	CBlockDecodeJob Job;
+	Job.Data          = Data;
+	Job.Dst           = Dst;
+	Job.USize         = USize;
+	Job.VSize         = VSize;
+	Job.BlocksX       = (USize + 3) / 4;
+	Job.BytesPerBlock = PixelFormatInfo[Format].BytesPerBlock;
+	Job.Format        = Format;
+	Job.BGRA          = BGRA;
+	Job.ErrorCount    = 0;
+
+	int BlocksY = (VSize + 3) / 4;
+	// process at least 4096 blocks (64K pixels) per task
+	appParallelFor(BlocksY, max(4096 / Job.BlocksX, 1), DecodeBlockRows, &Job);
+
+	if (Job.ErrorCount)
+		appPrintf("WARNING: %d invalid %s blocks\n", Job.ErrorCount, PixelFormatInfo[Format].Name);
+
 	unguard;
 }
 
 
 const CPixelFormatInfo PixelFormatInfo[] =
 {
-	// FourCC					BlockSizeX	BlockSizeY	BytesPerBlock	X360AlignX	X360AlignY	Name
-	{ 0,						1,			1,			1,				0,			0,			"P8"	},	// TPF_P8
-	{ 0,						1,			1,			1,				64,			64,			"G8"	},	// TPF_G8
-//	{																									},	// TPF_G16
-	{ 0,						1,			1,			3,				0,			0,			"RGB8"	},	// TPF_RGB8
-	{ 0,						1,			1,			4,				32,			32,			"RGBA8"	},	// TPF_RGBA8
-	{ 0,						1,			1,			4,				32,			32,			"BGRA8"	},	// TPF_BGRA8
-	{ BYTES4('D','X','T','1'),	4,			4,			8,				128,		128,		"DXT1"	},	// TPF_DXT1
-	{ BYTES4('D','X','T','3'),	4,			4,			16,				128,		128,		"DXT3"	},	// TPF_DXT3
-	{ BYTES4('D','X','T','5'),	4,			4,			16,				128,		128,		"DXT5"	},	// TPF_DXT5
-	{ BYTES4('D','X','T','5'),	4,			4,			16,				128,		128,		"DXT5N"	},	// TPF_DXT5N
-	{ 0,						1,			1,			2,				64,			32,			"V8U8"	},	// TPF_V8U8
-	{ 0,						1,			1,			2,				64,			32,			"V8U8"	},	// TPF_V8U8_2
-	{ BYTES4('A','T','I','2'),	4,			4,			16,				0,			0,			"BC5"	},	// TPF_BC5
-	{ 0,						4,			4,			16,				0,			0,			"BC7"	},	// TPF_BC7
-	{ 0,						8,			1,			1,				0,			0,			"A1"	},	// TPF_A1
-	{ 0,						1,			1,			2,				0,			0,			"RGBA4"	},	// TPF_RGBA4
+	// FourCC					DXGIFormat	VkFormat	BlockSizeX	BlockSizeY	BytesPerBlock	X360AlignX	X360AlignY	Name
+	{ 0,						0,			0,			1,			1,			1,				0,			0,			"P8"	},	// TPF_P8
+	{ 0,						61,			9,			1,			1,			1,				64,			64,			"G8"	},	// TPF_G8
+//	{																															},	// TPF_G16
+	{ 0,						0,			23,			1,			1,			3,				0,			0,			"RGB8"	},	// TPF_RGB8
+	{ 0,						28,			37,			1,			1,			4,				32,			32,			"RGBA8"	},	// TPF_RGBA8
+	{ 0,						87,			44,			1,			1,			4,				32,			32,			"BGRA8"	},	// TPF_BGRA8
+	{ BYTES4('D','X','T','1'),	71,			133,		4,			4,			8,				128,		128,		"DXT1"	},	// TPF_DXT1
+	{ BYTES4('D','X','T','3'),	74,			135,		4,			4,			16,				128,		128,		"DXT3"	},	// TPF_DXT3
+	{ BYTES4('D','X','T','5'),	77,			137,		4,			4,			16,				128,		128,		"DXT5"	},	// TPF_DXT5
+	{ BYTES4('D','X','T','5'),	77,			137,		4,			4,			16,				128,		128,		"DXT5N"	},	// TPF_DXT5N
+	{ 0,						51,			17,			1,			1,			2,				64,			32,			"V8U8"	},	// TPF_V8U8
+	{ 0,						49,			16,			1,			1,			2,				64,			32,			"V8U8"	},	// TPF_V8U8_2
+	{ BYTES4('A','T','I','2'),	83,			141,		4,			4,			16,				0,			0,			"BC5"	},	// TPF_BC5
+	{ 0,						98,			145,		4,			4,			16,				0,			0,			"BC7"	},	// TPF_BC7
+	{ 0,						0,			0,			8,			1,			1,				0,			0,			"A1"	},	// TPF_A1
+	{ 0,						0,			2,			1,			1,			2,				0,			0,			"RGBA4"	},	// TPF_RGBA4
 #if SUPPORT_IPHONE
-	{ 0,						8,			4,			8,				0,			0,			"PVRTC2"},	// TPF_PVRTC2
-	{ 0,						4,			4,			8,				0,			0,			"PVRTC4"},	// TPF_PVRTC4
+	{ 0,						0,			1000054000,	8,			4,			8,				0,			0,			"PVRTC2"},	// TPF_PVRTC2
+	{ 0,						0,			1000054001,	4,			4,			8,				0,			0,			"PVRTC4"},	// TPF_PVRTC4
 #endif
 #if SUPPORT_ANDROID
-	{ 0,						4,			4,			8,				0,			0,			"ETC1"	},	// TPF_ETC1
-	{ 0,						4,			4,			8,				0,			0,			"ETC2"	},	// TPF_ETC2
+	{ 0,						0,			147,		4,			4,			8,				0,			0,			"ETC1"	},	// TPF_ETC1
+	{ 0,						0,			147,		4,			4,			8,				0,			0,			"ETC2"	},	// TPF_ETC2
 #endif
 };
 
@@ -82,7 +481,7 @@ bool CTextureData::IsDXT() const
 }
 
 
-byte *CTextureData::Decompress(int MipLevel)
+byte *CTextureData::Decompress(int MipLevel, bool BGRA)
 {
 	guard(CTextureData::Decompress);
 
@@ -91,10 +490,8 @@ byte *CTextureData::Decompress(int MipLevel)
 
 	const CMipMap& Mip = Mips[MipLevel];
 
-	// Get mip map data
 	int USize = Mip.USize;
 	int VSize = Mip.VSize;
-	const byte *Data = Mip.CompressedData;
 
 	int size = USize * VSize * 4;
 	byte *dst = new byte [size];
@@ -119,137 +516,93 @@ byte *CTextureData::Decompress(int MipLevel)
 	}
 #endif
 
-	// process non-dxt formats here
+	PROFILE_DDS(appResetProfiler());
+	DecompressRows(MipLevel, 0, VSize, dst, BGRA);
+	PROFILE_DDS(appPrintProfiler());
+
+	return dst;
+	unguardf("fmt=%s(%d)", OriginalFormatName, OriginalFormatEnum);
+}
+
+
+bool CTextureData::CanDecompressRows() const
+{
+#if SUPPORT_IPHONE
+	// PVRTC data has twiddled layout, it could be decoded only as a whole
+	if (Format == TPF_PVRTC2 || Format == TPF_PVRTC4)
+		return false;
+#endif
+	return true;
+}
+
+
+bool CTextureData::DecompressRows(int MipLevel, int FirstRow, int NumRows, byte *Dst, bool BGRA)
+{
+	guard(CTextureData::DecompressRows);
+
+	if (!Mips.IsValidIndex(MipLevel))
+		return false;
+
+	const CMipMap& Mip = Mips[MipLevel];
+	const CPixelFormatInfo &Info = PixelFormatInfo[Format];
+	assert(FirstRow % Info.BlockSizeY == 0 && NumRows > 0 && FirstRow + NumRows <= Mip.VSize);
+	assert(CanDecompressRows() || (FirstRow == 0 && NumRows == Mip.VSize));
+
+	// Get the first row of blocks; the strip is decoded as a separate image
+	int USize = Mip.USize;
+	int VSize = NumRows;
+	int BlocksX = (USize + Info.BlockSizeX - 1) / Info.BlockSizeX;
+	const byte *Data = Mip.CompressedData + FirstRow / Info.BlockSizeY * BlocksX * Info.BytesPerBlock;
+
+	int NumPixels = USize * VSize;
+
 	switch (Format)
 	{
 	case TPF_P8:
+		if (!Palette)
 		{
-			if (!Palette)
-			{
-				appNotify("DecompressTexture: TPF_P8 with NULL palette");
-				memset(dst, 0xFF, size);
-				return dst;
-			}
-			byte *d = dst;
-			for (int i = 0; i < USize * VSize; i++)
-			{
-				const FColor &c = Palette->Colors[Data[i]];
-				*d++ = c.R;
-				*d++ = c.G;
-				*d++ = c.B;
-				*d++ = c.A;
-			}
+			if (FirstRow == 0) appNotify("DecompressTexture: TPF_P8 with NULL palette");
+			memset(Dst, 0xFF, NumPixels * 4);
+			return false;
 		}
-		return dst;
+		ConvertP8(Data, Dst, NumPixels, Palette->Colors, BGRA);
+		return true;
 	case TPF_RGB8:
-		{
-			const byte *s = Data;
-			byte *d = dst;
-			for (int i = 0; i < USize * VSize; i++)
-			{
-				// BGRA -> RGBA
-				*d++ = s[2];
-				*d++ = s[1];
-				*d++ = s[0];
-				*d++ = 255;
-				s += 3;
-			}
-		}
-		return dst;
+		ConvertRGB8(Data, Dst, NumPixels, BGRA);
+		return true;
 	case TPF_RGBA8:
-		{
-			memcpy(dst, Data, USize * VSize * 4);
-		}
-		return dst;
+		ConvertRGBA8(Data, Dst, NumPixels, BGRA);
+		return true;
 	case TPF_BGRA8:
-		{
-			const byte *s = Data;
-			byte *d = dst;
-			for (int i = 0; i < USize * VSize; i++)
-			{
-				// BGRA -> RGBA
-				*d++ = s[2];
-				*d++ = s[1];
-				*d++ = s[0];
-				*d++ = s[3];
-				s += 4;
-			}
-		}
-		return dst;
+		ConvertRGBA8(Data, Dst, NumPixels, !BGRA);
+		return true;
 	case TPF_RGBA4:
-		{
-			const byte *s = Data;
-			byte *d = dst;
-			for (int i = 0; i < USize * VSize; i++)
-			{
-				byte b1 = s[0];
-				byte b2 = s[1];
-				// BGRA -> RGBA
-				*d++ = b2 & 0xF0;
-				*d++ = (b2 & 0xF) << 4;
-				*d++ = b1 & 0xF0;
-				*d++ = (b1 & 0xF) << 4;
-				s += 2;
-			}
-		}
-		return dst;
+		ConvertRGBA4(Data, Dst, NumPixels, BGRA);
+		return true;
 	case TPF_G8:
-		{
-			const byte *s = Data;
-			byte *d = dst;
-			for (int i = 0; i < USize * VSize; i++)
-			{
-				byte b = *s++;
-				*d++ = b;
-				*d++ = b;
-				*d++ = b;
-				*d++ = 255;
-			}
-		}
-		return dst;
+		ConvertG8(Data, Dst, NumPixels);
+		return true;
 	case TPF_V8U8:
 	case TPF_V8U8_2:
-		{
-			const byte *s = Data;
-			byte *d = dst;
-			byte offset = (Format == TPF_V8U8) ? 128 : 0;
-			for (int i = 0; i < USize * VSize; i++)
-			{
-				byte u = *s++ + offset;		// byte + byte -> byte, overflow is normal here
-				byte v = *s++ + offset;
-				d[0] = u;
-				d[1] = v;
-				float uf = (u - offset) / 255.0f * 2 - 1;
-				float vf = (v - offset) / 255.0f * 2 - 1;
-				float t  = 1.0f - uf * uf - vf * vf;
-				if (t >= 0)
-					d[2] = 255 - 255 * appFloor(sqrt(t));
-				else
-					d[2] = 255;
-				d[3] = 255;
-				d += 4;
-			}
-		}
-		return dst;
+		ConvertV8U8(Data, Dst, NumPixels, Format == TPF_V8U8, BGRA);
+		return true;
 	case TPF_A1:
-		appNotify("TPF_A1 unsupported");	//!! easy to do, but need samples - I've got some PF_A1 textures with no mipmaps inside
-		return dst;
+		if (FirstRow == 0) appNotify("TPF_A1 unsupported");	//!! easy to do, but need samples - I've got some PF_A1 textures with no mipmaps inside
+		memset(Dst, 0xFF, NumPixels * 4);
+		return false;
 
 #if SUPPORT_IPHONE
 	case TPF_PVRTC2:
 	case TPF_PVRTC4:
-		PROFILE_DDS(appResetProfiler());
-		PVRTDecompressPVRTC(Data, Format == TPF_PVRTC2, USize, VSize, dst);
-		PROFILE_DDS(appPrintProfiler());
-		return dst;
+		PVRTDecompressPVRTC(Data, Format == TPF_PVRTC2, USize, VSize, Dst);
+		if (BGRA) ConvertSwapRB(Dst, Dst, NumPixels);
+		return true;
 #endif // SUPPORT_IPHONE
 
 #if SUPPORT_ANDROID
 	case TPF_ETC1:
 #if 1
-		PROFILE_DDS(appResetProfiler());
-		PVRTDecompressETC(Data, USize, VSize, dst, 0);
-		PROFILE_DDS(appPrintProfiler());
+		PVRTDecompressETC(Data, USize, VSize, Dst, 0);
 #else
 		{
 			// NOTE: this code works well too
@@ -260,12 +613,11 @@ byte *CTextureData::Decompress(int MipLevel)
 			tex.height = VSize;
 			tex.width_in_blocks = USize / 4;
 			tex.height_in_blocks = VSize / 4;
-			PROFILE_DDS(appResetProfiler());
-			detexDecompressTextureLinear(&tex, dst, DETEX_PIXEL_FORMAT_RGBA8);
-			PROFILE_DDS(appPrintProfiler());
+			detexDecompressTextureLinear(&tex, Dst, DETEX_PIXEL_FORMAT_RGBA8);
 		}
 #endif
-		return dst;
+		if (BGRA) ConvertSwapRB(Dst, Dst, NumPixels);
+		return true;
 	#if 0
 	case TPF_ETC2:
 		{
@@ -276,67 +628,29 @@ byte *CTextureData::Decompress(int MipLevel)
 			tex.height = VSize;
 			tex.width_in_blocks = USize / 4;
 			tex.height_in_blocks = VSize / 4;
-			PROFILE_DDS(appResetProfiler());
-			detexDecompressTextureLinear(&tex, dst, DETEX_PIXEL_FORMAT_RGBA8);
-			PROFILE_DDS(appPrintProfiler());
+			detexDecompressTextureLinear(&tex, Dst, DETEX_PIXEL_FORMAT_RGBA8);
 		}
-		return dst;
+		if (BGRA) ConvertSwapRB(Dst, Dst, NumPixels);
+		return true;
 	#endif
 #endif // SUPPORT_ANDROID
 
+	case TPF_DXT1:
+	case TPF_DXT3:
+	case TPF_DXT5:
+	case TPF_DXT5N:
+	case TPF_BC5:
 	case TPF_BC7:
-		{
-			detexTexture tex;
-			tex.format = DETEX_TEXTURE_FORMAT_BPTC;
-			tex.data = const_cast<byte*>(Data);	// will be used as 'const' anyway
-			tex.width = USize;
-			tex.height = VSize;
-			tex.width_in_blocks = USize / 4;
-			tex.height_in_blocks = VSize / 4;
-			PROFILE_DDS(appResetProfiler());
-			detexDecompressTextureLinear(&tex, dst, DETEX_PIXEL_FORMAT_RGBA8);
-			PROFILE_DDS(appPrintProfiler());
-		}
-		return dst;
+		DecodeBlockTexture(Data, Dst, USize, VSize, Format, BGRA);
+		return true;
 	}
 
 	staticAssert(ARRAY_COUNT(PixelFormatInfo) == TPF_MAX, Wrong_PixelFormatInfo_array);
-	unsigned fourCC = PixelFormatInfo[Format].FourCC;
-	if (!fourCC)
-	{
+	if (FirstRow == 0)
 		appNotify("Unable to unpack texture %s: unsupported texture format %s\n", Obj->Name, PixelFormatInfo[Format].Name);
-		memset(dst, 0xFF, size);
-		return dst;
-	}
-
-	PROFILE_DDS(appResetProfiler());
-
-	nv::DDSHeader header;
-	nv::Image image;
-	header.setFourCC(fourCC & 0xFF, (fourCC >> 8) & 0xFF, (fourCC >> 16) & 0xFF, (fourCC >> 24) & 0xFF);
-	header.setWidth(USize);
-	header.setHeight(VSize);
-	header.setNormalFlag(Format == TPF_DXT5N || Format == TPF_BC5);	// flag to restore normalmap from 2 colors
-	DecodeDDS(Data, USize, VSize, header, image);
-
-	byte *s = (byte*)image.pixels();
-	byte *d = dst;
-
-	for (int i = 0; i < USize * VSize; i++, s += 4, d += 4)
-	{
-		// BGRA -> RGBA
-		d[0] = s[2];
-		d[1] = s[1];
-		d[2] = s[0];
-		d[3] = s[3];
-	}
-
-	PROFILE_DDS(appPrintProfiler());
-
-	if (Format == TPF_DXT1)
-		PostProcessAlpha(dst, USize, VSize);	//??
+	memset(Dst, 0xFF, NumPixels * 4);
+	return false;
 
-	return dst;
 	unguardf("fmt=%s(%d)", OriginalFormatName, OriginalFormatEnum);
 }
 
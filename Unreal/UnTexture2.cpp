@@ -247,13 +247,15 @@ static bool ReadXprFile(const CGameFileInfo *file)
 
 byte *FindXprData(const char *Name, int *DataSize)
 {
-	// scan xprs
+	// scan xprs; meshes could be serialized by different threads, so perform this under the lock
 	static bool ready = false;
+	UObject::LockObjects();
 	if (!ready)
 	{
 		ready = true;
 		appEnumGameFiles(ReadXprFile, "xpr");
 	}
+	UObject::UnlockObjects();
 	// find a file
 	for (int i = 0; i < xprFiles.Num(); i++)
 	{
@@ -501,6 +503,8 @@ bool UTexture::GetTextureData(CTextureData &TexData) const
 			const FMipmap &Mip = Mips[n];
 			if (!Mip.DataArray.Num())
 				continue;
+			if (TexData.ShouldSkipMip(n, Mip.USize, Mip.VSize, n == Mips.Num() - 1))
+				continue;
 			CMipMap* DstMip = new (TexData.Mips) CMipMap;
 			DstMip->CompressedData = &Mip.DataArray[0];
 			DstMip->ShouldFreeData = false;
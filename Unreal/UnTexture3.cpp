@@ -905,6 +905,11 @@ bool UTexture2D::GetTextureData(CTextureData &TexData) const
 			// reference: DemoPlayerSkins.utx/DemoSkeleton have null-sized 1st 2 mips
 			const FTexture2DMipMap &Mip = (*MipsArray)[mipLevel];
 			const FByteBulkData &Bulk = Mip.Data;
+			int MipUSize = max(1, OrigUSize >> mipLevel);
+			int MipVSize = max(1, OrigVSize >> mipLevel);
+			// skip mips which are not needed by the caller, don't load their bulk data
+			if (TexData.ShouldSkipMip(mipLevel, MipUSize, MipVSize, mipLevel == MipsArray->Num() - 1))
+				continue;
 			if (!Mip.Data.BulkData)
 			{
 				// check for external bulk
@@ -932,8 +937,8 @@ bool UTexture2D::GetTextureData(CTextureData &TexData) const
 			DstMip->ShouldFreeData = false;
 			// Note: UE3 can store incorrect SizeX/SizeY for lowest mips - these values could have 4x4 for all smaller mips
 			// (perhaps minimal size of DXT block). So compute mip size by ourselves.
-			DstMip->USize = max(1, OrigUSize >> mipLevel);
-			DstMip->VSize = max(1, OrigVSize >> mipLevel);
+			DstMip->USize = MipUSize;
+			DstMip->VSize = MipVSize;
 //			printf("+%d: %d x %d (%X)\n", mipLevel, DstMip->USize, DstMip->VSize, DstMip->DataSize);
 			TexData.Platform = Package->Platform;
 		}
@@ -105,21 +105,10 @@ private:
 	bool			m_loading;
 };
 
-//!! NOTE: some texture formats has more than 128 byte header, check DirectDrawSurface::offset()
-
-void DecodeDDS(const unsigned char* Data, int USize, int VSize, nv::DDSHeader& header, nv::Image& image)
-{
-	uint8 dummy[128];
-	NVTTStream* stream = new NVTTStream(dummy, sizeof(dummy), const_cast<unsigned char*>(Data), USize * VSize * 4, true); // deleted in DirectDrawSurface destructor
-	nv::DirectDrawSurface dds(stream);	// will try to read DDS header, it's zeroed
-	dds.header = header;				// set real header contents
-	dds.mipmap(&image, 0, 0);
-}
-
-// Data is 128 byte long array
-void WriteDDSHeader(unsigned char* Data, nv::DDSHeader& header)
+int WriteDDSHeader(unsigned char* Data, nv::DDSHeader& header)
 {
 	uint8 dummy[128];
-	NVTTStream stream(Data, 128, dummy, sizeof(dummy), false);
+	NVTTStream stream(Data, 148, dummy, sizeof(dummy), false);
 	stream << header;
+	return header.hasDX10Header() ? 148 : 128;
 }
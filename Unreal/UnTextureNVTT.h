@@ -2,5 +2,5 @@
 #include <nvimage/DirectDrawSurface.h>
 #undef __FUNC__						// conflicted with our guard macros
 
-void DecodeDDS(const unsigned char* Data, int USize, int VSize, nv::DDSHeader& header, nv::Image& image);
-void WriteDDSHeader(unsigned char* Data, nv::DDSHeader& header);
+// Data is 148 bytes long array, returns size of the header (128 bytes, or 148 with DX10 header)
+int WriteDDSHeader(unsigned char* Data, nv::DDSHeader& header);